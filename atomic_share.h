@@ -0,0 +1,108 @@
+//**************************************************************************************
+/** \file atomic_share.h
+ *    This file contains a share for data which has exactly one writer, such as a
+ *    steering command which only the motor task sets. It has the same get() and
+ *    put() methods as shared_data, but neither one takes a mutex or turns off
+ *    interrupts. A one-byte share is just a volatile byte, since the AVR reads and
+ *    writes a byte in one instruction. Anything wider is kept in two slots with a
+ *    sequence number: the writer fills the slot that readers aren't using, then
+ *    points readers at it, and a reader only tries again if a write happened while
+ *    it was copying.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _ATOMIC_SHARE_H_
+#define _ATOMIC_SHARE_H_
+
+#include <stdint.h>
+
+
+/// This macro stops the compiler from moving memory accesses across it
+#define ATOMIC_SHARE_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
+
+
+//-------------------------------------------------------------------------------------
+/** This class holds data which is written by one task or interrupt and read by any
+ *  number of others, without locking. There must be only one writer; readers may be
+ *  tasks or interrupts at any priority.
+ *  @param data_type The type of data held in the share; it must be copyable
+ */
+
+template <class data_type>
+class atomic_share
+{
+protected:
+	/// The two copies of the data; the writer never touches the one readers use
+	data_type slot[2];
+
+	/// Count of writes so far; the low bit says which slot readers should use
+	volatile uint8_t sequence;
+
+public:
+	/** This constructor creates a share which holds a default data_type value.
+	 */
+	atomic_share (void)
+		: sequence (0)
+	{
+		slot[0] = data_type ();
+		slot[1] = data_type ();
+	}
+
+	/** This method puts new data into the share. Only one task or interrupt may call
+	 *  it; that's what makes it safe without a lock.
+	 *  @param new_data The data to be put into the share
+	 */
+	void put (data_type new_data)
+	{
+		if (sizeof (data_type) == 1)
+		{
+			*(volatile data_type*)&slot[0] = new_data;
+		}
+		else
+		{
+			uint8_t next = sequence + 1;
+			slot[next & 1] = new_data;
+			ATOMIC_SHARE_BARRIER ();
+			sequence = next;
+		}
+	}
+
+	/** This method reads the data in the share. If the writer interrupts the copy,
+	 *  the copy is made again; that can only happen while the writer is running, so
+	 *  a reader which has a higher priority than the writer never tries twice.
+	 *  @return The data which was most recently put into the share
+	 */
+	data_type get (void)
+	{
+		if (sizeof (data_type) == 1)
+		{
+			return *(volatile data_type*)&slot[0];
+		}
+		else
+		{
+			data_type copy;
+			uint8_t before;
+			do
+			{
+				before = sequence;
+				ATOMIC_SHARE_BARRIER ();
+				copy = slot[before & 1];
+				ATOMIC_SHARE_BARRIER ();
+			}
+			while (sequence != before);
+			return copy;
+		}
+	}
+
+	/// Interrupts use the same code as tasks, as nothing here locks
+	void ISR_put (data_type new_data) { put (new_data); }
+
+	/// Interrupts use the same code as tasks, as nothing here locks
+	data_type ISR_get (void) { return get (); }
+};
+
+#endif // _ATOMIC_SHARE_H_
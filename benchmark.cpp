@@ -0,0 +1,260 @@
+//**************************************************************************************
+/** \file benchmark.cpp
+ *    This file contains benchmarks of the robot's hot paths. Each benchmark is a
+ *    function which runs the code under test once; on the robot it's called
+ *    BENCH_REPEAT times in each of BENCH_TRIALS trials, timed with the cycle counter,
+ *    and the fastest trial is kept so that an interrupt in the middle of one doesn't
+ *    spoil the result. The time of the empty benchmark is taken off the others.
+ *
+ *    The task benchmarks call methods of the real task objects from the user
+ *    interface task, so the scheduler is suspended while they're timed; the motor
+ *    task can't then run its state machine at the same time. The back motor's pass
+ *    leaves it in the state it was in, and the character timed is a backspace on an
+ *    empty command line, which does nothing but go into the event trace.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <string.h>                         // Functions for C string handling
+#include <avr/pgmspace.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+#include "frt_shared_data.h"                // Header for thread-safe shared data
+
+#include "xmega_util.h"                     // CCPWrite() and the clock setup
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "task_user.h"                      // The user interface task
+#include "benchmark.h"                      // Header for this file
+
+
+/// How many times a benchmark is run in each timed trial
+#define BENCH_REPEAT        16
+
+/// How many trials are run; the fastest one is kept
+#define BENCH_TRIALS        8
+
+
+/** This class is a serial device which throws away everything printed to it, so the
+ *  printing benchmark times the formatting and not a serial port.
+ */
+class benchmark_sink : public emstream
+{
+public:
+	/** This method takes a character and does nothing with it.
+	 *  @param chout The character
+	 *  @return True, since there's always room
+	 */
+	bool putchar (char chout)
+	{
+		(void)chout;
+		return true;
+	}
+};
+
+
+// The shares under test are global, as the real ones are
+static shared_data<uint8_t> locked_byte;
+static shared_data<uint32_t> locked_long;
+static atomic_share<uint8_t> atomic_byte;
+static atomic_share<uint32_t> atomic_long;
+
+// Data read from the shares goes here so the compiler can't throw the reads away
+static volatile uint8_t byte_sink;
+static volatile uint32_t long_sink;
+
+/// Where the printing benchmark prints
+static benchmark_sink text_sink;
+
+// The objects whose methods are timed, or NULL if they haven't been attached
+static task_user* p_bench_user = NULL;
+static motor_axis* p_bench_motor = NULL;
+
+
+//-------------------------------------------------------------------------------------
+// The benchmarks. Each one runs the code under test once
+
+static void bench_empty (uint8_t rep)
+{
+	(void)rep;
+	ATOMIC_SHARE_BARRIER ();
+}
+
+static void bench_motor_step (uint8_t rep)
+{
+	(void)rep;
+	if (p_bench_motor != NULL)
+	{
+		p_bench_motor->step ();
+	}
+}
+
+static void bench_user_char (uint8_t rep)
+{
+	(void)rep;
+	if (p_bench_user != NULL)
+	{
+		p_bench_user->handle_char (127);
+	}
+}
+
+static void bench_locked_byte_get (uint8_t rep)
+{
+	(void)rep;
+	byte_sink = locked_byte.get ();
+}
+
+static void bench_locked_byte_put (uint8_t rep)
+{
+	locked_byte.put (rep);
+}
+
+static void bench_atomic_byte_get (uint8_t rep)
+{
+	(void)rep;
+	byte_sink = atomic_byte.get ();
+}
+
+static void bench_atomic_byte_put (uint8_t rep)
+{
+	atomic_byte.put (rep);
+}
+
+static void bench_locked_long_get (uint8_t rep)
+{
+	(void)rep;
+	long_sink = locked_long.get ();
+}
+
+static void bench_locked_long_put (uint8_t rep)
+{
+	locked_long.put (rep);
+}
+
+static void bench_atomic_long_get (uint8_t rep)
+{
+	(void)rep;
+	long_sink = atomic_long.get ();
+}
+
+static void bench_atomic_long_put (uint8_t rep)
+{
+	atomic_long.put (rep);
+}
+
+static void bench_print_pms (uint8_t rep)
+{
+	text_sink << PMS ("run cycles mean ") << (uint16_t)(rep * 257U) << endl;
+}
+
+static void bench_ccp_write (uint8_t rep)
+{
+	(void)rep;
+	CCPWrite (&CLK.PSCTRL, CLK.PSCTRL);     // The prescaler is written back unchanged
+}
+
+
+// The table of benchmarks. Names are kept the same from one version to the next so
+// that results can be compared
+
+const benchmark_case benchmark_cases[] PROGMEM =
+{
+	{ "loop_overhead",          bench_empty },
+	{ "motor_back_step",        bench_motor_step },
+	{ "user_char_dispatch",     bench_user_char },
+	{ "shared_data_u8_get",     bench_locked_byte_get },
+	{ "shared_data_u8_put",     bench_locked_byte_put },
+	{ "atomic_share_u8_get",    bench_atomic_byte_get },
+	{ "atomic_share_u8_put",    bench_atomic_byte_put },
+	{ "shared_data_u32_get",    bench_locked_long_get },
+	{ "shared_data_u32_put",    bench_locked_long_put },
+	{ "atomic_share_u32_get",   bench_atomic_long_get },
+	{ "atomic_share_u32_put",   bench_atomic_long_put },
+	{ "emstream_pms_print",     bench_print_pms },
+	{ "ccp_write",              bench_ccp_write },
+};
+
+/// How many benchmarks are in the table
+const uint8_t benchmark_count = sizeof (benchmark_cases) / sizeof (benchmark_cases[0]);
+
+
+//-------------------------------------------------------------------------------------
+/** This function gives the benchmarks the objects whose methods they time. The
+ *  task benchmarks do nothing until it has been called.
+ *  @param p_user The user interface task
+ *  @param p_motor The back motor's axis
+ */
+
+void benchmark_attach (task_user* p_user, motor_axis* p_motor)
+{
+	p_bench_user = p_user;
+	p_bench_motor = p_motor;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function times one benchmark. The scheduler is suspended while it runs, so
+ *  no other task gets in the middle of it; interrupts still do.
+ *  @param function The benchmark
+ *  @return The cycles which BENCH_REPEAT calls took in the fastest trial
+ */
+
+static uint16_t time_benchmark (benchmark_function function)
+{
+	uint16_t best = 0xFFFF;
+
+	vTaskSuspendAll ();
+	for (uint8_t trial = 0; trial < BENCH_TRIALS; trial++)
+	{
+		uint16_t start = cycle_counter_now16 ();
+		for (uint8_t rep = 0; rep < BENCH_REPEAT; rep++)
+		{
+			function (rep);
+		}
+		uint16_t cycles = cycle_counter_now16 () - start;
+		if (cycles < best)
+		{
+			best = cycles;
+		}
+	}
+	xTaskResumeAll ();
+
+	return best;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function runs the benchmarks and prints a CSV line for each: its name, how
+ *  many calls were timed, and CPU cycles per call with the loop overhead taken out.
+ *  The loop overhead itself is printed as it was measured.
+ *  @param p_ser The serial device on which to print the results
+ */
+
+void benchmark_run (emstream* p_ser)
+{
+	char name[BENCHMARK_NAME_SIZE];
+	benchmark_function function;
+	uint16_t overhead = 0;
+
+	*p_ser << PMS ("benchmark,calls,cycles_per_call") << endl;
+	for (uint8_t index = 0; index < benchmark_count; index++)
+	{
+		strcpy_P (name, benchmark_cases[index].name);
+		memcpy_P (&function, &benchmark_cases[index].function, sizeof (function));
+
+		uint16_t cycles = time_benchmark (function);
+		if (index == 0)
+		{
+			overhead = cycles;
+		}
+		else
+		{
+			cycles = (cycles > overhead) ? cycles - overhead : 0;
+		}
+		*p_ser << name << ',' << (uint8_t)BENCH_REPEAT << ','
+			   << (uint16_t)(cycles / BENCH_REPEAT) << endl;
+	}
+}
@@ -0,0 +1,54 @@
+//**************************************************************************************
+/** \file benchmark.h
+ *    This file contains benchmarks of the robot's hot paths: one pass of the back
+ *    motor axis's state machine, one character through the user interface, get() and
+ *    put() of the shares, printing a PMS string and a number, and CCPWrite(). The
+ *    same table of benchmarks is run on the robot by the bench command, timed in CPU
+ *    cycles, and on a PC by host/tools/bench.cpp, timed in nanoseconds. Both print one
+ *    CSV line per benchmark, so the results of two builds can be compared by a script.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "motor_axes.h"                     // The motors and the task which runs them
+
+
+/// The longest name of a benchmark, including the '\0' at the end
+#define BENCHMARK_NAME_SIZE     24
+
+class task_user;
+
+/// A benchmark runs the code under test once each time it's called; the number of the
+/// call is handed in so that puts don't all write the same value
+typedef void (*benchmark_function) (uint8_t rep);
+
+/// One entry in the table of benchmarks, which is kept in program memory
+struct benchmark_case
+{
+	char name[BENCHMARK_NAME_SIZE];         ///< Name of the benchmark in the results
+	benchmark_function function;            ///< The function which runs it
+};
+
+/// The benchmarks; the first one runs nothing, so it measures the timing loop itself
+extern const benchmark_case benchmark_cases[];
+
+/// How many benchmarks are in the table
+extern const uint8_t benchmark_count;
+
+
+// This function gives the benchmarks the task objects whose methods they time
+void benchmark_attach (task_user* p_user, motor_axis* p_motor);
+
+// This function runs the benchmarks on the robot and prints the cycles per call as CSV
+void benchmark_run (emstream* p_ser);
+
+#endif // _BENCHMARK_H_
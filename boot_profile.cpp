@@ -0,0 +1,155 @@
+//**************************************************************************************
+/** \file boot_profile.cpp
+ *    This file contains the boot time profile. Timer C1 counts system clock cycles
+ *    divided by 64; since the clock changes from 2 MHz to its full speed partway
+ *    through, the clock rate is recorded with each milestone and each step's count is
+ *    turned into time at the rate it started with. The reset cause is taken from the
+ *    reset controller when main() starts.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/io.h>                         // Port I/O for SFR's
+#include <avr/pgmspace.h>                   // Milestone names in program memory
+
+#include "hal.h"                            // Real or emulated register access
+#include "xmega_util.h"                     // System clock rate
+#include "boot_profile.h"                   // Header for this file
+
+
+/// The timer's clock is the system clock divided by this
+#define BOOT_TIMER_DIVIDER      64
+
+
+/// Timer counts at each milestone, extended past 16 bits by counting overflows
+static uint32_t mark_counts[BOOT_MILESTONES];
+
+/// The system clock rate in Hz at each milestone
+static uint32_t mark_clock_hz[BOOT_MILESTONES];
+
+/// Timer counts taken by overflows before the latest reading
+static uint32_t overflow_counts = 0;
+
+/// The reset controller's flags which say why the chip was reset
+static uint8_t reset_cause = 0;
+
+/// Names of the milestones, for the printout
+static const char name_main[] PROGMEM = "C runtime ";
+static const char name_clock[] PROGMEM = "clock     ";
+static const char name_serial[] PROGMEM = "serial    ";
+static const char name_tasks[] PROGMEM = "tasks     ";
+static const char name_scheduler[] PROGMEM = "scheduler ";
+static const char* const milestone_names[BOOT_MILESTONES] PROGMEM =
+{
+	name_main, name_clock, name_serial, name_tasks, name_scheduler
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This function starts timer C1 right after reset, before .data is copied and .bss
+ *  is cleared, so the C runtime's own startup is timed too. On the AVR it's put in
+ *  the .init3 section, which the startup code runs straight through; it mustn't have
+ *  a return, so it's naked. On the host it runs before main() as a constructor.
+ */
+
+#ifdef HAL_HOST
+static void __attribute__ ((constructor)) boot_profile_start (void)
+#else
+void boot_profile_start (void) __attribute__ ((naked, used, section (".init3")));
+void boot_profile_start (void)
+#endif
+{
+	TCC1.CTRLB = TC_WGMODE_NORMAL_gc;
+	TCC1.PER = 0xFFFF;
+	TCC1.CTRLA = TC_CLKSEL_DIV64_gc;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function reads timer C1 as a 32-bit count. Interrupts are off while booting,
+ *  so overflows are found by polling the overflow flag; that's correct as long as
+ *  milestones are less than 65536 counts apart, which is 2 s at 2 MHz and 131 ms at
+ *  32 MHz.
+ *  @return Timer counts since reset
+ */
+
+static uint32_t boot_timer_now (void)
+{
+	uint16_t count = TCC1.CNT;
+	if (TCC1.INTFLAGS & TC1_OVFIF_bm)
+	{
+		TCC1.INTFLAGS = TC1_OVFIF_bm;
+		overflow_counts += 0x10000UL;
+		count = TCC1.CNT;
+	}
+	return overflow_counts + count;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function records the time at which a milestone was reached. The first one
+ *  also saves and clears the reset cause; the last one stops the timer.
+ *  @param milestone The milestone which was just reached, from boot_milestone
+ */
+
+void boot_profile_mark (uint8_t milestone)
+{
+	if (milestone >= BOOT_MILESTONES)
+	{
+		return;
+	}
+
+	mark_counts[milestone] = boot_timer_now ();
+	mark_clock_hz[milestone] = sysclock_hz ();
+
+	if (milestone == BOOT_MAIN)
+	{
+		reset_cause = RST.STATUS;
+		RST.STATUS = reset_cause;           // Flags are cleared by writing ones
+	}
+	else if (milestone == BOOT_SCHEDULER)
+	{
+		TCC1.CTRLA = TC_CLKSEL_OFF_gc;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints how long each step of booting took, in microseconds, the
+ *  total time from reset to the scheduler, and what caused the reset.
+ *  @param p_ser The serial device on which to print
+ */
+
+void boot_profile_print (emstream* p_ser)
+{
+	char name[12];
+	uint32_t total_us = 0;
+	uint32_t last_count = 0;
+	uint32_t clock_hz = 2000000UL;          // The chip comes out of reset at 2 MHz
+
+	*p_ser << PMS ("step       time_us") << endl;
+	for (uint8_t index = 0; index < BOOT_MILESTONES; index++)
+	{
+		uint32_t counts = mark_counts[index] - last_count;
+		uint32_t step_us = counts * BOOT_TIMER_DIVIDER / (clock_hz / 1000000UL);
+
+		strcpy_P (name, (const char*)pgm_read_ptr (&milestone_names[index]));
+		*p_ser << name << step_us << endl;
+
+		total_us += step_us;
+		last_count = mark_counts[index];
+		clock_hz = mark_clock_hz[index];
+	}
+	*p_ser << PMS ("total     ") << total_us << endl;
+
+	*p_ser << PMS ("reset:");
+	if (reset_cause & RST_PORF_bm)  *p_ser << PMS (" power-on");
+	if (reset_cause & RST_EXTRF_bm) *p_ser << PMS (" external");
+	if (reset_cause & RST_BORF_bm)  *p_ser << PMS (" brown-out");
+	if (reset_cause & RST_WDRF_bm)  *p_ser << PMS (" watchdog");
+	if (reset_cause & RST_PDIRF_bm) *p_ser << PMS (" debugger");
+	if (reset_cause & RST_SRF_bm)   *p_ser << PMS (" software");
+	*p_ser << endl;
+}
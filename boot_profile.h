@@ -0,0 +1,41 @@
+//**************************************************************************************
+/** \file boot_profile.h
+ *    This file contains a record of how long each step of starting up takes, from
+ *    reset to the start of the RTOS scheduler. Timer C1 is started before the C
+ *    runtime copies .data and clears .bss, and main() marks each milestone as it gets
+ *    there; the times are printed later, when the serial port is running. The timer is
+ *    free for other uses once the scheduler starts.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _BOOT_PROFILE_H_
+#define _BOOT_PROFILE_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The steps of starting up, in order; each is marked when it's finished
+enum boot_milestone
+{
+	BOOT_MAIN,                              ///< C runtime done; main() has been entered
+	BOOT_CLOCK,                             ///< System clock running at full speed
+	BOOT_SERIAL,                            ///< Serial port and receiver set up
+	BOOT_TASKS,                             ///< Tasks made
+	BOOT_SCHEDULER,                         ///< About to start the scheduler
+	BOOT_MILESTONES                         ///< How many milestones there are
+};
+
+
+// This function records the time at which a milestone was reached
+void boot_profile_mark (uint8_t milestone);
+
+// This function prints how long each step took and why the last reset happened
+void boot_profile_print (emstream* p_ser);
+
+#endif // _BOOT_PROFILE_H_
@@ -0,0 +1,274 @@
+//**************************************************************************************
+/** \file control_loop.cpp
+ *    This file contains the control loop executor. Timer E0 counts the CPU clock and
+ *    overflows at the executor's rate with a high level interrupt. At the start of the
+ *    interrupt the cycle counter is read, so the time between two interrupts is the
+ *    real period of the control loops, late by however long interrupts were held off;
+ *    the time from there to the end of the interrupt is what the control functions
+ *    cost. If the timer has overflowed again by the time the functions are done, a
+ *    period has been missed and is counted as an overrun.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+
+#include "hal.h"                            // Real or emulated register access
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "task_stats.h"                     // Its cycles aren't charged to the tasks
+#include "control_loop.h"                   // Header for this file
+
+
+/// A control function and how often it runs
+struct control_entry
+{
+	control_function function;              ///< The function to call
+	uint16_t rate_hz;                       ///< How many times a second to call it
+	uint16_t divider;                       ///< It's called once every this many ticks
+	uint16_t count;                         ///< Ticks since it was last called
+};
+
+/// The control functions
+static control_entry entries[CONTROL_LOOP_MAX];
+
+/// How many control functions have been added
+static uint8_t entry_count = 0;
+
+/// The rate at which the interrupt runs, in Hz
+static uint16_t loop_rate_hz = CONTROL_LOOP_HZ;
+
+// Measurements since they were last printed
+static uint16_t last_start = 0;             ///< Cycle count at the last interrupt
+static bool have_last = false;              ///< Whether last_start is good
+static uint32_t passes = 0;                 ///< Interrupts which have run
+static uint16_t period_min = 0xFFFF;        ///< Shortest time between interrupts
+static uint16_t period_max = 0;             ///< Longest time between interrupts
+static uint32_t busy_sum = 0;               ///< Cycles spent in the interrupt
+static uint16_t busy_max = 0;               ///< Longest time spent in the interrupt
+static uint16_t overruns = 0;               ///< Periods missed because it ran too long
+
+
+//-------------------------------------------------------------------------------------
+/** This function clears the measurements, which start over from the next interrupt.
+ *  It must be called with interrupts off.
+ */
+
+static void clear_measurements (void)
+{
+	have_last = false;
+	passes = 0;
+	period_min = 0xFFFF;
+	period_max = 0;
+	busy_sum = 0;
+	busy_max = 0;
+	overruns = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function checks whether every control function can run at its own rate when
+ *  the interrupt runs at a given rate, which it can if its rate divides that rate.
+ *  @param rate_hz The rate at which the interrupt would run
+ *  @return True if the rate is in range and suits every control function
+ */
+
+static bool rate_fits (uint16_t rate_hz)
+{
+	if (rate_hz < CONTROL_LOOP_MIN_HZ || rate_hz > CONTROL_LOOP_MAX_HZ)
+	{
+		return false;
+	}
+	for (uint8_t index = 0; index < entry_count; index++)
+	{
+		if (rate_hz % entries[index].rate_hz != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets timer E0 to overflow at the given rate and works out how many
+ *  overflows there are between calls of each control function. It must be called
+ *  with interrupts off.
+ *  @param rate_hz The rate at which the interrupt is to run
+ */
+
+static void apply_rate (uint16_t rate_hz)
+{
+	loop_rate_hz = rate_hz;
+	for (uint8_t index = 0; index < entry_count; index++)
+	{
+		entries[index].divider = rate_hz / entries[index].rate_hz;
+		entries[index].count = 0;
+	}
+
+	TCE0.CTRLA = TC_CLKSEL_OFF_gc;
+	TCE0.PER = (uint16_t)(F_CPU / rate_hz - 1);
+	TCE0.CNT = 0;
+	TCE0.CTRLA = TC_CLKSEL_DIV1_gc;
+	clear_measurements ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function starts timer E0 with a high level overflow interrupt. Control
+ *  functions can be added before or after.
+ *  @param rate_hz The rate at which the interrupt is to run, from CONTROL_LOOP_MIN_HZ
+ *                 to CONTROL_LOOP_MAX_HZ
+ */
+
+void control_loop_init (uint16_t rate_hz)
+{
+	TCE0.CTRLA = TC_CLKSEL_OFF_gc;
+	TCE0.CTRLB = TC_WGMODE_NORMAL_gc;
+	TCE0.INTCTRLA = TC_OVFINTLVL_HI_gc;
+
+	portENTER_CRITICAL ();
+	apply_rate (rate_fits (rate_hz) ? rate_hz : CONTROL_LOOP_HZ);
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function adds a control function. It's called once every rate / rate_hz
+ *  interrupts, so rate_hz must divide the executor's rate.
+ *  @param function The function to call; it runs in the interrupt, so it must be short
+ *  @param rate_hz How many times a second to call it
+ *  @return True if it was added, false if there's no room or the rate doesn't fit
+ */
+
+bool control_loop_add (control_function function, uint16_t rate_hz)
+{
+	if (entry_count >= CONTROL_LOOP_MAX || rate_hz == 0 || rate_hz > loop_rate_hz
+		|| loop_rate_hz % rate_hz != 0)
+	{
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	control_entry* p_entry = &entries[entry_count];
+	p_entry->function = function;
+	p_entry->rate_hz = rate_hz;
+	p_entry->divider = loop_rate_hz / rate_hz;
+	p_entry->count = 0;
+	entry_count++;
+	portEXIT_CRITICAL ();
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function changes the rate at which the interrupt runs. The control functions
+ *  keep their own rates, so the new rate must be a multiple of each of them.
+ *  @param rate_hz The new rate, from CONTROL_LOOP_MIN_HZ to CONTROL_LOOP_MAX_HZ
+ *  @return True if the rate was changed, false if it doesn't fit
+ */
+
+bool control_loop_set_rate (uint16_t rate_hz)
+{
+	if (!rate_fits (rate_hz))
+	{
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	apply_rate (rate_hz);
+	portEXIT_CRITICAL ();
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the executor's rate, the shortest and longest times between
+ *  interrupts and how far they were from the nominal period, the mean and longest
+ *  time spent in the interrupt, and how many periods were missed, all in CPU cycles.
+ *  The measurements then start over.
+ *  @param p_ser The serial device on which to print
+ */
+
+void control_loop_print (emstream* p_ser)
+{
+	portENTER_CRITICAL ();
+	uint32_t passes_now = passes;
+	uint16_t min_now = period_min;
+	uint16_t max_now = period_max;
+	uint32_t busy_now = busy_sum;
+	uint16_t busy_max_now = busy_max;
+	uint16_t overruns_now = overruns;
+	clear_measurements ();
+	portEXIT_CRITICAL ();
+
+	uint16_t nominal = (uint16_t)(F_CPU / loop_rate_hz);
+
+	*p_ser << PMS ("loop Hz ") << loop_rate_hz << PMS (" functions ") << entry_count
+		   << PMS (" passes ") << passes_now << endl;
+	if (passes_now < 2)
+	{
+		return;
+	}
+	*p_ser << PMS ("period cycles nominal ") << nominal
+		   << PMS (" min ") << min_now << PMS (" max ") << max_now
+		   << PMS (" jitter ") << (uint16_t)(max_now - min_now) << endl;
+	*p_ser << PMS ("run cycles mean ") << (uint32_t)(busy_now / passes_now)
+		   << PMS (" max ") << busy_max_now
+		   << PMS (" overruns ") << overruns_now << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This interrupt runs the control functions which are due, and measures its own
+ *  period and run time.
+ */
+
+ISR (TCE0_OVF_vect)
+{
+	uint16_t start = cycle_counter_now16 ();
+
+	if (have_last)
+	{
+		uint16_t period = start - last_start;
+		if (period < period_min)
+		{
+			period_min = period;
+		}
+		if (period > period_max)
+		{
+			period_max = period;
+		}
+	}
+	last_start = start;
+	have_last = true;
+
+	for (uint8_t index = 0; index < entry_count; index++)
+	{
+		control_entry* p_entry = &entries[index];
+		if (++p_entry->count >= p_entry->divider)
+		{
+			p_entry->count = 0;
+			p_entry->function ();
+		}
+	}
+
+	uint16_t busy = cycle_counter_now16 () - start;
+	task_stats_interrupted (busy);
+	busy_sum += busy;
+	if (busy > busy_max)
+	{
+		busy_max = busy;
+	}
+	passes++;
+
+	if (TCE0.INTFLAGS & TC0_OVFIF_bm)
+	{
+		overruns++;
+	}
+}
@@ -0,0 +1,52 @@
+//**************************************************************************************
+/** \file control_loop.h
+ *    This file contains the control loop executor. Timer E0 interrupts at a fixed
+ *    rate between 1 and 20 kHz, and the interrupt calls each control function which
+ *    has been added, every time or every Nth time so that each one runs at its own
+ *    rate. The loops are timed by the hardware rather than by RTOS ticks, so their
+ *    period doesn't depend on what the tasks are doing; the tasks only hand the loops
+ *    their setpoints. The period and run time of the interrupt are measured all the
+ *    time, so its jitter can be checked.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _CONTROL_LOOP_H_
+#define _CONTROL_LOOP_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The rate at which the executor starts, in Hz
+#define CONTROL_LOOP_HZ         1000
+
+/// The lowest and highest rates the executor can run at, in Hz
+#define CONTROL_LOOP_MIN_HZ     1000
+#define CONTROL_LOOP_MAX_HZ     20000
+
+/// The most control functions which can be added
+#define CONTROL_LOOP_MAX        4
+
+
+/// A control function, which the executor's interrupt calls
+typedef void (*control_function) (void);
+
+
+// This function starts the executor's timer; it's called from main()
+void control_loop_init (uint16_t rate_hz);
+
+// This function adds a control function which is to run at the given rate
+bool control_loop_add (control_function function, uint16_t rate_hz);
+
+// This function changes the rate at which the executor's interrupt runs
+bool control_loop_set_rate (uint16_t rate_hz);
+
+// This function prints the period jitter and run time since they were last printed
+void control_loop_print (emstream* p_ser);
+
+#endif // _CONTROL_LOOP_H_
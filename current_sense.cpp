@@ -0,0 +1,391 @@
+//**************************************************************************************
+/** \file current_sense.cpp
+ *    This file contains the motor current sensing. The back motor's current sense
+ *    amplifier is on pin A4 and the front motor's on pin A5. Event channel 1 carries
+ *    timer C0's overflow to ADC A, which sweeps its channels 0 (back) and 1 (front);
+ *    timer D0 overflows on the same clock cycle, as motor_sync_init() starts both
+ *    timers in step. When channel 1 is done, DMA copies both results, four bytes in
+ *    one burst, into a buffer. DMA channels 2 and 3 are run as a double buffer pair,
+ *    so while one fills its buffer the other's buffer is handed to the filter by its
+ *    transaction complete interrupt. A motor whose current is too high is cut off
+ *    with its driver's enable line in that interrupt, which runs within a few
+ *    microseconds of the reading and well before the next PWM period starts.
+ *
+ *    In the host build there's no ADC or DMA; the currents stay at zero.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+
+#include "hal.h"                            // Real or emulated register access
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "trace.h"                          // Time stamped event trace
+#include "motor_axes.h"                     // The bridges which are cut off
+#include "current_sense.h"                  // Header for this file
+
+
+/// ADC counts in a full scale reading
+#define CURRENT_ADC_COUNTS      4096UL
+
+/// The limits in ADC counts above the zero reading
+#define CURRENT_LIMIT_COUNTS    (CURRENT_LIMIT_MA * CURRENT_ADC_COUNTS                 \
+								 / CURRENT_SENSE_FULL_MA)
+#define CURRENT_STALL_COUNTS    (CURRENT_STALL_MA * CURRENT_ADC_COUNTS                 \
+								 / CURRENT_SENSE_FULL_MA)
+
+/// How many motors are measured; readings come in this order: back, then front
+#define CURRENT_CHANNELS        2
+
+
+/** This macro turns ADC counts above the zero reading into mA.
+ *  @param counts The counts
+ */
+#define COUNTS_TO_MA(counts)    ((uint16_t)((counts) * CURRENT_SENSE_FULL_MA            \
+											/ CURRENT_ADC_COUNTS))
+
+
+/// What's kept about each motor's current
+struct current_channel
+{
+	uint8_t motor;                          ///< Which motor, TRACE_FRONT or TRACE_BACK
+	uint16_t zero;                          ///< ADC reading with no current
+	uint16_t filter;                        ///< Filtered counts, scaled up by the filter
+	uint16_t stall_count;                   ///< Readings in a row over the stall level
+	uint16_t peak;                          ///< Highest filtered counts since last printed
+	uint16_t trips;                         ///< How many times the motor was cut off
+	volatile uint8_t fault;                 ///< Why the motor is cut off, or 0
+	atomic_share<uint16_t> current;         ///< Filtered counts, for the tasks
+};
+
+/// The motors, in the order their readings come
+static current_channel channels[CURRENT_CHANNELS];
+
+/// The DMA double buffer; each half gets one reading of each motor per PWM period
+static volatile uint16_t readings[2][CURRENT_CHANNELS];
+
+/// How many readings have gone toward the zero readings so far
+static uint8_t zero_count = 0;
+
+/// The sums of the readings which make the zero readings
+static uint16_t zero_sum[CURRENT_CHANNELS];
+
+/// Readings in a row over the stall level which mean a stall
+static uint16_t stall_samples = 1;
+
+
+//-------------------------------------------------------------------------------------
+/** This function cuts a motor off by turning off its bridge driver.
+ *  @param motor Which motor, TRACE_FRONT or TRACE_BACK
+ */
+
+static void cut_off (uint8_t motor)
+{
+	if (motor == TRACE_FRONT)
+	{
+		front_bridge::disable ();
+	}
+	else
+	{
+		back_bridge::disable ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the channel which measures a motor.
+ *  @param motor Which motor, TRACE_FRONT or TRACE_BACK
+ *  @return The motor's channel, or NULL if there's no such motor
+ */
+
+static current_channel* channel_of (uint8_t motor)
+{
+	for (uint8_t index = 0; index < CURRENT_CHANNELS; index++)
+	{
+		if (channels[index].motor == motor)
+		{
+			return &channels[index];
+		}
+	}
+	return NULL;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets up the ADC to measure both motors' currents each time event
+ *  channel 1 fires, routes timer C0's overflow to that channel, and sets up DMA
+ *  channels 2 and 3 as a double buffer which takes the results. The motor timers must
+ *  be running, and their duty cycles should still be zero, since the first readings
+ *  are taken to be the zero current readings.
+ */
+
+void current_sense_init (void)
+{
+	channels[0].motor = TRACE_BACK;
+	channels[1].motor = TRACE_FRONT;
+	current_sense_set_rate (back_bridge::frequency ());
+
+#ifndef HAL_HOST
+	PORTA.DIRCLR = PIN4_bm | PIN5_bm;
+
+	ADCA.CTRLB = ADC_RESOLUTION_12BIT_gc;
+	ADCA.REFCTRL = ADC_REFSEL_INTVCC_gc;
+	ADCA.PRESCALER = ADC_PRESCALER_DIV16_gc;        // 2 MHz at 32 MHz
+	ADCA.CH0.CTRL = ADC_CH_INPUTMODE_SINGLEENDED_gc;
+	ADCA.CH0.MUXCTRL = ADC_CH_MUXPOS_PIN4_gc;
+	ADCA.CH1.CTRL = ADC_CH_INPUTMODE_SINGLEENDED_gc;
+	ADCA.CH1.MUXCTRL = ADC_CH_MUXPOS_PIN5_gc;
+	ADCA.EVCTRL = ADC_SWEEP_01_gc | ADC_EVSEL_1234_gc | ADC_EVACT_SWEEP_gc;
+	ADCA.CTRLA = ADC_ENABLE_bm;
+
+	// Each channel copies one sweep's results into its half of the buffer. When one
+	// is done, the DMA controller starts the other on the next trigger
+	DMA.CTRL |= DMA_ENABLE_bm | DMA_DBUFMODE_CH23_gc;
+	DMA_CH_t* p_dma[2] = { &DMA.CH2, &DMA.CH3 };
+	for (uint8_t half = 0; half < 2; half++)
+	{
+		p_dma[half]->ADDRCTRL = DMA_CH_SRCRELOAD_BURST_gc | DMA_CH_SRCDIR_INC_gc
+								| DMA_CH_DESTRELOAD_TRANSACTION_gc
+								| DMA_CH_DESTDIR_INC_gc;
+		p_dma[half]->TRIGSRC = DMA_CH_TRIGSRC_ADCA_CH1_gc;
+		p_dma[half]->TRFCNT = sizeof (readings[0]);
+		p_dma[half]->REPCNT = 0;                    // Repeat for ever
+		p_dma[half]->SRCADDR0 = (uint8_t)(uintptr_t)&ADCA.CH0RES;
+		p_dma[half]->SRCADDR1 = (uint8_t)((uintptr_t)&ADCA.CH0RES >> 8);
+		p_dma[half]->SRCADDR2 = 0;
+		p_dma[half]->DESTADDR0 = (uint8_t)(uintptr_t)readings[half];
+		p_dma[half]->DESTADDR1 = (uint8_t)((uintptr_t)readings[half] >> 8);
+		p_dma[half]->DESTADDR2 = 0;
+		p_dma[half]->CTRLB = DMA_CH_TRNINTLVL_HI_gc;
+		p_dma[half]->CTRLA = DMA_CH_REPEAT_bm | DMA_CH_BURSTLEN_4BYTE_gc;
+	}
+	DMA.CH2.CTRLA |= DMA_CH_ENABLE_bm;
+
+	EVSYS.CH1MUX = EVSYS_CHMUX_TCC0_OVF_gc;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function works out how many readings in a row over the stall level make a
+ *  stall. It's called when the back motor's PWM frequency, which sets how often the
+ *  readings are taken, changes.
+ *  @param samples_per_s How many readings are taken per second
+ */
+
+void current_sense_set_rate (uint32_t samples_per_s)
+{
+	uint32_t samples = samples_per_s * CURRENT_STALL_MS / 1000;
+
+	portENTER_CRITICAL ();
+	stall_samples = (samples < 1) ? 1 : (samples > 0xFFFF) ? 0xFFFF : (uint16_t)samples;
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function filters one reading of each motor's current. The first few readings
+ *  are averaged into the zero readings instead. A motor whose reading is over the
+ *  limit is cut off at once; the filter would take several periods to pass it. A
+ *  motor whose filtered current has been over the stall level for too long is cut
+ *  off too.
+ *  It's called by the DMA interrupts.
+ *  @param p_readings The ADC readings, back motor first
+ */
+
+void current_sense_sample (const volatile uint16_t* p_readings)
+{
+	if (zero_count < CURRENT_ZERO_SAMPLES)
+	{
+		for (uint8_t index = 0; index < CURRENT_CHANNELS; index++)
+		{
+			zero_sum[index] += p_readings[index];
+		}
+		if (++zero_count == CURRENT_ZERO_SAMPLES)
+		{
+			for (uint8_t index = 0; index < CURRENT_CHANNELS; index++)
+			{
+				channels[index].zero = zero_sum[index] / CURRENT_ZERO_SAMPLES;
+			}
+		}
+		return;
+	}
+
+	for (uint8_t index = 0; index < CURRENT_CHANNELS; index++)
+	{
+		current_channel* p_channel = &channels[index];
+		uint16_t reading = p_readings[index];
+		uint16_t counts = (reading > p_channel->zero) ? reading - p_channel->zero : 0;
+
+		p_channel->filter += counts - (p_channel->filter >> CURRENT_FILTER_SHIFT);
+		uint16_t filtered = p_channel->filter >> CURRENT_FILTER_SHIFT;
+		p_channel->current.ISR_put (filtered);
+		if (filtered > p_channel->peak)
+		{
+			p_channel->peak = filtered;
+		}
+
+		if (p_channel->fault != 0)
+		{
+			continue;
+		}
+
+		uint8_t fault = 0;
+		if (counts > CURRENT_LIMIT_COUNTS)
+		{
+			fault = CURRENT_FAULT_OVER;
+		}
+		else if (filtered > CURRENT_STALL_COUNTS)
+		{
+			if (++p_channel->stall_count >= stall_samples)
+			{
+				fault = CURRENT_FAULT_STALL;
+			}
+		}
+		else
+		{
+			p_channel->stall_count = 0;
+		}
+
+		if (fault != 0)
+		{
+			cut_off (p_channel->motor);
+			p_channel->fault = fault;
+			p_channel->trips++;
+			trace (TRACE_FAULT, p_channel->motor, fault);
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns a motor's current, filtered over the last few PWM periods.
+ *  @param motor Which motor, TRACE_FRONT or TRACE_BACK
+ *  @return The current in mA
+ */
+
+uint16_t current_sense_ma (uint8_t motor)
+{
+	current_channel* p_channel = channel_of (motor);
+	if (p_channel == NULL)
+	{
+		return 0;
+	}
+	return COUNTS_TO_MA (p_channel->current.get ());
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function says whether, and why, a motor has been cut off.
+ *  @param motor Which motor, TRACE_FRONT or TRACE_BACK
+ *  @return CURRENT_FAULT_ bits, or 0 if the motor is running normally
+ */
+
+uint8_t current_sense_fault (uint8_t motor)
+{
+	current_channel* p_channel = channel_of (motor);
+	return (p_channel == NULL) ? 0 : p_channel->fault;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function turns a motor which was cut off back on. The motor's task calls it
+ *  each time it's in its stopped state, so a motor runs again once the user has
+ *  stopped it; if it's still jammed, it's cut off again.
+ *  @param motor Which motor, TRACE_FRONT or TRACE_BACK
+ */
+
+void current_sense_clear (uint8_t motor)
+{
+	current_channel* p_channel = channel_of (motor);
+	if (p_channel == NULL || p_channel->fault == 0)
+	{
+		return;
+	}
+
+	portENTER_CRITICAL ();
+	p_channel->fault = 0;
+	p_channel->stall_count = 0;
+	if (motor == TRACE_FRONT)
+	{
+		front_bridge::enable ();
+	}
+	else
+	{
+		back_bridge::enable ();
+	}
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints each motor's filtered current, its highest filtered current
+ *  since it was last printed, whether it's cut off and how often it has been.
+ *  @param p_ser The serial device on which to print
+ */
+
+void current_sense_print (emstream* p_ser)
+{
+	*p_ser << PMS ("motor  mA  peak_mA  fault  trips") << endl;
+	for (uint8_t index = 0; index < CURRENT_CHANNELS; index++)
+	{
+		current_channel* p_channel = &channels[index];
+
+		portENTER_CRITICAL ();
+		uint16_t peak = p_channel->peak;
+		p_channel->peak = 0;
+		portEXIT_CRITICAL ();
+
+		if (p_channel->motor == TRACE_FRONT)
+		{
+			*p_ser << PMS ("front");
+		}
+		else
+		{
+			*p_ser << PMS ("back ");
+		}
+		*p_ser << PMS ("  ") << current_sense_ma (p_channel->motor)
+			   << PMS ("  ") << COUNTS_TO_MA (peak);
+		if (p_channel->fault & CURRENT_FAULT_OVER)
+		{
+			*p_ser << PMS ("  over");
+		}
+		else if (p_channel->fault & CURRENT_FAULT_STALL)
+		{
+			*p_ser << PMS ("  stall");
+		}
+		else
+		{
+			*p_ser << PMS ("  -");
+		}
+		*p_ser << PMS ("  ") << p_channel->trips << endl;
+	}
+	if (zero_count < CURRENT_ZERO_SAMPLES)
+	{
+		*p_ser << PMS ("No readings yet") << endl;
+	}
+}
+
+
+#ifndef HAL_HOST
+//-------------------------------------------------------------------------------------
+/** These interrupts run when DMA has filled one half of the double buffer. The other
+ *  half is being filled by then, so this half can be read as it is.
+ */
+
+ISR (DMA_CH2_vect)
+{
+	DMA.CH2.CTRLB |= DMA_CH_TRNIF_bm | DMA_CH_ERRIF_bm;
+	current_sense_sample (readings[0]);
+}
+
+ISR (DMA_CH3_vect)
+{
+	DMA.CH3.CTRLB |= DMA_CH_TRNIF_bm | DMA_CH_ERRIF_bm;
+	current_sense_sample (readings[1]);
+}
+#endif // HAL_HOST
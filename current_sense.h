@@ -0,0 +1,71 @@
+//**************************************************************************************
+/** \file current_sense.h
+ *    This file contains the motor current sensing. The ADC measures both motors'
+ *    current sense voltages once per PWM period, started by the back motor timer's
+ *    overflow, and DMA copies the results into one of two buffers without the CPU.
+ *    The DMA interrupt filters each motor's current and cuts off a motor's bridge
+ *    driver as soon as its current is too high, or has been high for long enough to
+ *    mean the motor is stalled, so a jammed ramp isn't driven until someone notices.
+ *    The motor stays off until its task is told to stop.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _CURRENT_SENSE_H_
+#define _CURRENT_SENSE_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The current which gives a full scale ADC reading above the zero reading, in mA;
+/// it's set by the sense resistors and amplifiers
+#define CURRENT_SENSE_FULL_MA   10000UL
+
+/// Above this current a motor is cut off right away, in mA. Each reading is checked
+/// against it before it's filtered, so the motor is cut off in the PWM period in
+/// which the current goes over
+#define CURRENT_LIMIT_MA        6000UL
+
+/// A motor whose filtered current stays above this for CURRENT_STALL_MS is taken to
+/// be stalled and is cut off, in mA
+#define CURRENT_STALL_MA        3000UL
+#define CURRENT_STALL_MS        100
+
+/// The filter is y += (x - y) / 2^CURRENT_FILTER_SHIFT, once per PWM period
+#define CURRENT_FILTER_SHIFT    2
+
+/// How many readings with the motors off are averaged to find each one's zero
+#define CURRENT_ZERO_SAMPLES    16
+
+/// Why a motor was cut off
+#define CURRENT_FAULT_OVER      0x01        ///< Current went over CURRENT_LIMIT_MA
+#define CURRENT_FAULT_STALL     0x02        ///< Current stayed over CURRENT_STALL_MA
+
+
+// This function starts the ADC, its event trigger and the DMA double buffer
+void current_sense_init (void);
+
+// This function tells the stall detector how many readings there are per second
+void current_sense_set_rate (uint32_t samples_per_s);
+
+// This function filters one pair of readings and cuts off a motor if it must
+void current_sense_sample (const volatile uint16_t* p_readings);
+
+// This function returns a motor's filtered current in mA
+uint16_t current_sense_ma (uint8_t motor);
+
+// This function returns why a motor has been cut off, or 0 if it hasn't
+uint8_t current_sense_fault (uint8_t motor);
+
+// This function turns a motor which was cut off back on; its task calls it when stopped
+void current_sense_clear (uint8_t motor);
+
+// This function prints each motor's current, peak current and faults
+void current_sense_print (emstream* p_ser);
+
+#endif // _CURRENT_SENSE_H_
@@ -0,0 +1,66 @@
+//**************************************************************************************
+/** \file cycle_counter.cpp
+ *    This file contains the code which starts the cycle counter.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "cycle_counter.h"                  // Header for this file
+
+
+/// The upper 16 bits of the cycle count, which the overflow interrupt counts
+static volatile uint16_t overflows = 0;
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets timer/counter F0 to count system clock cycles from 0 to 65535
+ *  over and over, with a low level interrupt each time it wraps.
+ */
+
+void cycle_counter_init (void)
+{
+	TCF0.CTRLA = TC_CLKSEL_OFF_gc;
+	TCF0.CTRLB = TC_WGMODE_NORMAL_gc;
+	TCF0.PER = 0xFFFF;
+	TCF0.CNT = 0;
+	TCF0.INTCTRLA = TC_OVFINTLVL_LO_gc;
+	TCF0.CTRLA = TC_CLKSEL_DIV1_gc;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the 32-bit cycle count. If the counter has wrapped but the
+ *  overflow interrupt hasn't run yet, the overflow is counted here instead.
+ *  @return The number of CPU cycles since cycle_counter_init(), modulo 2^32
+ */
+
+uint32_t cycle_counter_now (void)
+{
+	uint16_t high, low;
+
+	uint8_t saved_sreg = SREG;
+	cli ();
+	high = overflows;
+	low = TCF0.CNT;
+	if ((TCF0.INTFLAGS & TC0_OVFIF_bm) && low < 0x8000)
+	{
+		high++;
+	}
+	SREG = saved_sreg;
+
+	return ((uint32_t)high << 16) | low;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This interrupt counts the upper 16 bits of the cycle count.
+ */
+
+ISR (TCF0_OVF_vect)
+{
+	overflows++;
+}
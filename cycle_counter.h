@@ -0,0 +1,46 @@
+//**************************************************************************************
+/** \file cycle_counter.h
+ *    This file contains a free-running counter of CPU clock cycles, made from timer/
+ *    counter F0 running at the full system clock. The 16-bit count, which wraps every
+ *    2.048 ms at 32 MHz, is used to time short pieces of code; an overflow interrupt
+ *    extends it to 32 bits, which wrap about every two minutes, for longer times.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _CYCLE_COUNTER_H_
+#define _CYCLE_COUNTER_H_
+
+#include "hal.h"                            // Real or emulated register access
+
+
+#ifndef F_CPU
+	/// The system clock frequency, which config_SYSCLOCK() sets to 32 MHz
+	#define F_CPU               32000000UL
+#endif
+
+/// The number of cycle counts in a millisecond
+#define CYCLES_PER_MS       (F_CPU / 1000UL)
+
+
+// This function starts the counter; it's called once from main()
+void cycle_counter_init (void);
+
+// This function returns the full 32-bit cycle count
+uint32_t cycle_counter_now (void);
+
+
+/** This function returns the low 16 bits of the cycle count. The difference of two
+ *  readings, as a uint16_t, is the number of cycles between them as long as it's
+ *  less than 65536.
+ *  @return The cycle count modulo 65536
+ */
+inline uint16_t cycle_counter_now16 (void)
+{
+	return TCF0.CNT;
+}
+
+#endif // _CYCLE_COUNTER_H_
@@ -0,0 +1,134 @@
+//**************************************************************************************
+/** \file fixed_pid.h
+ *    This file contains a PID controller which uses only integer arithmetic, so it can
+ *    run in an interrupt on a processor with no floating point hardware. Gains are in
+ *    Q8 fixed point, which means a gain of 256 is 1.0; the integral is kept in the
+ *    same Q8 units so that small errors still add up over time.
+ *
+ *    Nothing in here touches the hardware, so the same code is run by the host's PID
+ *    simulator as by the motor's speed control interrupt.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _FIXED_PID_H_
+#define _FIXED_PID_H_
+
+#include <stdint.h>
+
+
+/// The gains of a PID controller, in Q8 fixed point (256 means 1.0)
+struct pid_gains
+{
+	int16_t kp;                             ///< Proportional gain
+	int16_t ki;                             ///< Integral gain, per update
+	int16_t kd;                             ///< Derivative gain, per update
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class is a PID controller for integer setpoints and measurements. The output
+ *  is kept between a minimum and a maximum, and the integral stops growing when the
+ *  output is stuck at a limit so it doesn't wind up. The derivative is taken of the
+ *  measurement rather than of the error, so a step in the setpoint doesn't kick the
+ *  output.
+ */
+
+class fixed_pid
+{
+protected:
+	/// The gains, which may be changed while the controller runs
+	pid_gains gains;
+
+	/// Limits of the output
+	int16_t out_min;
+	int16_t out_max;
+
+	/// The integral of the error times the integral gain, in Q8
+	int32_t integral;
+
+	/// The measurement at the last update, for the derivative
+	int16_t last_measured;
+
+public:
+	/** This constructor makes a controller with the given gains and output limits.
+	 *  @param a_gains The proportional, integral and derivative gains in Q8
+	 *  @param a_out_min The smallest output the controller may give
+	 *  @param a_out_max The largest output the controller may give
+	 */
+	fixed_pid (const pid_gains& a_gains, int16_t a_out_min, int16_t a_out_max)
+		: gains (a_gains), out_min (a_out_min), out_max (a_out_max),
+		  integral (0), last_measured (0)
+	{
+	}
+
+	/** This method changes the gains. The integral is kept, so the output doesn't
+	 *  jump when the gains are changed while the controller is running.
+	 *  @param a_gains The new gains in Q8
+	 */
+	void set_gains (const pid_gains& a_gains)
+	{
+		gains = a_gains;
+	}
+
+	/** This method returns the gains.
+	 *  @return The gains in Q8
+	 */
+	const pid_gains& get_gains (void) const
+	{
+		return gains;
+	}
+
+	/** This method forgets the integral and the last measurement, as when the motor
+	 *  has been stopped and is about to be started again.
+	 *  @param measured The measurement right now
+	 */
+	void reset (int16_t measured)
+	{
+		integral = 0;
+		last_measured = measured;
+	}
+
+	/** This method runs the controller once. It must be called at a steady rate,
+	 *  since the integral and derivative gains are per update.
+	 *  @param setpoint The value the measurement should have
+	 *  @param measured The value the measurement has now
+	 *  @return The new output, between the output limits
+	 */
+	int16_t update (int16_t setpoint, int16_t measured)
+	{
+		int16_t error = setpoint - measured;
+		int32_t proportional = (int32_t)gains.kp * error;
+		int32_t derivative = -(int32_t)gains.kd * (int16_t)(measured - last_measured);
+		last_measured = measured;
+
+		// Try adding this update's error to the integral, and keep it only if that
+		// doesn't push an output which is already at a limit further past it
+		int32_t new_integral = integral + (int32_t)gains.ki * error;
+		int32_t output = (proportional + new_integral + derivative) >> 8;
+
+		if (output > out_max)
+		{
+			if (new_integral < integral)
+			{
+				integral = new_integral;
+			}
+			return out_max;
+		}
+		if (output < out_min)
+		{
+			if (new_integral > integral)
+			{
+				integral = new_integral;
+			}
+			return out_min;
+		}
+		integral = new_integral;
+		return (int16_t)output;
+	}
+};
+
+#endif // _FIXED_PID_H_
@@ -0,0 +1,355 @@
+//**************************************************************************************
+/** \file fsm.h
+ *    This file contains a framework for the tasks' state machines. A machine's
+ *    transitions are declared as a list of rows, each saying which state goes to
+ *    which on which event, and the compiler turns the list into a table of the next
+ *    state for every state and event, which goes into program memory. Carrying out
+ *    an event is then one table lookup rather than a chain of switches and ifs, and
+ *    static_assert checks at build time that every row names states and events which
+ *    exist. Each state can have an entry action, an action which runs while it's the
+ *    state, and an exit action, kept in a table in program memory and found by the
+ *    state's number.
+ *
+ *    When FSM_TRACE is 1, which it is unless the build defines NDEBUG or sets it to
+ *    0, each machine keeps a history of its last FSM_HISTORY_SIZE transitions with
+ *    the cycle count at which they happened, and puts them in the event trace. When
+ *    it's 0, none of that is compiled.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _FSM_H_
+#define _FSM_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>                   // Tables in program memory
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+#ifndef FSM_TRACE
+	#ifdef NDEBUG
+		/// Whether the state machines keep a history of their transitions
+		#define FSM_TRACE           0
+	#else
+		#define FSM_TRACE           1
+	#endif
+#endif
+
+#if FSM_TRACE
+	#include "cycle_counter.h"              // Free-running CPU cycle counter
+	#include "trace.h"                      // Time stamped event trace
+#endif
+
+/// How many transitions each machine's history holds; it must be a power of two
+#define FSM_HISTORY_SIZE        16
+
+/// In a transition row, matches any state or any event
+#define FSM_ANY                 0xFF
+
+
+//-------------------------------------------------------------------------------------
+/** This class is one row of a transition table: in state from, event goes to state
+ *  to. Either from or event may be FSM_ANY. It's only a type; it holds no data.
+ *  @param from The state the row applies in
+ *  @param event The event the row applies to
+ *  @param to The state to go to
+ */
+
+template <uint8_t from, uint8_t event, uint8_t to>
+struct fsm_row
+{
+};
+
+
+/** This class is a transition table, made of fsm_row types. The first row which
+ *  matches a state and event is the one which is taken; if none matches, the state
+ *  stays as it is.
+ */
+template <class... rows>
+struct fsm_rows;
+
+/// The end of a transition table, where a state with no matching row stays put
+template <>
+struct fsm_rows<>
+{
+	static constexpr uint8_t next (uint8_t from, uint8_t event)
+	{
+		return (void)event, from;
+	}
+
+	static constexpr bool valid (uint8_t state_count, uint8_t event_count)
+	{
+		return (void)state_count, (void)event_count, true;
+	}
+};
+
+/// A transition table with at least one row left to look at
+template <uint8_t from, uint8_t event, uint8_t to, class... rest>
+struct fsm_rows<fsm_row<from, event, to>, rest...>
+{
+	/** This method finds the state which an event leads to.
+	 *  @param state The state the machine is in
+	 *  @param an_event The event
+	 *  @return The state to go to, which is the same state if nothing matches
+	 */
+	static constexpr uint8_t next (uint8_t state, uint8_t an_event)
+	{
+		return ((from == state || from == FSM_ANY) && (event == an_event || event == FSM_ANY))
+			   ? to : fsm_rows<rest...>::next (state, an_event);
+	}
+
+	/** This method checks that every row names states and events which exist.
+	 *  @param state_count How many states the machine has
+	 *  @param event_count How many events it has
+	 *  @return True if all the rows are good
+	 */
+	static constexpr bool valid (uint8_t state_count, uint8_t event_count)
+	{
+		return (from < state_count || from == FSM_ANY)
+			   && (event < event_count || event == FSM_ANY) && to < state_count
+			   && fsm_rows<rest...>::valid (state_count, event_count);
+	}
+};
+
+
+// These classes count from 0 up to a number at compile time, so that a table can be
+// filled in with one entry for each number
+template <uint8_t... indices>
+struct fsm_indices
+{
+};
+
+template <uint8_t count, uint8_t... indices>
+struct fsm_count_up : fsm_count_up<count - 1, count - 1, indices...>
+{
+};
+
+template <uint8_t... indices>
+struct fsm_count_up<0, indices...>
+{
+	typedef fsm_indices<indices...> type;
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class holds the table of next states for a transition table, in program
+ *  memory. The entry for a state and event is at state * event_count + event; the
+ *  compiler works out every entry from the rows.
+ *  @param rows The transition table, an fsm_rows type
+ *  @param state_count How many states the machine has
+ *  @param event_count How many events it has
+ */
+
+template <class rows, uint8_t state_count, uint8_t event_count,
+		  class indices = typename fsm_count_up<state_count * event_count>::type>
+struct fsm_jump_table;
+
+template <class rows, uint8_t state_count, uint8_t event_count, uint8_t... indices>
+struct fsm_jump_table<rows, state_count, event_count, fsm_indices<indices...> >
+{
+	/// The next state for each state and event
+	static const uint8_t next[state_count * event_count];
+};
+
+// The table of each machine
+template <class rows, uint8_t state_count, uint8_t event_count, uint8_t... indices>
+const uint8_t fsm_jump_table<rows, state_count, event_count, fsm_indices<indices...> >
+	::next[state_count * event_count] PROGMEM =
+{
+	rows::next (indices / event_count, indices % event_count)...
+};
+
+
+/// The actions of one state; any of them may be NULL. Each one is given the event,
+/// or for the action which runs while in the state, whatever its caller passes in
+template <class owner>
+struct fsm_state
+{
+	void (owner::*entry) (uint8_t event);   ///< Runs when the state is entered
+	void (owner::*during) (uint8_t input);  ///< Runs each time run() is called
+	void (owner::*exit) (uint8_t event);    ///< Runs when the state is left
+};
+
+/// One transition in a machine's history
+struct fsm_record
+{
+	uint32_t cycles;                        ///< Cycle count when it happened
+	uint8_t from;                           ///< The state which was left
+	uint8_t event;                          ///< The event which caused it
+	uint8_t to;                             ///< The state which was entered
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class runs a state machine for a task. The state itself is kept by the task,
+ *  in frt_task's state, so that it's seen as before by everything which reads it;
+ *  only the machine changes it. A transition to the same state does nothing, so a
+ *  state's entry and exit actions only run when the state really changes.
+ *  @param owner The task class whose methods are the actions
+ *  @param rows The transition table, an fsm_rows type
+ *  @param state_count How many states there are, numbered from 0
+ *  @param event_count How many events there are, numbered from 0
+ */
+
+template <class owner, class rows, uint8_t state_count, uint8_t event_count>
+class fsm
+{
+protected:
+	static_assert ((uint16_t)state_count * event_count <= 255,
+				   "A state machine's jump table can have at most 255 entries");
+	static_assert (rows::valid (state_count, event_count),
+				   "A transition names a state or event which doesn't exist");
+
+	/// The table of next states
+	typedef fsm_jump_table<rows, state_count, event_count> jump_table;
+
+	/// Each state's actions, in program memory
+	const fsm_state<owner>* p_actions;
+
+#if FSM_TRACE
+	/// Which task this is, as it appears in the event trace
+	uint8_t source;
+
+	/// The last transitions, how many there have been, which wraps around, and how
+	/// many of them the history holds, which stops at FSM_HISTORY_SIZE
+	fsm_record history[FSM_HISTORY_SIZE];
+	uint8_t recorded;
+	uint8_t stored;
+#endif
+
+	/** This method copies a state's actions out of program memory.
+	 *  @param state The state
+	 *  @param p_state Where to put the actions
+	 */
+	void actions_of (uint8_t state, fsm_state<owner>* p_state)
+	{
+		memcpy_P (p_state, &p_actions[state], sizeof (fsm_state<owner>));
+	}
+
+public:
+	/** This constructor makes a machine with an empty history.
+	 *  @param a_actions Each state's actions, a table in program memory with one
+	 *                   entry for each state
+	 *  @param a_source Which task this is, as it should appear in the event trace
+	 */
+	fsm (const fsm_state<owner>* a_actions, uint8_t a_source)
+		: p_actions (a_actions)
+	{
+#if FSM_TRACE
+		source = a_source;
+		recorded = 0;
+		stored = 0;
+#else
+		(void)a_source;
+#endif
+	}
+
+	/** This method looks up the state an event leads to.
+	 *  @param from The state the machine is in
+	 *  @param event The event
+	 *  @return The next state
+	 */
+	static uint8_t next (uint8_t from, uint8_t event)
+	{
+		return pgm_read_byte (&jump_table::next[from * event_count + event]);
+	}
+
+	/** This method carries out an event. If it leads to another state, the old state's
+	 *  exit action runs, the state changes, and the new state's entry action runs.
+	 *  @param p_owner The task whose actions are run
+	 *  @param state The task's state, which is changed
+	 *  @param event The event; one which doesn't exist is ignored
+	 *  @return True if the state changed
+	 */
+	bool fire (owner* p_owner, uint8_t& state, uint8_t event)
+	{
+		if (state >= state_count || event >= event_count)
+		{
+			return false;
+		}
+		uint8_t to = next (state, event);
+		if (to == state)
+		{
+			return false;
+		}
+
+		fsm_state<owner> actions;
+		actions_of (state, &actions);
+		if (actions.exit != NULL)
+		{
+			(p_owner->*actions.exit) (event);
+		}
+
+#if FSM_TRACE
+		fsm_record* p_record = &history[recorded++ & (FSM_HISTORY_SIZE - 1)];
+		p_record->cycles = cycle_counter_now ();
+		p_record->from = state;
+		p_record->event = event;
+		p_record->to = to;
+		if (stored < FSM_HISTORY_SIZE)
+		{
+			stored++;
+		}
+		trace (TRACE_STATE, source, to);
+#endif
+		state = to;
+
+		actions_of (to, &actions);
+		if (actions.entry != NULL)
+		{
+			(p_owner->*actions.entry) (event);
+		}
+		return true;
+	}
+
+	/** This method runs the action of the state the machine is in.
+	 *  @param p_owner The task whose action is run
+	 *  @param state The task's state
+	 *  @param input Whatever the action is to work on, such as a character
+	 *  @return True if it ran, false if the state doesn't exist
+	 */
+	bool run (owner* p_owner, uint8_t state, uint8_t input)
+	{
+		if (state >= state_count)
+		{
+			return false;
+		}
+		fsm_state<owner> actions;
+		actions_of (state, &actions);
+		if (actions.during != NULL)
+		{
+			(p_owner->*actions.during) (input);
+		}
+		return true;
+	}
+
+	/** This method prints the machine's last transitions, oldest first, with the
+	 *  time of each in CPU cycles since the oldest one.
+	 *  @param p_ser The serial device on which to print
+	 */
+	void print_history (emstream* p_ser)
+	{
+#if FSM_TRACE
+		uint8_t held = stored;
+		uint8_t first = recorded - held;
+
+		for (uint8_t index = 0; index < held; index++)
+		{
+			fsm_record* p_record = &history[(uint8_t)(first + index)
+											& (FSM_HISTORY_SIZE - 1)];
+			*p_ser << (p_record->cycles
+					   - history[first & (FSM_HISTORY_SIZE - 1)].cycles)
+				   << ' ' << p_record->from << ' ' << p_record->event
+				   << ' ' << p_record->to << endl;
+		}
+#else
+		*p_ser << PMS ("Transition history is compiled out") << endl;
+#endif
+	}
+};
+
+#endif // _FSM_H_
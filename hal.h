@@ -0,0 +1,36 @@
+//**************************************************************************************
+/** \file hal.h
+ *    This file contains the small hardware abstraction layer which lets the tasks run
+ *    either on the XMEGA or on a Linux host. The application keeps using the usual
+ *    avr-libc names (TCC0, PORTC, OSC, wdt_enable() and so on); when HAL_HOST is
+ *    defined, those come from the emulated headers in the host/ directory instead of
+ *    from avr-libc, and every register write is recorded with a time stamp.
+ *
+ *    The one thing avr-libc can't give us in both builds is a register block picked
+ *    by its numeric address, which the compile-time drivers need; that's HAL_REG().
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include <avr/io.h>                         // Real or emulated port I/O for SFR's
+
+
+#ifdef HAL_HOST
+	/** This macro gives the register block of type \c type at I/O address \c address.
+	 *  On the host the I/O space is an array, so the address is an offset into it.
+	 */
+	#define HAL_REG(type, address)  (*(type*)(hal_io_space + (address)))
+#else
+	/** This macro gives the register block of type \c type at I/O address \c address.
+	 *  On the XMEGA, a constant address compiles to direct \c lds and \c sts.
+	 */
+	#define HAL_REG(type, address)  (*(type*)(address))
+#endif
+
+#endif // _HAL_H_
@@ -0,0 +1,360 @@
+//**************************************************************************************
+/** \file half_bridge_motor.h
+ *    This file contains a driver for a motor which is run by a pair of half bridges,
+ *    one on each compare channel of an XMEGA timer/counter. The registers are picked
+ *    at compile time, so every write to them is a plain store to a fixed address.
+ *    The PWM frequency, the high resolution extension and a dead time can be changed
+ *    while the program runs; duty cycles are given as fractions of the period, so
+ *    they keep their meaning when the period changes.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+/*    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUEN-
+ *    TIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ *    OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HALF_BRIDGE_MOTOR_H_
+#define _HALF_BRIDGE_MOTOR_H_
+
+#include "hal.h"                            // Real or emulated register access
+#include "xmega_util.h"                     // Clock rate, F_CPU
+
+
+// The avr-libc headers only give us TCC0, PORTC and friends as dereferenced pointers,
+// which can't be used as template arguments, so here are the base addresses instead
+#define PORTA_ADDR          0x0600          ///< Base address of I/O port A
+#define PORTB_ADDR          0x0620          ///< Base address of I/O port B
+#define PORTC_ADDR          0x0640          ///< Base address of I/O port C
+#define PORTD_ADDR          0x0660          ///< Base address of I/O port D
+#define PORTE_ADDR          0x0680          ///< Base address of I/O port E
+#define PORTF_ADDR          0x06A0          ///< Base address of I/O port F
+#define TCC0_ADDR           0x0800          ///< Base address of timer/counter C0
+#define TCC1_ADDR           0x0840          ///< Base address of timer/counter C1
+#define TCD0_ADDR           0x0900          ///< Base address of timer/counter D0
+#define TCD1_ADDR           0x0940          ///< Base address of timer/counter D1
+#define TCE0_ADDR           0x0A00          ///< Base address of timer/counter E0
+#define TCF0_ADDR           0x0B00          ///< Base address of timer/counter F0
+
+
+/// A duty cycle of 100%. Duty cycles are fractions of the PWM period in Q14, which
+/// is finer than the timer's compare steps at any frequency the motors use
+#define PWM_DUTY_FULL       16384
+
+/// The lowest and highest PWM frequencies, in Hz. At the lowest the period just fits
+/// in the timer. The highest is set by the interrupts which run once per period, the
+/// ramp tick, the coordinated update's timeout and the current filter; any faster and
+/// they would leave the control loops and tasks too little of the CPU. There are 1280
+/// compare steps at the highest, a little over 10 bits
+#define PWM_MIN_HZ          500UL
+#define PWM_MAX_HZ          25000UL
+
+/// How many times finer the compare steps are with the high resolution extension
+#define PWM_HIRES_FACTOR    4
+
+
+//-------------------------------------------------------------------------------------
+/** This class drives one motor through two half bridges. The "port" half bridge is
+ *  connected to compare channel A of the timer and the "starboard" one to channel B;
+ *  the timer's port supplies the two PWM pins (pins 0 and 1) and a separate pin on
+ *  another port enables the bridge driver. Everything is static and the addresses are
+ *  template parameters, so there are no objects and no pointers at run time.
+ *
+ *  A motor is declared with one line, for example
+ *  \code
+ *  typedef half_bridge_motor<TCC0_ADDR, PORTC_ADDR, PORTA_ADDR, 2> back_bridge;
+ *  \endcode
+ *  @param timer Base address of the timer/counter which makes the PWM
+ *  @param port Base address of the port which has the timer's output pins
+ *  @param enable_port Base address of the port which has the enable pin
+ *  @param enable_pin Number (0 - 7) of the enable pin
+ */
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+class half_bridge_motor
+{
+protected:
+	/// The timer/counter which makes the PWM for this motor
+	static TC0_t& tc (void) { return HAL_REG (TC0_t, timer); }
+
+	/// The port which has the PWM pins
+	static PORT_t& pwm_port (void) { return HAL_REG (PORT_t, port); }
+
+	/// The port which has the driver enable pin
+	static PORT_t& en_port (void) { return HAL_REG (PORT_t, enable_port); }
+
+	/// The high resolution extension of the timers on the same port as this one
+	static HIRES_t& hires_ext (void) { return HAL_REG (HIRES_t, (timer & 0xFF00) + 0x90); }
+
+	/// The bit which turns on the high resolution extension for this timer
+	static const uint8_t hires_bit = (timer & 0x40) ? HIRES_HREN_TC1_gc : HIRES_HREN_TC0_gc;
+
+	// The PWM configuration, which configure() sets
+	static uint32_t frequency_hz;               ///< PWM frequency
+	static uint16_t top;                        ///< Compare steps in one period
+	static uint16_t dead;                       ///< Dead time, in compare steps
+	static uint16_t dead_time_ns;               ///< Dead time, as it was asked for
+	static bool hires_on;                       ///< Whether the extension is on
+
+	// The duty cycles last set, so they can be put back after the period changes
+	static uint16_t port_duty;
+	static uint16_t starboard_duty;
+
+	/** This method turns a duty cycle into a compare value for the present period.
+	 *  Pulses, on or off, which are shorter than the dead time are left out; the
+	 *  bridge driver can't make them, and its bootstrap supply needs some off time.
+	 *  @param duty The duty cycle, from 0 to PWM_DUTY_FULL
+	 *  @return The compare value, from 0 to the number of steps in the period
+	 */
+	static uint16_t compare (uint16_t duty)
+	{
+		uint16_t counts = (duty >= PWM_DUTY_FULL) ? top
+							: (uint16_t)(((uint32_t)duty * top) >> 14);
+		if (dead != 0)
+		{
+			if (counts < dead)
+			{
+				counts = 0;
+			}
+			else if (counts > top - dead)
+			{
+				counts = top - dead;
+			}
+		}
+		return counts;
+	}
+
+public:
+	/** This method sets up the pins and the timer for single slope PWM on channels A
+	 *  and B with both duty cycles at zero, then turns on the bridge driver.
+	 *  @param a_frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+	 */
+	static void init (uint32_t a_frequency_hz)
+	{
+		pwm_port ().OUTCLR = PIN0_bm | PIN1_bm;     // Make sure the pins are off first
+		pwm_port ().DIRSET = PIN0_bm | PIN1_bm;     // Set the pins as outputs
+		pwm_port ().OUTSET = PIN0_bm | PIN1_bm;     // Turn the pins on again
+
+		tc ().CTRLB = TC_WGMODE_SS_gc | TC0_CCAEN_bm | TC0_CCBEN_bm;
+		configure (a_frequency_hz, false, 0);
+		tc ().CTRLD = 0;                            // All event stuff off
+		tc ().CTRLC = 0;                            // Timer counter is always on
+		tc ().CTRLA |= TC_CLKSEL_DIV1_gc;           // Prescaler is just clock frequency
+
+		enable ();
+	}
+
+	/** This method says whether the high resolution extension can be used. It needs
+	 *  the clock which the extension runs from to be four times the timer's clock,
+	 *  which is set by the system clock prescalers B and C.
+	 *  @return True if the prescalers are set up for the extension
+	 */
+	static bool hires_available (void)
+	{
+		uint8_t divider = CLK.PSCTRL & CLK_PSBCDIV_gm;
+		return divider == CLK_PSBCDIV_4_1_gc || divider == CLK_PSBCDIV_2_2_gc;
+	}
+
+	/** This method sets the PWM frequency, the resolution and the dead time. The
+	 *  timer counts the CPU clock, so the frequency sets how many compare steps there
+	 *  are in a period; the high resolution extension makes them four times finer.
+	 *  The new period is written straight to the timer and the duty cycles are put
+	 *  back for it, so this should be called with interrupts off and the timer should
+	 *  then be restarted from zero, as motor_pwm_configure() does.
+	 *  @param a_frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+	 *  @param use_hires True to use the high resolution extension
+	 *  @param a_dead_ns The shortest on or off pulse the bridge gets, in ns
+	 *  @return True if the configuration was set, false if the frequency is out of
+	 *          range, the extension isn't available, or the dead time takes up half
+	 *          the period or more
+	 */
+	static bool configure (uint32_t a_frequency_hz, bool use_hires, uint16_t a_dead_ns)
+	{
+		if (a_frequency_hz < PWM_MIN_HZ || a_frequency_hz > PWM_MAX_HZ
+			|| (use_hires && !hires_available ()))
+		{
+			return false;
+		}
+
+		uint8_t factor = use_hires ? PWM_HIRES_FACTOR : 1;
+		uint32_t steps = F_CPU / a_frequency_hz * factor;
+		uint32_t dead_steps = (uint32_t)a_dead_ns * (F_CPU / 1000000UL) * factor / 1000;
+		if (steps > 0xFFFF || dead_steps * 2 >= steps)
+		{
+			return false;
+		}
+
+		frequency_hz = a_frequency_hz;
+		top = (uint16_t)steps;
+		dead = (uint16_t)dead_steps;
+		dead_time_ns = a_dead_ns;
+		hires_on = use_hires;
+
+		hires_ext ().CTRLA = (hires_ext ().CTRLA & ~hires_bit) | (use_hires ? hires_bit : 0);
+		uint16_t port_compare = compare (port_duty);
+		uint16_t starboard_compare = compare (starboard_duty);
+		tc ().PER = top - 1;
+		tc ().CCA = port_compare;
+		tc ().CCB = starboard_compare;
+		tc ().CCABUF = port_compare;
+		tc ().CCBBUF = starboard_compare;
+		return true;
+	}
+
+	/** This method returns the PWM frequency.
+	 *  @return The frequency in Hz
+	 */
+	static uint32_t frequency (void)
+	{
+		return frequency_hz;
+	}
+
+	/** This method returns how many compare steps there are in one PWM period, which
+	 *  is how finely the duty cycle can really be set.
+	 *  @return The number of steps
+	 */
+	static uint16_t steps (void)
+	{
+		return top;
+	}
+
+	/** This method says whether the high resolution extension is on.
+	 *  @return True if it's on
+	 */
+	static bool hires (void)
+	{
+		return hires_on;
+	}
+
+	/** This method returns the dead time.
+	 *  @return The dead time in ns, as it was set
+	 */
+	static uint16_t dead_ns (void)
+	{
+		return dead_time_ns;
+	}
+
+	/** This method returns the compare value the timer is using for the port side.
+	 *  @return The compare value of channel A, from 0 to the number of steps
+	 */
+	static uint16_t port_compare (void)
+	{
+		return tc ().CCA;
+	}
+
+	/** This method returns the compare value the timer is using for the starboard side.
+	 *  @return The compare value of channel B, from 0 to the number of steps
+	 */
+	static uint16_t starboard_compare (void)
+	{
+		return tc ().CCB;
+	}
+
+	/** This method stops the timer, clears its count and starts it again from the given
+	 *  clock. Timers which are started from the same event channel count in step.
+	 *  @param clock The timer's clock selection, such as TC_CLKSEL_EVCH7_gc
+	 */
+	static void restart_from (uint8_t clock)
+	{
+		tc ().CTRLA = TC_CLKSEL_OFF_gc;
+		tc ().CNT = 0;
+		tc ().CTRLA = clock;
+	}
+
+	/** This method holds the buffered compare values back from the timer. Values
+	 *  written while it's held are kept in the buffer registers until the hold is let go.
+	 */
+	static void lock_update (void)
+	{
+		tc ().CTRLFSET = TC0_LUPD_bm;
+	}
+
+	/** This method lets the buffered compare values go to the timer again, at the
+	 *  next overflow.
+	 */
+	static void unlock_update (void)
+	{
+		tc ().CTRLFCLR = TC0_LUPD_bm;
+	}
+
+	/** This method turns on the bridge driver's enable line.
+	 */
+	static void enable (void)
+	{
+		en_port ().OUTCLR = (1 << enable_pin);
+		en_port ().DIRSET = (1 << enable_pin);
+		en_port ().OUTSET = (1 << enable_pin);
+	}
+
+	/** This method turns off the bridge driver's enable line.
+	 */
+	static void disable (void)
+	{
+		en_port ().OUTCLR = (1 << enable_pin);
+	}
+
+	/** This method sets the duty cycle of the port side half bridge (channel A). The
+	 *  new value takes effect at the next timer overflow.
+	 *  @param duty The duty cycle, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_port_duty (uint16_t duty)
+	{
+		port_duty = duty;
+		tc ().CCABUF = compare (duty);
+	}
+
+	/** This method sets the duty cycle of the starboard side half bridge (channel B).
+	 *  @param duty The duty cycle, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_starboard_duty (uint16_t duty)
+	{
+		starboard_duty = duty;
+		tc ().CCBBUF = compare (duty);
+	}
+
+	/** This method sets the duty cycles of both half bridges.
+	 *  @param a_port_duty The duty cycle for channel A, from 0 to PWM_DUTY_FULL
+	 *  @param a_starboard_duty The duty cycle for channel B, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_duty (uint16_t a_port_duty, uint16_t a_starboard_duty)
+	{
+		port_duty = a_port_duty;
+		starboard_duty = a_starboard_duty;
+		tc ().CCABUF = compare (a_port_duty);
+		tc ().CCBBUF = compare (a_starboard_duty);
+	}
+};
+
+
+// The static members of each half bridge motor
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint32_t half_bridge_motor<timer, port, enable_port, enable_pin>::frequency_hz = 0;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint16_t half_bridge_motor<timer, port, enable_port, enable_pin>::top = 1;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint16_t half_bridge_motor<timer, port, enable_port, enable_pin>::dead = 0;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint16_t half_bridge_motor<timer, port, enable_port, enable_pin>::dead_time_ns = 0;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+bool half_bridge_motor<timer, port, enable_port, enable_pin>::hires_on = false;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint16_t half_bridge_motor<timer, port, enable_port, enable_pin>::port_duty = 0;
+
+template <uint16_t timer, uint16_t port, uint16_t enable_port, uint8_t enable_pin>
+uint16_t half_bridge_motor<timer, port, enable_port, enable_pin>::starboard_duty = 0;
+
+#endif // _HALF_BRIDGE_MOTOR_H_
@@ -0,0 +1,44 @@
+//**************************************************************************************
+/** \file host/avr/eeprom.h
+ *    This file stands in for avr-libc's <avr/eeprom.h> in the host build. There's no
+ *    EEPROM on a PC, so variables put in it with EEMEM are ordinary variables, and
+ *    what's written to them lasts until the program ends. They start out as zeros
+ *    rather than the 0xFF of an erased EEPROM, which a CRC check catches just the same.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_AVR_EEPROM_H_
+#define _HOST_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM
+
+
+/** This function reads a block of bytes from the emulated EEPROM.
+ *  @param p_dst Where to put the bytes
+ *  @param p_src Where they are in the EEPROM
+ *  @param size How many bytes to read
+ */
+static inline void eeprom_read_block (void* p_dst, const void* p_src, size_t size)
+{
+	memcpy (p_dst, p_src, size);
+}
+
+/** This function writes a byte to the emulated EEPROM. The real one only writes the
+ *  byte if it has changed, to save wear; here that makes no difference.
+ *  @param p_dst Where it goes in the EEPROM
+ *  @param value The byte
+ */
+static inline void eeprom_update_byte (uint8_t* p_dst, uint8_t value)
+{
+	*p_dst = value;
+}
+
+#endif // _HOST_AVR_EEPROM_H_
@@ -0,0 +1,29 @@
+//**************************************************************************************
+/** \file host/avr/interrupt.h
+ *    This file stands in for avr-libc's <avr/interrupt.h> in the host build. The
+ *    global interrupt flag is bit 7 of the emulated SREG, so turning interrupts on and
+ *    off shows up in the register write log like everything else. Interrupt service
+ *    routines become plain functions which the emulation may call.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_AVR_INTERRUPT_H_
+#define _HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+
+/// Turn off interrupts by clearing the I bit in the emulated status register
+static inline void cli (void) { SREG &= (uint8_t)~0x80; }
+
+/// Turn on interrupts by setting the I bit in the emulated status register
+static inline void sei (void) { SREG |= 0x80; }
+
+/// An interrupt service routine is just a function with C linkage on the host
+#define ISR(vector, ...)    extern "C" void vector (void); extern "C" void vector (void)
+
+#endif // _HOST_AVR_INTERRUPT_H_
@@ -0,0 +1,406 @@
+//**************************************************************************************
+/** \file host/avr/io.h
+ *    This file stands in for avr-libc's <avr/io.h> in the host build. The XMEGA I/O
+ *    space is an array of bytes, and the register types are small classes which
+ *    record every write (with a time stamp) before storing the value, so the timing
+ *    of the tasks' register activity can be measured on a PC. Only the peripherals
+ *    and bit names which the robot's code uses are declared; the layouts and values
+ *    are those of the ATxmega128A3U.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_AVR_IO_H_
+#define _HOST_AVR_IO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/// Size of the emulated I/O space; everything from 0x0000 to 0x0FFF is a register
+#define HAL_IO_SIZE         0x1000
+
+/// The emulated I/O space, which lives in hal_host.cpp
+extern uint8_t hal_io_space[HAL_IO_SIZE];
+
+// These functions in hal_host.cpp do the work of a register write: they store the
+// value, record the write and model whatever the hardware does as a side effect
+void hal_io_write8 (uint16_t address, uint8_t value);
+void hal_io_write16 (uint16_t address, uint16_t value);
+
+
+//-------------------------------------------------------------------------------------
+/** This class is an 8-bit register in the emulated I/O space. It reads like a
+ *  uint8_t, and writes go through hal_io_write8() so they are logged.
+ */
+
+class hal_register8
+{
+protected:
+	uint8_t value;                          ///< The register's contents
+
+	/// The register's I/O address, worked out from where it sits in the I/O space
+	uint16_t address (void) const
+	{
+		return (uint16_t)((const uint8_t*)this - hal_io_space);
+	}
+
+public:
+	operator uint8_t (void) const { return value; }
+	hal_register8& operator= (uint8_t v) { hal_io_write8 (address (), v); return *this; }
+	hal_register8& operator= (const hal_register8& r) { return *this = (uint8_t)r; }
+	hal_register8& operator|= (uint8_t v) { return *this = (uint8_t)(value | v); }
+	hal_register8& operator&= (uint8_t v) { return *this = (uint8_t)(value & v); }
+	hal_register8& operator^= (uint8_t v) { return *this = (uint8_t)(value ^ v); }
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class is a 16-bit register in the emulated I/O space. It's stored as two
+ *  bytes, like the XMEGA's, so it doesn't need any alignment in a register block.
+ */
+
+class hal_register16
+{
+protected:
+	uint8_t low;                            ///< Low byte of the register
+	uint8_t high;                           ///< High byte of the register
+
+	/// The register's I/O address, worked out from where it sits in the I/O space
+	uint16_t address (void) const
+	{
+		return (uint16_t)((const uint8_t*)this - hal_io_space);
+	}
+
+public:
+	operator uint16_t (void) const { return (uint16_t)(low | (high << 8)); }
+	hal_register16& operator= (uint16_t v) { hal_io_write16 (address (), v); return *this; }
+	hal_register16& operator= (const hal_register16& r) { return *this = (uint16_t)r; }
+	hal_register16& operator|= (uint16_t v) { return *this = (uint16_t)(*this | v); }
+	hal_register16& operator&= (uint16_t v) { return *this = (uint16_t)(*this & v); }
+	hal_register16& operator+= (uint16_t v) { return *this = (uint16_t)(*this + v); }
+};
+
+typedef hal_register8 register8_t;
+typedef hal_register16 register16_t;
+
+/// Reserved bytes in a register block, which keep the real register offsets
+#define HAL_RESERVED(name, n)   uint8_t name[n]
+
+
+//-------------------------------------------------------------------------------------
+// Register blocks
+
+/// 16-bit timer/counter type 0 (four compare channels)
+typedef struct TC0_struct
+{
+	register8_t CTRLA;
+	register8_t CTRLB;
+	register8_t CTRLC;
+	register8_t CTRLD;
+	register8_t CTRLE;
+	HAL_RESERVED (reserved_0x05, 1);
+	register8_t INTCTRLA;
+	register8_t INTCTRLB;
+	register8_t CTRLFCLR;
+	register8_t CTRLFSET;
+	register8_t CTRLGCLR;
+	register8_t CTRLGSET;
+	register8_t INTFLAGS;
+	HAL_RESERVED (reserved_0x0D, 2);
+	register8_t TEMP;
+	HAL_RESERVED (reserved_0x10, 16);
+	register16_t CNT;
+	HAL_RESERVED (reserved_0x22, 4);
+	register16_t PER;
+	register16_t CCA;
+	register16_t CCB;
+	register16_t CCC;
+	register16_t CCD;
+	HAL_RESERVED (reserved_0x30, 6);
+	register16_t PERBUF;
+	register16_t CCABUF;
+	register16_t CCBBUF;
+	register16_t CCCBUF;
+	register16_t CCDBUF;
+} TC0_t;
+
+/// 16-bit timer/counter type 1; same layout as type 0 but only channels A and B
+typedef TC0_t TC1_t;
+
+/// I/O port
+typedef struct PORT_struct
+{
+	register8_t DIR;
+	register8_t DIRSET;
+	register8_t DIRCLR;
+	register8_t DIRTGL;
+	register8_t OUT;
+	register8_t OUTSET;
+	register8_t OUTCLR;
+	register8_t OUTTGL;
+	register8_t IN;
+	register8_t INTCTRL;
+	register8_t INT0MASK;
+	register8_t INT1MASK;
+	register8_t INTFLAGS;
+	HAL_RESERVED (reserved_0x0D, 1);
+	register8_t REMAP;
+	HAL_RESERVED (reserved_0x0F, 1);
+	register8_t PIN0CTRL;
+	register8_t PIN1CTRL;
+	register8_t PIN2CTRL;
+	register8_t PIN3CTRL;
+	register8_t PIN4CTRL;
+	register8_t PIN5CTRL;
+	register8_t PIN6CTRL;
+	register8_t PIN7CTRL;
+} PORT_t;
+
+/// Oscillator control
+typedef struct OSC_struct
+{
+	register8_t CTRL;
+	register8_t STATUS;
+	register8_t XOSCCTRL;
+	register8_t XOSCFAIL;
+	register8_t RC32KCAL;
+	register8_t PLLCTRL;
+	register8_t DFLLCTRL;
+} OSC_t;
+
+/// Clock system
+typedef struct CLK_struct
+{
+	register8_t CTRL;
+	register8_t PSCTRL;
+	register8_t LOCK;
+	register8_t RTCCTRL;
+} CLK_t;
+
+/// Programmable multilevel interrupt controller
+typedef struct PMIC_struct
+{
+	register8_t STATUS;
+	register8_t INTPRI;
+	register8_t CTRL;
+} PMIC_t;
+
+/// Reset controller
+typedef struct RST_struct
+{
+	register8_t STATUS;
+	register8_t CTRL;
+} RST_t;
+
+/// Watchdog timer
+typedef struct WDT_struct
+{
+	register8_t CTRL;
+	register8_t WINCTRL;
+	register8_t STATUS;
+} WDT_t;
+
+/// Universal synchronous/asynchronous serial receiver and transmitter
+typedef struct USART_struct
+{
+	register8_t DATA;
+	register8_t STATUS;
+	HAL_RESERVED (reserved_0x02, 1);
+	register8_t CTRLA;
+	register8_t CTRLB;
+	register8_t CTRLC;
+	register8_t BAUDCTRLA;
+	register8_t BAUDCTRLB;
+} USART_t;
+
+/// Event system
+typedef struct EVSYS_struct
+{
+	register8_t CH0MUX;
+	register8_t CH1MUX;
+	register8_t CH2MUX;
+	register8_t CH3MUX;
+	register8_t CH4MUX;
+	register8_t CH5MUX;
+	register8_t CH6MUX;
+	register8_t CH7MUX;
+	register8_t CH0CTRL;
+	register8_t CH1CTRL;
+	register8_t CH2CTRL;
+	register8_t CH3CTRL;
+	register8_t CH4CTRL;
+	register8_t CH5CTRL;
+	register8_t CH6CTRL;
+	register8_t CH7CTRL;
+	register8_t STROBE;
+	register8_t DATA;
+} EVSYS_t;
+
+/// High resolution extension of the timers on one port
+typedef struct HIRES_struct
+{
+	register8_t CTRLA;
+} HIRES_t;
+
+
+//-------------------------------------------------------------------------------------
+// Peripheral instances, at their ATxmega128A3U addresses
+
+#define CCP         (*(register8_t*)(hal_io_space + 0x0034))
+#define SREG        (*(register8_t*)(hal_io_space + 0x003F))
+#define CLK         (*(CLK_t*)(hal_io_space + 0x0040))
+#define OSC         (*(OSC_t*)(hal_io_space + 0x0050))
+#define RST         (*(RST_t*)(hal_io_space + 0x0078))
+#define WDT         (*(WDT_t*)(hal_io_space + 0x0080))
+#define PMIC        (*(PMIC_t*)(hal_io_space + 0x00A0))
+#define EVSYS       (*(EVSYS_t*)(hal_io_space + 0x0180))
+#define PORTA       (*(PORT_t*)(hal_io_space + 0x0600))
+#define PORTB       (*(PORT_t*)(hal_io_space + 0x0620))
+#define PORTC       (*(PORT_t*)(hal_io_space + 0x0640))
+#define PORTD       (*(PORT_t*)(hal_io_space + 0x0660))
+#define PORTE       (*(PORT_t*)(hal_io_space + 0x0680))
+#define PORTF       (*(PORT_t*)(hal_io_space + 0x06A0))
+#define TCC0        (*(TC0_t*)(hal_io_space + 0x0800))
+#define TCC1        (*(TC1_t*)(hal_io_space + 0x0840))
+#define HIRESC      (*(HIRES_t*)(hal_io_space + 0x0890))
+#define USARTC0     (*(USART_t*)(hal_io_space + 0x08A0))
+#define TCD0        (*(TC0_t*)(hal_io_space + 0x0900))
+#define TCD1        (*(TC1_t*)(hal_io_space + 0x0940))
+#define HIRESD      (*(HIRES_t*)(hal_io_space + 0x0990))
+#define TCE0        (*(TC0_t*)(hal_io_space + 0x0A00))
+#define TCE1        (*(TC1_t*)(hal_io_space + 0x0A40))
+#define TCF0        (*(TC0_t*)(hal_io_space + 0x0B00))
+
+#define PMIC_CTRL   PMIC.CTRL
+
+
+//-------------------------------------------------------------------------------------
+// Bit masks, bit positions and group configurations
+
+#define PIN0_bm                     0x01
+#define PIN1_bm                     0x02
+#define PIN2_bm                     0x04
+#define PIN3_bm                     0x08
+#define PIN4_bm                     0x10
+#define PIN5_bm                     0x20
+#define PIN6_bm                     0x40
+#define PIN7_bm                     0x80
+
+#define TC_CLKSEL_gm                0x0F
+#define TC_CLKSEL_OFF_gc            0x00
+#define TC_CLKSEL_DIV1_gc           0x01
+#define TC_CLKSEL_DIV2_gc           0x02
+#define TC_CLKSEL_DIV4_gc           0x03
+#define TC_CLKSEL_DIV8_gc           0x04
+#define TC_CLKSEL_DIV64_gc          0x05
+#define TC_CLKSEL_DIV256_gc         0x06
+#define TC_CLKSEL_DIV1024_gc        0x07
+#define TC_CLKSEL_EVCH7_gc          0x0F
+#define TC_WGMODE_gm                0x07
+#define TC_WGMODE_NORMAL_gc         0x00
+#define TC_WGMODE_SS_gc             0x03
+#define TC0_CCAEN_bm                0x10
+#define TC0_CCBEN_bm                0x20
+#define TC0_CCCEN_bm                0x40
+#define TC0_CCDEN_bm                0x80
+#define TC1_CCAEN_bm                0x10
+#define TC1_CCBEN_bm                0x20
+#define TC_OVFINTLVL_gm             0x03
+#define TC_OVFINTLVL_OFF_gc         0x00
+#define TC_OVFINTLVL_LO_gc          0x01
+#define TC_OVFINTLVL_MED_gc         0x02
+#define TC_OVFINTLVL_HI_gc          0x03
+#define TC0_LUPD_bm                 0x02
+#define TC1_LUPD_bm                 0x02
+#define TC0_OVFIF_bm                0x01
+#define TC1_OVFIF_bm                0x01
+#define TC_EVACT_gm                 0xE0
+#define TC_EVACT_QDEC_gc            0x60
+#define TC_EVSEL_gm                 0x0F
+#define TC_EVSEL_CH0_gc             0x08
+
+#define HIRES_HREN_gm               0x03
+#define HIRES_HREN_NONE_gc          0x00
+#define HIRES_HREN_TC0_gc           0x01
+#define HIRES_HREN_TC1_gc           0x02
+#define HIRES_HREN_BOTH_gc          0x03
+
+#define PORT_ISC_gm                 0x07
+#define PORT_ISC_LEVEL_gc           0x03
+
+#define EVSYS_CHMUX_OFF_gc          0x00
+#define EVSYS_CHMUX_PRESCALER_1_gc  0x80
+#define EVSYS_CHMUX_PORTE_PIN0_gc   0x70
+#define EVSYS_QDEN_bm               0x08
+#define EVSYS_DIGFILT_2SAMPLES_gc   0x01
+
+#define OSC_RC2MEN_bm               0x01
+#define OSC_RC32MEN_bm              0x02
+#define OSC_RC32KEN_bm              0x04
+#define OSC_XOSCEN_bm               0x08
+#define OSC_PLLEN_bm                0x10
+#define OSC_RC2MRDY_bm              0x01
+#define OSC_RC32MRDY_bm             0x02
+#define OSC_RC32KRDY_bm             0x04
+#define OSC_XOSCRDY_bm              0x08
+#define OSC_PLLRDY_bm               0x10
+#define OSC_FRQRANGE_04TO2_gc       0x00
+#define OSC_FRQRANGE_2TO9_gc        0x40
+#define OSC_FRQRANGE_9TO12_gc       0x80
+#define OSC_FRQRANGE_12TO16_gc      0xC0
+#define OSC_XOSCSEL_EXTCLK_gc       0x00
+#define OSC_XOSCSEL_XTAL_256CLK_gc  0x03
+#define OSC_XOSCSEL_XTAL_1KCLK_gc   0x07
+#define OSC_XOSCSEL_XTAL_16KCLK_gc  0x0B
+#define OSC_PLLSRC_RC2M_gc          0x00
+#define OSC_PLLSRC_RC32M_gc         0x80
+#define OSC_PLLSRC_XOSC_gc          0xC0
+#define OSC_PLLFAC_gm               0x1F
+#define OSC_PLLFAC1_bm              0x02
+
+#define CLK_SCLKSEL_gm              0x07
+#define CLK_SCLKSEL_RC2M_gc         0x00
+#define CLK_SCLKSEL_RC32M_gc        0x01
+#define CLK_SCLKSEL_RC32K_gc        0x02
+#define CLK_SCLKSEL_XOSC_gc         0x03
+#define CLK_SCLKSEL_PLL_gc          0x04
+#define CLK_PSBCDIV_gm              0x03
+#define CLK_PSBCDIV_1_1_gc          0x00
+#define CLK_PSBCDIV_1_2_gc          0x01
+#define CLK_PSBCDIV_4_1_gc          0x02
+#define CLK_PSBCDIV_2_2_gc          0x03
+
+#define PMIC_LOLVLEN_bp             0
+#define PMIC_MEDLVLEN_bp            1
+#define PMIC_HILVLEN_bp             2
+#define PMIC_LOLVLEN_bm             0x01
+#define PMIC_MEDLVLEN_bm            0x02
+#define PMIC_HILVLEN_bm             0x04
+
+#define RST_PORF_bm                 0x01
+#define RST_EXTRF_bm                0x02
+#define RST_BORF_bm                 0x04
+#define RST_WDRF_bm                 0x08
+#define RST_PDIRF_bm                0x10
+#define RST_SRF_bm                  0x20
+
+#define CCP_IOREG_gc                0xD8
+
+#define USART_RXCINTLVL_gm          0x30
+#define USART_RXCINTLVL_OFF_gc      0x00
+#define USART_RXCINTLVL_LO_gc       0x10
+#define USART_RXCINTLVL_MED_gc      0x20
+#define USART_RXCINTLVL_HI_gc       0x30
+#define USART_DREINTLVL_gm          0x03
+#define USART_DREINTLVL_OFF_gc      0x00
+#define USART_DREINTLVL_LO_gc       0x01
+#define USART_RXCIF_bm              0x80
+#define USART_TXCIF_bm              0x40
+#define USART_DREIF_bm              0x20
+
+
+#endif // _HOST_AVR_IO_H_
@@ -0,0 +1,33 @@
+//**************************************************************************************
+/** \file host/avr/pgmspace.h
+ *    This file stands in for avr-libc's <avr/pgmspace.h> in the host build. There's
+ *    only one address space on a PC, so program memory strings are ordinary strings.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                   const char*
+#define PSTR(s)                 (s)
+
+#define pgm_read_byte(p)        (*(const uint8_t*)(p))
+#define pgm_read_word(p)        (*(const uint16_t*)(p))
+#define pgm_read_dword(p)       (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)         (*(void* const*)(p))
+
+#define strcmp_P                strcmp
+#define strncmp_P               strncmp
+#define strlen_P                strlen
+#define strcpy_P                strcpy
+#define memcpy_P                memcpy
+
+#endif // _HOST_AVR_PGMSPACE_H_
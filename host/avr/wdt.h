@@ -0,0 +1,34 @@
+//**************************************************************************************
+/** \file host/avr/wdt.h
+ *    This file stands in for avr-libc's <avr/wdt.h> in the host build. The watchdog
+ *    control register is emulated; enabling it starts a timer in hal_host.cpp which
+ *    ends the program, as a watchdog reset would, unless wdt_reset() is called in time.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_AVR_WDT_H_
+#define _HOST_AVR_WDT_H_
+
+#include <stdint.h>
+
+// Watchdog timeouts, numbered as in avr-libc
+#define WDTO_15MS       0
+#define WDTO_30MS       1
+#define WDTO_60MS       2
+#define WDTO_120MS      3
+#define WDTO_250MS      4
+#define WDTO_500MS      5
+#define WDTO_1S         6
+#define WDTO_2S         7
+#define WDTO_4S         8
+#define WDTO_8S         9
+
+void wdt_enable (uint8_t timeout);
+void wdt_disable (void);
+void wdt_reset (void);
+
+#endif // _HOST_AVR_WDT_H_
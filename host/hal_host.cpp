@@ -0,0 +1,274 @@
+//**************************************************************************************
+/** \file host/hal_host.cpp
+ *    This file contains the emulated XMEGA I/O space for the host build. Every write
+ *    to a register is stored in a log along with the time at which it happened; when
+ *    the program exits, the log is written as CSV to the file named by the
+ *    HAL_WRITE_LOG environment variable, so loop latency and jitter can be worked out
+ *    afterwards (see write_log_stats.py). A few side effects of register writes are
+ *    modelled so that the code runs as it would on the chip:
+ *    \li Port DIRSET/DIRCLR/DIRTGL and OUTSET/OUTCLR/OUTTGL change DIR and OUT
+ *    \li Oscillators are ready as soon as they're enabled in OSC.CTRL
+ *    \li The watchdog ends the program with exit code 3 if it isn't reset in time
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <avr/io.h>                         // Emulated port I/O for SFR's
+#include <avr/wdt.h>                        // Emulated watchdog timer
+
+
+/// How many register writes the log can hold; later writes are counted but not kept
+#define HAL_WRITE_LOG_SIZE      (1UL << 20)
+
+/// Exit code used when the emulated watchdog runs out, so scripts can tell
+#define HAL_WATCHDOG_EXIT       3
+
+
+/// The emulated I/O space
+uint8_t hal_io_space[HAL_IO_SIZE] __attribute__ ((aligned (8)));
+
+
+/// One entry in the register write log
+struct hal_write_record
+{
+	uint64_t time_ns;                       ///< When the write happened
+	uint16_t address;                       ///< I/O address of the register
+	uint16_t value;                         ///< Value which was written
+	uint8_t width;                          ///< Register width, 8 or 16 bits
+};
+
+/// The register write log
+static hal_write_record* write_log = NULL;
+
+/// How many writes have happened, including any that didn't fit in the log
+static uint32_t write_count = 0;
+
+/// Time at which the emulated watchdog runs out, or 0 if it isn't enabled
+static volatile uint64_t watchdog_deadline_ns = 0;
+
+/// Watchdog period in nanoseconds, set when the watchdog is enabled
+static uint64_t watchdog_period_ns = 0;
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the time since some arbitrary moment in nanoseconds.
+ */
+
+static uint64_t now_ns (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts a register write into the log.
+ */
+
+static void log_write (uint16_t address, uint16_t value, uint8_t width)
+{
+	uint32_t index = __atomic_fetch_add (&write_count, 1, __ATOMIC_RELAXED);
+
+	if (write_log != NULL && index < HAL_WRITE_LOG_SIZE)
+	{
+		write_log[index].time_ns = now_ns ();
+		write_log[index].address = address;
+		write_log[index].value = value;
+		write_log[index].width = width;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function writes the register write log to the file named by HAL_WRITE_LOG.
+ *  It is called when the program exits.
+ */
+
+static void dump_write_log (void)
+{
+	const char* file_name = getenv ("HAL_WRITE_LOG");
+	if (file_name == NULL || write_log == NULL)
+	{
+		return;
+	}
+
+	FILE* p_file = fopen (file_name, "w");
+	if (p_file == NULL)
+	{
+		perror (file_name);
+		return;
+	}
+
+	uint32_t count = write_count < HAL_WRITE_LOG_SIZE ? write_count : HAL_WRITE_LOG_SIZE;
+	fprintf (p_file, "time_ns,address,value,width\n");
+	for (uint32_t index = 0; index < count; index++)
+	{
+		fprintf (p_file, "%llu,0x%04X,0x%04X,%u\n",
+				 (unsigned long long)write_log[index].time_ns, write_log[index].address,
+				 write_log[index].value, write_log[index].width);
+	}
+	if (write_count > count)
+	{
+		fprintf (stderr, "hal: %u register writes did not fit in the log\n",
+				 write_count - count);
+	}
+	fclose (p_file);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This thread plays the part of the watchdog timer. It blocks all signals so that it
+ *  doesn't steal the tick signal from the FreeRTOS POSIX port.
+ */
+
+static void* watchdog_thread (void*)
+{
+	sigset_t all_signals;
+	sigfillset (&all_signals);
+	pthread_sigmask (SIG_BLOCK, &all_signals, NULL);
+
+	for (;;)
+	{
+		usleep (1000);
+		uint64_t deadline = watchdog_deadline_ns;
+		if (deadline != 0 && now_ns () > deadline)
+		{
+			fprintf (stderr, "hal: watchdog reset\n");
+			exit (HAL_WATCHDOG_EXIT);
+		}
+	}
+	return NULL;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function runs before main() to get the log and the watchdog thread ready and
+ *  to put the registers which aren't zero after reset at their reset values.
+ */
+
+static void __attribute__ ((constructor)) hal_host_init (void)
+{
+	if (getenv ("HAL_WRITE_LOG") != NULL)
+	{
+		write_log = (hal_write_record*)calloc (HAL_WRITE_LOG_SIZE,
+											   sizeof (hal_write_record));
+		atexit (dump_write_log);
+	}
+
+	// After reset, the chip runs from the 2 MHz RC oscillator
+	hal_io_space[0x0050] = OSC_RC2MEN_bm;
+	hal_io_space[0x0051] = OSC_RC2MRDY_bm;
+
+	pthread_t thread;
+	pthread_create (&thread, NULL, watchdog_thread, NULL);
+	pthread_detach (thread);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function models what the hardware does when a register is written, beyond
+ *  storing the value.
+ *  @param address The register's I/O address
+ *  @param value The value which was written
+ */
+
+static void side_effects (uint16_t address, uint8_t value)
+{
+	// Ports have set, clear and toggle registers for DIR (offsets 1 - 3) and for OUT
+	// (offsets 5 - 7); they change the real register, which isn't a CPU write
+	if (address >= 0x0600 && address < 0x0700)
+	{
+		uint8_t* p_port = hal_io_space + (address & ~0x1F);
+		switch (address & 0x1F)
+		{
+			case 0x01: p_port[0x00] |= value;              break;
+			case 0x02: p_port[0x00] &= (uint8_t)~value;    break;
+			case 0x03: p_port[0x00] ^= value;              break;
+			case 0x05: p_port[0x04] |= value;              break;
+			case 0x06: p_port[0x04] &= (uint8_t)~value;    break;
+			case 0x07: p_port[0x04] ^= value;              break;
+			default:                                        break;
+		}
+	}
+
+	// Oscillators which are enabled in OSC.CTRL are ready right away
+	else if (address == 0x0050)
+	{
+		hal_io_space[0x0051] = value & 0x1F;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called for every write to an 8-bit emulated register.
+ *  @param address The register's I/O address
+ *  @param value The value being written
+ */
+
+void hal_io_write8 (uint16_t address, uint8_t value)
+{
+	hal_io_space[address] = value;
+	log_write (address, value, 8);
+	side_effects (address, value);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called for every write to a 16-bit emulated register.
+ *  @param address The I/O address of the register's low byte
+ *  @param value The value being written
+ */
+
+void hal_io_write16 (uint16_t address, uint16_t value)
+{
+	hal_io_space[address] = (uint8_t)value;
+	hal_io_space[address + 1] = (uint8_t)(value >> 8);
+	log_write (address, value, 16);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function enables the emulated watchdog.
+ *  @param timeout One of the WDTO_ constants; the period is 15 ms times 2^timeout
+ */
+
+void wdt_enable (uint8_t timeout)
+{
+	WDT.CTRL = (uint8_t)((timeout << 2) | 0x03);
+	watchdog_period_ns = 15000000ULL << timeout;
+	watchdog_deadline_ns = now_ns () + watchdog_period_ns;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function disables the emulated watchdog.
+ */
+
+void wdt_disable (void)
+{
+	WDT.CTRL = 0x01;
+	watchdog_deadline_ns = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function resets the emulated watchdog so it starts counting again.
+ */
+
+void wdt_reset (void)
+{
+	if (watchdog_deadline_ns != 0)
+	{
+		watchdog_deadline_ns = now_ns () + watchdog_period_ns;
+	}
+}
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Drive the robot's motors with binary frames from a PC.
+
+Each frame carries a steering command for both motors (0 = stop, 1 = port,
+2 = starboard). Frames are sent as fast as the serial port takes them; only every
+Nth frame asks for an ack, and the script waits for that ack before going on, so
+the robot is never more than N frames behind. The robot's "link" command shows how
+many frames it got and how many were lost or failed their CRC.
+
+With --shot, a shot script is loaded instead, one step per --shot, and then played.
+Each step is the time from the start in ms, then the front and back commands; the
+robot's "shot" command shows how closely the steps kept to their times.
+
+    python3 host/host_link.py /dev/ttyUSB0 115200 --count 1000 --ack-every 50
+    python3 host/host_link.py /dev/pts/3 115200 --front 1 --back 2
+    python3 host/host_link.py /dev/ttyUSB0 115200 --shot 0:0:1 --shot 250:1:1 --shot 900:0:0
+"""
+
+import argparse
+import os
+import struct
+import termios
+import time
+
+SOF = 0xA5
+ACK_REQUEST = 0x01
+SETPOINTS = 0x01
+PING = 0x02
+SHOT_CLEAR = 0x03
+SHOT_STEP = 0x04
+SHOT_RUN = 0x05
+ACK = 0x80
+
+# The unit of a shot step's time on the robot, in ms
+SHOT_TICK_MS = 0.1
+
+
+def crc_xmodem(data):
+    """Return the CRC-16/XMODEM of the given bytes, as avr-libc computes it."""
+    crc = 0
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def make_frame(sequence, flags, frame_type, payload=b""):
+    """Build one frame, from SOF to the CRC."""
+    body = bytes([len(payload), sequence & 0xFF, flags, frame_type]) + payload
+    return bytes([SOF]) + body + struct.pack("<H", crc_xmodem(body))
+
+
+def open_port(name, baud):
+    """Open a serial port in raw mode and return its file descriptor."""
+    fd = os.open(name, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = attrs[1] = attrs[3] = 0
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    speed = getattr(termios, "B%d" % baud)
+    attrs[4] = attrs[5] = speed
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def wait_for_ack(fd, sequence, timeout=0.5):
+    """Read until the ack for the given sequence number comes in; return its status,
+    or None if it doesn't come. Text printed by the robot is skipped."""
+    data = b""
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        data += os.read(fd, 64)
+        start = data.find(bytes([SOF]))
+        while start >= 0 and len(data) - start >= 8:
+            body = data[start + 1:start + 6]
+            crc = struct.unpack("<H", data[start + 6:start + 8])[0]
+            if crc == crc_xmodem(body) and body[3] == ACK and body[1] == sequence:
+                return body[4]
+            start = data.find(bytes([SOF]), start + 1)
+    return None
+
+
+def load_shot(fd, steps):
+    """Load a shot script, one "ms:front:back" step at a time, and play it. Every
+    frame is acked, so a step the robot refuses is reported. Return True if the
+    script was loaded and started."""
+    frames = [(SHOT_CLEAR, b"")]
+    for step in steps:
+        time_ms, front, back = step.split(":")
+        ticks = int(round(float(time_ms) / SHOT_TICK_MS))
+        frames.append((SHOT_STEP, struct.pack("<HBB", ticks, int(front), int(back))))
+    frames.append((SHOT_RUN, b""))
+
+    for number, (frame_type, payload) in enumerate(frames):
+        os.write(fd, make_frame(number, ACK_REQUEST, frame_type, payload))
+        status = wait_for_ack(fd, number & 0xFF)
+        if status != 0:
+            print("shot frame %d (type %d): status %s" % (number, frame_type, status))
+            return False
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("baud", type=int)
+    parser.add_argument("--front", type=int, default=0)
+    parser.add_argument("--back", type=int, default=0)
+    parser.add_argument("--count", type=int, default=1)
+    parser.add_argument("--ack-every", type=int, default=1)
+    parser.add_argument("--shot", action="append", metavar="MS:FRONT:BACK")
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    if args.shot:
+        if load_shot(fd, args.shot):
+            print("shot of %d steps started" % len(args.shot))
+        return
+
+    payload = bytes([args.front, args.back])
+    missed = 0
+    start = time.monotonic()
+    for number in range(args.count):
+        last = (number == args.count - 1)
+        wants_ack = last or (number + 1) % args.ack_every == 0
+        os.write(fd, make_frame(number, ACK_REQUEST if wants_ack else 0,
+                                SETPOINTS, payload))
+        if wants_ack:
+            status = wait_for_ack(fd, number & 0xFF)
+            if status is None:
+                missed += 1
+            elif status != 0:
+                print("frame %d: status %d" % (number, status))
+    elapsed = time.monotonic() - start
+
+    print("%d frames in %.3f s, %.0f frames/s, %d acks missed" % (
+        args.count, elapsed, args.count / elapsed, missed))
+
+
+if __name__ == "__main__":
+    main()
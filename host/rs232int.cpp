@@ -0,0 +1,120 @@
+//**************************************************************************************
+/** \file host/rs232int.cpp
+ *    This file contains the host build's serial port, which talks to the terminal or
+ *    to a pseudo-terminal instead of a USART.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "rs232int.h"                       // Header for this file
+
+
+/// Terminal settings from before we started, which are put back at exit
+static struct termios saved_termios;
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts the terminal back the way it was when the program exits.
+ */
+
+static void restore_terminal (void)
+{
+	tcsetattr (STDIN_FILENO, TCSANOW, &saved_termios);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor opens the pseudo-terminal if HAL_SERIAL_PTY is set, or else puts
+ *  the terminal into raw mode so that key presses arrive one at a time, as they do
+ *  from a terminal program on the robot's serial port.
+ *  @param baud_rate Ignored on the host
+ *  @param p_usart Ignored on the host
+ */
+
+rs232::rs232 (uint16_t baud_rate, USART_t* p_usart)
+{
+	(void)baud_rate;
+	(void)p_usart;
+
+	if (getenv ("HAL_SERIAL_PTY") != NULL)
+	{
+		int fd = posix_openpt (O_RDWR | O_NOCTTY);
+		grantpt (fd);
+		unlockpt (fd);
+
+		struct termios settings;
+		tcgetattr (fd, &settings);
+		cfmakeraw (&settings);
+		tcsetattr (fd, TCSANOW, &settings);
+
+		fprintf (stderr, "rs232: serial port is %s\n", ptsname (fd));
+		fd_in = fd_out = fd;
+	}
+	else
+	{
+		fd_in = STDIN_FILENO;
+		fd_out = STDOUT_FILENO;
+
+		if (isatty (fd_in) && tcgetattr (fd_in, &saved_termios) == 0)
+		{
+			struct termios settings = saved_termios;
+			settings.c_lflag &= ~(ICANON | ECHO | ISIG);
+			settings.c_cc[VMIN] = 1;
+			settings.c_cc[VTIME] = 0;
+			tcsetattr (fd_in, TCSANOW, &settings);
+			atexit (restore_terminal);
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sends one character.
+ *  @param chout The character to be sent
+ *  @return True if the character was written, false if it couldn't be
+ */
+
+bool rs232::putchar (char chout)
+{
+	return (write (fd_out, &chout, 1) == 1);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method checks whether there's a character waiting to be read, without
+ *  waiting for one.
+ *  @return True if a character is waiting, false if not
+ */
+
+bool rs232::check_for_char (void)
+{
+	struct pollfd poll_in = { fd_in, POLLIN, 0 };
+	return (poll (&poll_in, 1, 0) > 0 && (poll_in.revents & POLLIN));
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method waits for a character and returns it. At the end of the input, which
+ *  happens when a script pipes commands in, the program ends.
+ *  @return The character which was received
+ */
+
+char rs232::getchar (void)
+{
+	char chin;
+
+	if (read (fd_in, &chin, 1) != 1)
+	{
+		exit (0);
+	}
+	return chin;
+}
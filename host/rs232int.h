@@ -0,0 +1,46 @@
+//**************************************************************************************
+/** \file host/rs232int.h
+ *    This file stands in for the ME405 library's rs232int.h in the host build. The
+ *    serial port is either the terminal the program runs in or, when the environment
+ *    variable HAL_SERIAL_PTY is set, a new pseudo-terminal whose name is printed at
+ *    startup so that a terminal program or a test script can connect to it.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_RS232INT_H_
+#define _HOST_RS232INT_H_
+
+#include <avr/io.h>                         // Emulated port I/O for SFR's
+#include "emstream.h"                       // Pull in the base class header file
+
+
+//-------------------------------------------------------------------------------------
+/** This class runs the robot's serial port on a PC. It has the same constructor as the
+ *  XMEGA version; the baud rate and USART are ignored.
+ */
+
+class rs232 : public emstream
+{
+protected:
+	int fd_in;                              ///< File descriptor characters come from
+	int fd_out;                             ///< File descriptor characters go to
+
+public:
+	// The constructor sets up the terminal or the pseudo-terminal
+	rs232 (uint16_t baud_rate, USART_t* p_usart);
+
+	// This method sends one character
+	bool putchar (char chout);
+
+	// This method checks whether a character has come in
+	bool check_for_char (void);
+
+	// This method waits for a character and returns it
+	char getchar (void);
+};
+
+#endif // _HOST_RS232INT_H_
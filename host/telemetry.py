@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Record the robot's telemetry frames as CSV.
+
+Start the frames with the robot's "telem" command, for example "telem 200", then
+run this script on the same port. Each frame becomes one CSV line; text the robot
+prints in between is skipped, and so are frames whose CRC is wrong. A frame the
+robot took but couldn't send in time shows up as a jump in the sequence number,
+which is counted as lost. The port can also be a file of bytes saved from it.
+
+    python3 host/telemetry.py /dev/ttyUSB0 115200 > shot.csv
+    python3 host/telemetry.py capture.bin 0 > shot.csv
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from host_link import SOF, crc_xmodem, open_port
+
+TELEMETRY = 0x81
+
+# The fields of telemetry_data in telemetry.h, in order, and how they're packed
+FIELDS = [
+    ("cycles", "I"), ("ticks", "I"),
+    ("user_state", "B"), ("front_state", "B"), ("back_state", "B"),
+    ("steer_front", "B"), ("steer_back", "B"), ("shot_running", "B"),
+    ("front_port_compare", "H"), ("front_starboard_compare", "H"),
+    ("back_port_compare", "H"), ("back_starboard_compare", "H"),
+    ("speed_setpoint", "h"), ("speed_measured", "h"), ("speed_output", "h"),
+    ("front_ma", "H"), ("back_ma", "H"),
+    ("front_fault", "B"), ("back_fault", "B"),
+    ("user_runs", "I"), ("front_runs", "I"), ("back_runs", "I"),
+]
+FORMAT = "<" + "".join(code for _, code in FIELDS)
+LENGTH = struct.calcsize(FORMAT)
+
+# The robot's cycle counter runs at 32 MHz and wraps every 2^32 cycles
+CYCLES_PER_MS = 32000.0
+
+
+def frames(data):
+    """Find the good telemetry frames in the bytes; return a list of (sequence,
+    payload) and the bytes at the end which may be the start of a frame."""
+    found = []
+    start = data.find(bytes([SOF]))
+    while start >= 0:
+        end = start + 1 + 4 + LENGTH + 2
+        if len(data) < end:
+            return found, data[start:]
+        body = data[start + 1:end - 2]
+        crc = struct.unpack("<H", data[end - 2:end])[0]
+        if body[0] == LENGTH and body[3] == TELEMETRY and crc == crc_xmodem(body):
+            found.append((body[1], body[4:]))
+            start = data.find(bytes([SOF]), end)
+        else:
+            start = data.find(bytes([SOF]), start + 1)
+    return found, b""
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("baud", type=int, help="0 if the port is a saved file")
+    parser.add_argument("--count", type=int, default=0,
+                        help="stop after this many frames (default: run until ^C)")
+    args = parser.parse_args()
+
+    if args.baud:
+        fd = open_port(args.port, args.baud)
+    else:
+        fd = os.open(args.port, os.O_RDONLY)
+
+    out = sys.stdout
+    out.write("sequence,time_ms," + ",".join(name for name, _ in FIELDS) + "\n")
+    written = lost = 0
+    last_sequence = first_cycles = None
+    wraps = 0
+    last_cycles = 0
+    pending = b""
+    try:
+        while args.count == 0 or written < args.count:
+            data = os.read(fd, 256)
+            if not data and not args.baud:
+                break
+            found, pending = frames(pending + data)
+            for sequence, payload in found:
+                # A frame seen twice is skipped rather than counted as 255 lost
+                if sequence == last_sequence:
+                    continue
+                values = struct.unpack(FORMAT, payload)
+                if last_sequence is not None:
+                    lost += (sequence - last_sequence - 1) & 0xFF
+                last_sequence = sequence
+
+                # The time is from the first frame, with the counter's wraps undone
+                cycles = values[0]
+                if first_cycles is None:
+                    first_cycles = cycles
+                elif cycles < last_cycles:
+                    wraps += 1
+                last_cycles = cycles
+                time_ms = ((wraps << 32) + cycles - first_cycles) / CYCLES_PER_MS
+
+                out.write("%d,%.3f," % (sequence, time_ms)
+                          + ",".join(str(value) for value in values) + "\n")
+                written += 1
+    except KeyboardInterrupt:
+        pass
+
+    sys.stderr.write("%d frames, %d lost\n" % (written, lost))
+
+
+if __name__ == "__main__":
+    main()
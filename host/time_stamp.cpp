@@ -0,0 +1,144 @@
+//**************************************************************************************
+/** \file host/time_stamp.cpp
+ *    This file contains the host build's time stamp class, which reads the PC's
+ *    monotonic clock.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <time.h>
+
+#include "time_stamp.h"                     // Header for this file
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes a time stamp which holds zero.
+ */
+
+time_stamp::time_stamp (void)
+	: seconds (0), microsec (0)
+{
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes a time stamp which holds the given time.
+ *  @param a_seconds The number of whole seconds
+ *  @param a_microsec The number of microseconds past the whole seconds
+ */
+
+time_stamp::time_stamp (uint32_t a_seconds, uint32_t a_microsec)
+{
+	set_time (a_seconds, a_microsec);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sets the time, carrying extra microseconds into the seconds.
+ *  @param a_seconds The number of whole seconds
+ *  @param a_microsec The number of microseconds past the whole seconds
+ */
+
+void time_stamp::set_time (uint32_t a_seconds, uint32_t a_microsec)
+{
+	seconds = a_seconds + a_microsec / 1000000UL;
+	microsec = a_microsec % 1000000UL;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method reads the monotonic clock into the time stamp.
+ */
+
+void time_stamp::set_to_now (void)
+{
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	seconds = (uint32_t)now.tv_sec;
+	microsec = (uint32_t)(now.tv_nsec / 1000L);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** These operators do arithmetic with time stamps.
+ */
+
+time_stamp time_stamp::operator + (const time_stamp& addend)
+{
+	time_stamp result = *this;
+	result += addend;
+	return result;
+}
+
+time_stamp time_stamp::operator - (const time_stamp& subtrahend)
+{
+	time_stamp result = *this;
+	result -= subtrahend;
+	return result;
+}
+
+time_stamp& time_stamp::operator += (const time_stamp& addend)
+{
+	set_time (seconds + addend.seconds, microsec + addend.microsec);
+	return *this;
+}
+
+time_stamp& time_stamp::operator -= (const time_stamp& subtrahend)
+{
+	if (microsec < subtrahend.microsec)
+	{
+		microsec += 1000000UL;
+		seconds--;
+	}
+	microsec -= subtrahend.microsec;
+	seconds -= subtrahend.seconds;
+	return *this;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** These operators compare time stamps.
+ */
+
+bool time_stamp::operator == (const time_stamp& other)
+{
+	return (seconds == other.seconds && microsec == other.microsec);
+}
+
+bool time_stamp::operator > (const time_stamp& other)
+{
+	return (seconds > other.seconds
+			|| (seconds == other.seconds && microsec > other.microsec));
+}
+
+bool time_stamp::operator < (const time_stamp& other)
+{
+	return (seconds < other.seconds
+			|| (seconds == other.seconds && microsec < other.microsec));
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This operator prints a time stamp as seconds and six decimal places.
+ *  @param serpt The serial device to which the time is printed
+ *  @param stamp The time stamp to print
+ *  @return A reference to the serial device, so that << can be chained
+ */
+
+emstream& operator << (emstream& serpt, time_stamp& stamp)
+{
+	uint32_t fraction = stamp.get_microsec ();
+	char digits[7];
+
+	for (int8_t index = 5; index >= 0; index--)
+	{
+		digits[index] = (char)('0' + fraction % 10);
+		fraction /= 10;
+	}
+	digits[6] = '\0';
+
+	serpt << stamp.get_seconds () << '.' << digits;
+	return serpt;
+}
@@ -0,0 +1,62 @@
+//**************************************************************************************
+/** \file host/time_stamp.h
+ *    This file stands in for the ME405 library's time_stamp.h in the host build. The
+ *    XMEGA version counts microseconds with a timer/counter; this one reads the PC's
+ *    monotonic clock.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_TIME_STAMP_H_
+#define _HOST_TIME_STAMP_H_
+
+#include <stdint.h>
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+//-------------------------------------------------------------------------------------
+/** This class holds a time measured in seconds and microseconds.
+ */
+
+class time_stamp
+{
+protected:
+	uint32_t seconds;                       ///< Whole seconds
+	uint32_t microsec;                      ///< Microseconds, from 0 to 999999
+
+public:
+	// Constructors make a time of zero or the given time
+	time_stamp (void);
+	time_stamp (uint32_t a_seconds, uint32_t a_microsec);
+
+	// This method sets the time to the given number of seconds and microseconds
+	void set_time (uint32_t a_seconds, uint32_t a_microsec);
+
+	// This method reads the clock into this time stamp
+	void set_to_now (void);
+
+	/// This method returns the number of whole seconds
+	uint32_t get_seconds (void) { return seconds; }
+
+	/// This method returns the number of microseconds past the whole seconds
+	uint32_t get_microsec (void) { return microsec; }
+
+	// These operators add and subtract times
+	time_stamp operator + (const time_stamp& addend);
+	time_stamp operator - (const time_stamp& subtrahend);
+	time_stamp& operator += (const time_stamp& addend);
+	time_stamp& operator -= (const time_stamp& subtrahend);
+
+	// These operators compare times
+	bool operator == (const time_stamp& other);
+	bool operator > (const time_stamp& other);
+	bool operator < (const time_stamp& other);
+};
+
+// This operator prints a time stamp as seconds with a decimal point
+emstream& operator << (emstream& serpt, time_stamp& stamp);
+
+#endif // _HOST_TIME_STAMP_H_
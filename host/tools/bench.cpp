@@ -0,0 +1,155 @@
+//**************************************************************************************
+/** \file host/tools/bench.cpp
+ *    This file runs the benchmarks of the robot's hot paths on a PC. It uses the same
+ *    table of benchmarks as the bench command on the robot, but times them with the
+ *    PC's clock and prints nanoseconds per call instead of CPU cycles. The task
+ *    objects are made here and never started, so their methods run only when the
+ *    benchmarks call them. Build it like the host build, with this file in place of
+ *    main.cpp, then:
+ *
+ *        ./bench                    # 100000 calls per trial
+ *        ./bench 1000000 > new.csv  # more calls, saved for comparison
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
+#include "shares.h"                         // Steering shares and motor task handles
+#include "speed_control.h"                  // The back motor's speed setpoint share
+#include "task_user.h"                      // The user interface task
+#include "motor_axes.h"                     // The motors and the task which runs them
+#include "params.h"                         // The axes' levels
+#include "benchmark.h"                      // The benchmarks
+
+
+/// How many trials are run of each benchmark; the fastest one is kept
+const int trials = 8;
+
+/// How many calls are timed in each trial, unless the command line says otherwise
+const long default_calls = 100000;
+
+
+// The robot's main() makes this; nothing is sent from it here
+serial_tx print_ser_queue (SERIAL_TX_DROP_OLDEST);
+
+
+/** This class is a serial device which throws away everything printed to it, so the
+ *  tasks can print without the output getting into the results.
+ */
+class null_stream : public emstream
+{
+public:
+	/** This method takes a character and does nothing with it.
+	 *  @param chout The character
+	 *  @return True, since there's always room
+	 */
+	bool putchar (char chout)
+	{
+		(void)chout;
+		return true;
+	}
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This function reads the PC's clock.
+ *  @return Time from some fixed point, in nanoseconds
+ */
+
+static double now_ns (void)
+{
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function times one benchmark.
+ *  @param function The benchmark
+ *  @param calls How many times it's called in each trial
+ *  @return The nanoseconds per call in the fastest trial
+ */
+
+static double time_benchmark (benchmark_function function, long calls)
+{
+	double best = 1e300;
+
+	for (int trial = 0; trial < trials; trial++)
+	{
+		double start = now_ns ();
+		for (long rep = 0; rep < calls; rep++)
+		{
+			function ((uint8_t)rep);
+		}
+		double per_call = (now_ns () - start) / calls;
+		if (per_call < best)
+		{
+			best = per_call;
+		}
+	}
+	return best;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** The main function makes the tasks which are benchmarked, with the same settings as
+ *  on the robot, and prints a CSV line for each benchmark: its name, how many calls
+ *  were timed, and nanoseconds per call with the loop overhead taken out.
+ *  @param argc How many words are on the command line
+ *  @param argv The words; the first one after the program's name, if there is one,
+ *              is how many calls to time in each trial
+ *  @return Zero, or 1 if the command line is wrong
+ */
+
+int main (int argc, char** argv)
+{
+	long calls = (argc > 1) ? atol (argv[1]) : default_calls;
+	if (calls < 1)
+	{
+		fprintf (stderr, "usage: %s [calls]\n", argv[0]);
+		return 1;
+	}
+
+	// The axes take their levels from the parameters, which are the defaults here since
+	// the host's EEPROM starts out empty
+	params_load ();
+
+	null_stream sink;
+	task_user user ("UserInt", task_priority (1), 260, &sink);
+	task_motor motors ("MOTORS", task_priority (2), 260, &sink, &motor_task);
+	motor_axis* p_back = motors.axis_of (TRACE_BACK);
+
+	// Get the back motor out of MOTOR_INIT, as its first pass on the robot does
+	p_back->step ();
+	benchmark_attach (&user, p_back);
+
+	double overhead = 0.0;
+	printf ("benchmark,calls,ns_per_call\n");
+	for (uint8_t index = 0; index < benchmark_count; index++)
+	{
+		double per_call = time_benchmark (benchmark_cases[index].function, calls);
+		if (index == 0)
+		{
+			overhead = per_call;
+		}
+		else
+		{
+			per_call = (per_call > overhead) ? per_call - overhead : 0.0;
+		}
+		printf ("%s,%ld,%.2f\n", benchmark_cases[index].name, calls, per_call);
+	}
+	return 0;
+}
@@ -0,0 +1,157 @@
+//**************************************************************************************
+/** \file host/tools/pid_sim.cpp
+ *    This file is a test harness for the back motor's speed controller which runs on a
+ *    PC. It puts the same fixed_pid code that runs in the 1 kHz interrupt around a
+ *    simple model of a DC motor with a quadrature encoder, steps the speed setpoint,
+ *    and reports the settling time and overshoot for several battery voltages and
+ *    loads. Build it by itself, not as part of the host build:
+ *
+ *        g++ -O2 -I. -o pid_sim host/tools/pid_sim.cpp
+ *        ./pid_sim                  # the gains in speed_control.h
+ *        ./pid_sim 10240 256 0      # try other gains: kp ki kd in Q8
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fixed_pid.h"                      // The controller being tested
+#include "speed_control.h"                  // The gains and limits used on the robot
+
+
+/// Speed of the motor model at full duty cycle and nominal voltage, in counts per ms
+const double free_speed = 40.0;
+
+/// Nominal battery voltage, at which the free speed is reached
+const double nominal_volts = 12.0;
+
+/// Mechanical time constant of the motor and ball wheel, in ms
+const double time_constant = 40.0;
+
+/// How long each run lasts, in ms
+const int run_ms = 1000;
+
+/// Half width of the band the speed must stay in to count as settled, as a fraction
+const double settle_band = 0.05;
+
+
+/// The results of one run
+struct step_result
+{
+	double overshoot;                       ///< Peak above the setpoint, in percent
+	int settling_ms;                        ///< Time to stay within the band, or -1
+	double final_speed;                     ///< Mean speed over the last 100 ms
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This function steps the setpoint from zero and runs the motor model and controller
+ *  for a while, one controller update per millisecond as on the robot.
+ *  @param gains The controller gains in Q8
+ *  @param setpoint The speed setpoint in encoder counts per ms
+ *  @param volts The battery voltage
+ *  @param load The load on the motor, as the speed it takes away, in counts per ms
+ *  @return The overshoot, settling time and final speed
+ */
+
+static step_result run_step (const pid_gains& gains, int16_t setpoint, double volts,
+							 double load)
+{
+	fixed_pid pid (gains, SPEED_OUTPUT_MIN, SPEED_OUTPUT_MAX);
+	double speed = 0.0;                     // True speed in counts per ms
+	double position = 0.0;                  // True position in counts
+	long last_count = 0;                    // Encoder count at the last update
+	int16_t measured = 0;                   // Counts in the last ms, as the QDEC sees
+	double peak = 0.0;
+	int last_outside = 0;
+	double final_sum = 0.0;
+
+	pid.reset (0);
+	for (int ms = 1; ms <= run_ms; ms++)
+	{
+		int16_t duty = pid.update (setpoint, measured);
+
+		// Run the motor model in small steps through this millisecond
+		const int substeps = 10;
+		for (int step = 0; step < substeps; step++)
+		{
+			double drive = free_speed * duty / SPEED_OUTPUT_MAX * volts / nominal_volts;
+			double target = drive - (speed >= 0.0 ? load : -load);
+			speed += (target - speed) / time_constant / substeps;
+			position += speed / substeps;
+		}
+
+		long count = (long)floor (position);
+		measured = (int16_t)(count - last_count);
+		last_count = count;
+
+		if (speed > peak)
+		{
+			peak = speed;
+		}
+		if (fabs (speed - setpoint) > settle_band * setpoint)
+		{
+			last_outside = ms;
+		}
+		if (ms > run_ms - 100)
+		{
+			final_sum += speed;
+		}
+	}
+
+	step_result result;
+	result.overshoot = (peak > setpoint) ? (peak - setpoint) * 100.0 / setpoint : 0.0;
+	result.settling_ms = (last_outside < run_ms) ? last_outside : -1;
+	result.final_speed = final_sum / 100.0;
+	return result;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This program runs a step for each combination of battery voltage and load and
+ *  prints a table of the results. It exits with 1 if any run doesn't settle.
+ */
+
+int main (int argc, char** argv)
+{
+	pid_gains gains = speed_control_gains;
+	if (argc == 4)
+	{
+		gains.kp = atoi (argv[1]);
+		gains.ki = atoi (argv[2]);
+		gains.kd = atoi (argv[3]);
+	}
+	else if (argc != 1)
+	{
+		fprintf (stderr, "Usage: %s [kp ki kd]\n", argv[0]);
+		return 2;
+	}
+
+	const int16_t setpoint = 25;
+	const double volts[] = { 10.0, 12.0, 14.0 };
+	const double loads[] = { 0.0, 5.0 };
+	bool all_settled = true;
+
+	printf ("gains kp %d ki %d kd %d (Q8), setpoint %d counts/ms\n",
+			gains.kp, gains.ki, gains.kd, setpoint);
+	printf ("volts  load  overshoot_%%  settling_ms  final_speed\n");
+	for (unsigned v = 0; v < sizeof (volts) / sizeof (volts[0]); v++)
+	{
+		for (unsigned l = 0; l < sizeof (loads) / sizeof (loads[0]); l++)
+		{
+			step_result result = run_step (gains, setpoint, volts[v], loads[l]);
+			printf ("%5.1f %5.1f %11.1f %12d %12.2f\n", volts[v], loads[l],
+					result.overshoot, result.settling_ms, result.final_speed);
+			if (result.settling_ms < 0)
+			{
+				all_settled = false;
+			}
+		}
+	}
+
+	return all_settled ? 0 : 1;
+}
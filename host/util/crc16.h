@@ -0,0 +1,41 @@
+//**************************************************************************************
+/** \file host/util/crc16.h
+ *    This file stands in for avr-libc's <util/crc16.h> in the host build. The CRC is
+ *    computed the same way as avr-libc's C version, so frames check out the same on
+ *    the PC as on the board.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_UTIL_CRC16_H_
+#define _HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+
+/** This function adds one byte to a CRC-16/XMODEM (polynomial 0x1021, start at 0).
+ *  @param crc The CRC so far
+ *  @param data The byte to be added
+ *  @return The new CRC
+ */
+static inline uint16_t _crc_xmodem_update (uint16_t crc, uint8_t data)
+{
+	crc = crc ^ ((uint16_t)data << 8);
+	for (uint8_t bit = 0; bit < 8; bit++)
+	{
+		if (crc & 0x8000)
+		{
+			crc = (crc << 1) ^ 0x1021;
+		}
+		else
+		{
+			crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+#endif // _HOST_UTIL_CRC16_H_
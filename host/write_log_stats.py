@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Summarize the register write log from the host build.
+
+For each register address (or only the addresses given on the command line) this
+prints how many times it was written and the spacing between writes: the mean
+period, the minimum and maximum, and the jitter (standard deviation), all in
+microseconds. Motor loop timing shows up as the spacing of compare register
+writes, for example 0x0838 for TCC0.CCABUF and 0x0938 for TCD0.CCABUF.
+
+    HAL_WRITE_LOG=writes.csv ./bowlingbot_host < keys.txt
+    python3 host/write_log_stats.py writes.csv 0x0838 0x0938
+"""
+
+import csv
+import statistics
+import sys
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+
+    wanted = {int(a, 16) for a in sys.argv[2:]}
+    times = {}
+    with open(sys.argv[1], newline="") as log_file:
+        for row in csv.DictReader(log_file):
+            address = int(row["address"], 16)
+            if not wanted or address in wanted:
+                times.setdefault(address, []).append(int(row["time_ns"]))
+
+    print("address  writes   mean_us    min_us    max_us  jitter_us")
+    for address in sorted(times):
+        stamps = times[address]
+        gaps = [(b - a) / 1000.0 for a, b in zip(stamps, stamps[1:])]
+        if not gaps:
+            print("0x%04X %8d" % (address, len(stamps)))
+            continue
+        jitter = statistics.pstdev(gaps) if len(gaps) > 1 else 0.0
+        print("0x%04X %8d %9.1f %9.1f %9.1f %10.1f" % (
+            address, len(stamps), statistics.mean(gaps), min(gaps), max(gaps), jitter))
+
+
+if __name__ == "__main__":
+    main()
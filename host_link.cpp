@@ -0,0 +1,205 @@
+//**************************************************************************************
+/** \file host_link.cpp
+ *    This file contains the receiver and ack sender for the binary host protocol. The
+ *    receiver is a small state machine which is given one byte at a time, so it can
+ *    share the serial port with the keystroke interface: a byte which isn't part of a
+ *    frame is handed back to be treated as a key.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <util/crc16.h>                     // CRC functions from avr-libc
+
+#include "host_link.h"                      // Header for this file
+
+
+/// The parts of a frame, in the order in which they come in
+enum host_link_part
+{
+	PART_SOF,                               ///< Waiting for the start of a frame
+	PART_LENGTH,                            ///< Number of payload bytes
+	PART_SEQUENCE,                          ///< Sequence number
+	PART_FLAGS,                             ///< Flag bits
+	PART_TYPE,                              ///< Frame type
+	PART_PAYLOAD,                           ///< Payload bytes
+	PART_CRC_LOW,                           ///< Low byte of the CRC
+	PART_CRC_HIGH                           ///< High byte of the CRC
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes a link with all its counters at zero.
+ *  @param p_ser The serial port on which acks are to be sent
+ */
+
+host_link::host_link (emstream* p_ser)
+{
+	p_serial = p_ser;
+	part = PART_SOF;
+	index = 0;
+	crc = 0;
+	received_crc = 0;
+	next_sequence = 0;
+	synced = false;
+	repeat = false;
+	last_status = HOST_ACK_OK;
+
+	good_frames = 0;
+	crc_errors = 0;
+	framing_errors = 0;
+	lost_frames = 0;
+	repeats = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method takes one byte from the serial port. Outside a frame, any byte but SOF
+ *  is a keystroke and is handed back; inside a frame, every byte belongs to the frame.
+ *  @param ch The byte which came in
+ *  @return What the byte was, from host_link_result
+ */
+
+uint8_t host_link::receive (uint8_t ch)
+{
+	switch (part)
+	{
+		case (PART_SOF):
+			if (ch != HOST_LINK_SOF)
+			{
+				return HOST_LINK_NOT_MINE;
+			}
+			crc = 0;
+			part = PART_LENGTH;
+			return HOST_LINK_BUSY;
+
+		case (PART_LENGTH):
+			if (ch > HOST_LINK_MAX_PAYLOAD)
+			{
+				framing_errors++;
+				part = PART_SOF;
+				return HOST_LINK_BUSY;
+			}
+			frame.length = ch;
+			part = PART_SEQUENCE;
+			break;
+
+		case (PART_SEQUENCE):
+			frame.sequence = ch;
+			part = PART_FLAGS;
+			break;
+
+		case (PART_FLAGS):
+			frame.flags = ch;
+			part = PART_TYPE;
+			break;
+
+		case (PART_TYPE):
+			frame.type = ch;
+			index = 0;
+			part = (frame.length > 0) ? PART_PAYLOAD : PART_CRC_LOW;
+			break;
+
+		case (PART_PAYLOAD):
+			frame.payload[index++] = ch;
+			if (index >= frame.length)
+			{
+				part = PART_CRC_LOW;
+			}
+			break;
+
+		case (PART_CRC_LOW):
+			received_crc = ch;
+			part = PART_CRC_HIGH;
+			return HOST_LINK_BUSY;
+
+		case (PART_CRC_HIGH):
+			received_crc |= (uint16_t)ch << 8;
+			part = PART_SOF;
+			if (received_crc != crc)
+			{
+				crc_errors++;
+				return HOST_LINK_BUSY;
+			}
+
+			// A good frame; see whether any were lost or this one was sent again
+			repeat = synced && (frame.sequence == (uint8_t)(next_sequence - 1));
+			if (repeat)
+			{
+				repeats++;
+			}
+			else
+			{
+				if (synced)
+				{
+					lost_frames += (uint8_t)(frame.sequence - next_sequence);
+				}
+				next_sequence = frame.sequence + 1;
+				synced = true;
+			}
+			good_frames++;
+			return HOST_LINK_FRAME;
+
+		default:
+			part = PART_SOF;
+			return HOST_LINK_BUSY;
+	}
+
+	// Every byte from the length to the end of the payload goes into the CRC
+	crc = _crc_xmodem_update (crc, ch);
+	return HOST_LINK_BUSY;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method throws away a frame which stopped coming in partway through, so that
+ *  the bytes after it aren't taken as the rest of the frame. The owning task calls it
+ *  when the serial port has been quiet for a while.
+ */
+
+void host_link::timeout (void)
+{
+	if (part != PART_SOF)
+	{
+		framing_errors++;
+		part = PART_SOF;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sends an ack for the last frame. The ack has the same sequence number
+ *  as the frame it answers, so the PC can match them up.
+ *  @param status How the frame turned out, from host_ack_status
+ */
+
+void host_link::send_ack (uint8_t status)
+{
+	uint8_t ack[] = { 1, frame.sequence, 0, HOST_ACK, status };
+	uint16_t ack_crc = 0;
+
+	p_serial->putchar (HOST_LINK_SOF);
+	for (uint8_t count = 0; count < sizeof (ack); count++)
+	{
+		ack_crc = _crc_xmodem_update (ack_crc, ack[count]);
+		p_serial->putchar (ack[count]);
+	}
+	p_serial->putchar (ack_crc & 0xFF);
+	p_serial->putchar (ack_crc >> 8);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method prints the link's counters.
+ *  @param p_ser The serial device on which to print
+ */
+
+void host_link::print_status (emstream* p_ser)
+{
+	*p_ser << PMS ("frames ") << good_frames
+		   << PMS (" crc_errors ") << crc_errors
+		   << PMS (" framing_errors ") << framing_errors
+		   << PMS (" lost ") << lost_frames
+		   << PMS (" repeats ") << repeats << endl;
+}
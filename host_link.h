@@ -0,0 +1,160 @@
+//**************************************************************************************
+/** \file host_link.h
+ *    This file contains a compact binary protocol which lets a program on a PC drive
+ *    the robot over the same serial port as the keystroke interface. Each frame is
+ *
+ *        SOF  LEN  SEQ  FLAGS  TYPE  PAYLOAD[LEN]  CRC_LO  CRC_HI
+ *
+ *    where SOF is 0xA5, a byte no key on a terminal sends, LEN is the number of
+ *    payload bytes, SEQ counts frames modulo 256, and the CRC is CRC-16/XMODEM over
+ *    everything from LEN to the end of the payload. The robot only answers a frame
+ *    whose flags ask for an ack, so a PC can send setpoints hundreds of times a
+ *    second without waiting for replies.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _HOST_LINK_H_
+#define _HOST_LINK_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The byte which starts every frame
+#define HOST_LINK_SOF           0xA5
+
+/// The most payload bytes a frame may carry
+#define HOST_LINK_MAX_PAYLOAD   16
+
+/// Flag bit which asks the robot to answer the frame with an ack
+#define HOST_LINK_ACK_REQUEST   0x01
+
+
+/// The kinds of frame
+enum host_frame_type
+{
+	HOST_SETPOINTS = 0x01,                  ///< Payload: front command, back command
+	HOST_PING = 0x02,                       ///< No payload; just asks for an ack
+	HOST_SHOT_CLEAR = 0x03,                 ///< No payload; empties the shot script
+	HOST_SHOT_STEP = 0x04,                  ///< Payload: time (2 bytes), front, back
+	HOST_SHOT_RUN = 0x05,                   ///< No payload; plays the shot script
+	HOST_ACK = 0x80                         ///< Robot to PC; payload: status
+};
+
+/// The status sent back in an ack
+enum host_ack_status
+{
+	HOST_ACK_OK,                            ///< The frame was carried out
+	HOST_ACK_BAD_TYPE,                      ///< The frame type isn't known
+	HOST_ACK_BAD_PAYLOAD,                   ///< The payload's length or values are wrong
+	HOST_ACK_REFUSED                        ///< The frame can't be carried out just now
+};
+
+/// What happened to a byte given to host_link::receive()
+enum host_link_result
+{
+	HOST_LINK_NOT_MINE,                     ///< Not part of a frame; it's a keystroke
+	HOST_LINK_BUSY,                         ///< Part of a frame which isn't finished yet
+	HOST_LINK_FRAME                         ///< The last byte of a good frame
+};
+
+
+/// A frame which has been received and checked
+struct host_frame
+{
+	uint8_t length;                         ///< Number of payload bytes
+	uint8_t sequence;                       ///< Sequence number from the PC
+	uint8_t flags;                          ///< Flag bits such as HOST_LINK_ACK_REQUEST
+	uint8_t type;                           ///< What the frame is, from host_frame_type
+	uint8_t payload[HOST_LINK_MAX_PAYLOAD]; ///< The data carried by the frame
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class finds frames in the bytes coming in on a serial port and sends acks
+ *  back. It checks frames but doesn't carry them out; that's up to the task which owns
+ *  it, so the task's own rules for steering the motors apply to frames and keys alike.
+ */
+
+class host_link
+{
+protected:
+	/// The serial port on which acks are sent
+	emstream* p_serial;
+
+	/// Which part of a frame the next byte is; 0 means waiting for SOF
+	uint8_t part;
+
+	/// How many payload bytes have been received so far
+	uint8_t index;
+
+	/// The CRC of the frame so far, and then the CRC which came with it
+	uint16_t crc;
+	uint16_t received_crc;
+
+	/// The frame being received; it's only whole after receive() says so
+	host_frame frame;
+
+	/// The sequence number expected next, and whether any frame has come in yet
+	uint8_t next_sequence;
+	bool synced;
+
+	/// Whether the last frame had the same sequence number as the one before it
+	bool repeat;
+
+	/// How the last frame which was carried out turned out, sent again in the ack
+	/// if the PC repeats it
+	uint8_t last_status;
+
+	// Counts of what's happened on the link
+	uint16_t good_frames;                   ///< Frames which passed all checks
+	uint16_t crc_errors;                    ///< Frames thrown away for a bad CRC
+	uint16_t framing_errors;                ///< Frames too long or cut off
+	uint16_t lost_frames;                   ///< Frames missing from the sequence
+	uint16_t repeats;                       ///< Frames sent again by the PC
+
+public:
+	// This constructor makes a link which sends acks on the given serial port
+	host_link (emstream* p_ser);
+
+	// This method takes one byte from the serial port
+	uint8_t receive (uint8_t ch);
+
+	/** This method returns the frame which receive() most recently said was finished.
+	 *  @return A reference to the frame
+	 */
+	const host_frame& get_frame (void) { return frame; }
+
+	/** This method says whether the last frame repeats the one before it, which
+	 *  happens when the PC didn't get an ack and sent the frame again.
+	 *  @return True if the frame has already been carried out
+	 */
+	bool is_repeat (void) { return repeat; }
+
+	/** This method records how a frame which was carried out turned out.
+	 *  @param status The status from host_ack_status
+	 */
+	void set_last_status (uint8_t status) { last_status = status; }
+
+	/** This method returns the status recorded for the last frame carried out, which
+	 *  is the one to ack a repeat of it with.
+	 *  @return The status from host_ack_status
+	 */
+	uint8_t get_last_status (void) { return last_status; }
+
+	// This method throws away a frame which stopped coming in partway through
+	void timeout (void);
+
+	// This method sends an ack for the last frame
+	void send_ack (uint8_t status);
+
+	// This method prints the link's counters
+	void print_status (emstream* p_ser);
+};
+
+#endif // _HOST_LINK_H_
@@ -30,16 +30,67 @@
 #include "frt_text_queue.h"                 // Wrapper for FreeRTOS character queues
 #include "frt_queue.h"                      // Header of wrapper for FreeRTOS queues
 #include "frt_shared_data.h"                // Header for thread-safe shared data
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
 #include "shares.h"                         // Global ('extern') queue declarations
 
 #include "xmega_util.h"
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "serial_rx.h"                      // Interrupt driven serial receiver
+#include "control_loop.h"                   // Control loops run by a timer interrupt
+#include "speed_control.h"                  // Closed loop speed of the back motor
+#include "static_alloc.h"                   // Objects in static RAM instead of the heap
+#include "boot_profile.h"                   // How long each step of booting takes
+#include "shot_script.h"                    // Timed shot sequences
+#include "current_sense.h"                  // Motor currents and stall cut-off
+#include "telemetry.h"                      // Binary snapshots for the PC
+#include "params.h"                         // Tunable parameters kept in the EEPROM
 
 #include "task_user.h"                      // Header for user interface task
-#include "task_motor_back.h"				// Header for the back motor task
-#include "task_motor_front.h"				// Header for the front motor task
+#include "motor_axes.h"                     // The motors and the task which runs them
+#include "motor_sync.h"                     // Both motors' PWM changing together
+#include "supervisor.h"                     // Deadline watch and the watchdog
 
 
-frt_text_queue print_ser_queue (32, NULL, 10);
+// Other tasks print here; if the transmit buffer fills up, their oldest text goes
+serial_tx print_ser_queue (SERIAL_TX_DROP_OLDEST);
+
+
+/// Stack sizes of the tasks, in bytes
+const size_t user_stack_size = 260;
+const size_t motor_stack_size = 260;
+const size_t supervisor_stack_size = 160;
+
+#if tskKERNEL_VERSION_MAJOR >= 9
+/// The header which heap_2 and heap_4 put in front of each block they hand out; it's
+/// laid out as their BlockLink_t is
+struct heap_block_header
+{
+	void* p_next;                           ///< The next free block
+	size_t size;                            ///< Size of the block
+};
+
+/// Bytes a heap block takes besides what was asked for, with both rounded up to the
+/// heap's alignment
+const size_t heap_block_overhead = (sizeof (heap_block_header) + portBYTE_ALIGNMENT_MASK)
+								   & ~(size_t)portBYTE_ALIGNMENT_MASK;
+
+/// Heap used by xTaskCreate() for each task besides its stack: the task control
+/// block, which is as big as a StaticTask_t, and a block header each for it and for
+/// the stack
+const size_t task_heap_overhead = ((sizeof (StaticTask_t) + portBYTE_ALIGNMENT_MASK)
+								   & ~(size_t)portBYTE_ALIGNMENT_MASK)
+								  + 2 * heap_block_overhead;
+
+// The task objects live in static RAM, but the RTOS still takes their stacks and
+// control blocks from its heap; make sure at build time that the heap is big enough
+// for all of them. Older kernels have no StaticTask_t, so the size of a control block
+// can't be known here and the heap isn't checked
+static_assert (user_stack_size + motor_stack_size + supervisor_stack_size
+			   + 3 * task_heap_overhead <= configTOTAL_HEAP_SIZE,
+			   "configTOTAL_HEAP_SIZE is too small for the tasks");
+#endif
 
 
 
@@ -54,14 +105,43 @@ frt_text_queue print_ser_queue (32, NULL, 10);
 int main (void)
 {
 	cli();
+	boot_profile_mark (BOOT_MAIN);
 	
-	// Configure the system clock to use internal oscillator at 32 MHz
+	// Configure the system clock from the source picked by SYSCLOCK_SOURCE; that's the
+	// internal oscillator at 32 MHz unless the build says otherwise
 	config_SYSCLOCK();
+	boot_profile_mark (BOOT_CLOCK);
 	
-	// Disable the watchdog timer unless it's needed later. This is important because
-	// sometimes the watchdog timer may have been left on...and it tends to stay on	 
+	// Disable the watchdog timer until the supervisor task turns it on. This is
+	// important because sometimes the watchdog timer may have been left on...and it
+	// tends to stay on
 	wdt_disable ();
 
+	// Start the cycle counter which is used to time short pieces of code
+	cycle_counter_init ();
+
+	// Read the tunable parameters from the EEPROM before anything which uses them
+	params_load ();
+
+	// Start the timer interrupt which runs the control loops at a fixed rate
+	control_loop_init (params.loop_hz);
+
+	// Start the back motor's encoder and speed controller, which the executor runs, and
+	// the front motor's bridge; then restart both motor timers so they count in step
+	speed_control_init ();
+	front_bridge::init (params.pwm_hz);
+	motor_sync_init ();
+
+	// Get the shot sequencer's timer ready; it only runs while a script plays
+	shot_script_init ();
+
+	// Measure the motor currents once per PWM period; the first readings, taken while
+	// the duty cycles are still zero, are the zero current readings
+	current_sense_init ();
+
+	// Get the telemetry snapshot ready; the telem command starts the frames
+	telemetry_init ();
+
 
 	// Configure a serial port which can be used by a task to print debugging infor-
 	// mation, or to allow user interaction, or for whatever use is appropriate.  The
@@ -69,20 +149,39 @@ int main (void)
 	// the task scheduler has been started by the function vTaskStartScheduler()
 	rs232 ser_dev(0,&USARTC0); // Create a serial device on USART C0
 	ser_dev << clrscr << "FreeRTOS Xmega Testing Program" << endl << endl;
+
+	// Characters typed on the serial port are received by interrupt, which wakes up
+	// the user interface task
+	serial_rx_init (&ser_dev);
+
+	// From here on, the tasks print into a buffer which DMA sends in the background.
+	// The user interface waits for room rather than cut its reports short
+	serial_tx_init (&ser_dev);
+	serial_tx ser_tx (SERIAL_TX_WAIT);
+	boot_profile_mark (BOOT_SERIAL);
 	
-	// The user interface is at low priority; it could have been run in the idle task
-	// but it is desired to exercise the RTOS more thoroughly in this test program
-	new task_user ("UserInt", task_priority (1), 260, &ser_dev);
-	
-	// The back motor task is 
-	new task_motor_back ("BACK MOTOR", task_priority (2), 260, &ser_dev);
+	// The task objects are made in static buffers rather than on the heap, so they're
+	// counted in .bss when the program is linked. The user interface is at low
+	// priority; it could have been run in the idle task but it is desired to exercise
+	// the RTOS more thoroughly in this test program
+	new (static_storage<task_user>::place ())
+		task_user ("UserInt", task_priority (1), user_stack_size, &ser_tx);
 	
-	// The front motor task is
-	new task_motor_front ("FRONT MOTOR", task_priority (2), 260, &ser_dev);
+	// One task runs all the motors, each as the axis table in motor_axes.cpp says
+	new (static_storage<task_motor>::place ())
+		task_motor ("MOTORS", task_priority (2), motor_stack_size, &print_ser_queue,
+					&motor_task);
+
+	// The supervisor is above all the tasks it watches, so it still runs when one of
+	// them hogs the CPU; it turns the watchdog on when it starts
+	new (static_storage<task_supervisor>::place ())
+		task_supervisor ("SUPERVISOR", task_priority (3), supervisor_stack_size);
+	boot_profile_mark (BOOT_TASKS);
 	
 	// Enable high - low level interrupts and enable global interrupts
 	PMIC_CTRL = (1 << PMIC_HILVLEN_bp | 1 << PMIC_MEDLVLEN_bp | 1 << PMIC_LOLVLEN_bp);
 	sei();
+	boot_profile_mark (BOOT_SCHEDULER);
 	
 	// Here's where the RTOS scheduler is started up. It should never exit as long as
 	// power is on and the microcontroller isn't rebooted
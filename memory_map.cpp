@@ -0,0 +1,73 @@
+//**************************************************************************************
+/** \file memory_map.cpp
+ *    This file contains the RAM layout report. The section symbols come from avr-libc's
+ *    linker scripts; only their addresses mean anything, so they're declared as chars.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/io.h>                         // RAMSTART, RAMEND and the stack pointer
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+
+#include "memory_map.h"                     // Header for this file
+
+
+#ifndef HAL_HOST
+	// Symbols which the linker puts at the starts and ends of the RAM sections
+	extern char __data_start;
+	extern char __data_end;
+	extern char __bss_start;
+	extern char __bss_end;
+	extern char __noinit_start;
+	extern char __noinit_end;
+	extern char __heap_start;
+
+	/// The RAM address of a linker symbol
+	#define RAM_ADDRESS(symbol)     ((uint16_t)(uintptr_t)&(symbol))
+#endif
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints one line of the report: a name, a start address and a size.
+ *  @param p_ser The serial device on which to print
+ *  @param p_name The name of the section
+ *  @param start The section's first address
+ *  @param end The address just past the section
+ */
+
+static void print_section (emstream* p_ser, const char* p_name, uint16_t start,
+						   uint16_t end)
+{
+	*p_ser << p_name << hex << start << PMS (" - ") << end << dec
+		   << PMS (" ") << (uint16_t)(end - start) << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the RAM layout: where .data, .bss and .noinit are and how big
+ *  they are, how much of the RTOS heap is left, and how much room there is between
+ *  the end of the static data and the stack which main() and startup run on.
+ *  @param p_ser The serial device on which to print
+ */
+
+void memory_map_print (emstream* p_ser)
+{
+#ifdef HAL_HOST
+	*p_ser << PMS ("No link map on the host") << endl;
+#else
+	*p_ser << PMS ("section  start - end   bytes") << endl;
+	print_section (p_ser, "data     ", RAM_ADDRESS (__data_start),
+				   RAM_ADDRESS (__data_end));
+	print_section (p_ser, "bss      ", RAM_ADDRESS (__bss_start),
+				   RAM_ADDRESS (__bss_end));
+	print_section (p_ser, "noinit   ", RAM_ADDRESS (__noinit_start),
+				   RAM_ADDRESS (__noinit_end));
+	print_section (p_ser, "free     ", RAM_ADDRESS (__heap_start), SP);
+	print_section (p_ser, "stack    ", SP, RAMEND + 1);
+#endif
+	*p_ser << PMS ("RTOS heap ") << (uint16_t)configTOTAL_HEAP_SIZE
+		   << PMS (" free ") << (uint16_t)xPortGetFreeHeapSize () << endl;
+}
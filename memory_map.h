@@ -0,0 +1,23 @@
+//**************************************************************************************
+/** \file memory_map.h
+ *    This file contains a report of how the AVR's RAM is laid out, taken from the
+ *    symbols the linker puts at the ends of each section. Everything but the RTOS
+ *    heap's free space is fixed when the program is linked, so the report shows
+ *    where the RAM went without guessing.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _MEMORY_MAP_H_
+#define _MEMORY_MAP_H_
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+// This function prints the sizes of the RAM sections, the heap and the free space
+void memory_map_print (emstream* p_ser);
+
+#endif // _MEMORY_MAP_H_
@@ -0,0 +1,173 @@
+//**************************************************************************************
+/** \file motion_profile.cpp
+ *    This file contains the S-curve table and the code which plans a ramp. Planning
+ *    takes a few divisions and a square root, all in integers; it's only done when a
+ *    target changes, not on every tick, and the tick rate's share of the work is done
+ *    beforehand by set_rate(), outside the interrupt which plans.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdlib.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "motion_profile.h"                 // Header for this file
+
+
+/// Eight points of the S-curve table, starting at the given index
+#define MOTION_PROFILE_ROW(n) \
+	motion_profile_point (n),     motion_profile_point (n + 1), \
+	motion_profile_point (n + 2), motion_profile_point (n + 3), \
+	motion_profile_point (n + 4), motion_profile_point (n + 5), \
+	motion_profile_point (n + 6), motion_profile_point (n + 7)
+
+/// The S-curve, computed by the compiler and kept in program memory
+const uint16_t motion_profile_table[MOTION_PROFILE_POINTS] PROGMEM =
+{
+	MOTION_PROFILE_ROW (0),  MOTION_PROFILE_ROW (8),
+	MOTION_PROFILE_ROW (16), MOTION_PROFILE_ROW (24),
+	MOTION_PROFILE_ROW (32), MOTION_PROFILE_ROW (40),
+	MOTION_PROFILE_ROW (48), MOTION_PROFILE_ROW (56),
+	motion_profile_point (64)
+};
+
+static_assert (motion_profile_point (64) == MOTION_PROFILE_ONE,
+			   "The S-curve table must end at 1.0");
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes a profile which sits at zero until it's given a target.
+ *  @param a_accel Most the value may change per ms, or 0 for no limit
+ *  @param a_jerk Most the change per ms may change per ms, or 0 for no limit
+ *  @param a_ticks_per_s How many times step() will be called per second
+ *                      (default: 1000)
+ */
+
+motion_profile::motion_profile (uint16_t a_accel, uint16_t a_jerk,
+								uint32_t a_ticks_per_s)
+	: accel (a_accel), jerk (a_jerk)
+{
+	set_rate (a_ticks_per_s);
+	reset (0);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method says how often step() will be called, for a profile whose tick rate
+ *  isn't known until its timer is set up. The rate is kept as ticks per ms, rounded
+ *  up so that a ramp is never faster than the limits allow. It may be called by a
+ *  task while the interrupt steps the profile.
+ *  @param a_ticks_per_s How many times step() will be called per second, such as
+ *                      the PWM frequency for a ramp stepped once per period; at
+ *                      most 255 kHz
+ */
+
+void motion_profile::set_rate (uint32_t a_ticks_per_s)
+{
+	uint16_t per_ms_q8 = (uint16_t)((a_ticks_per_s * 256UL + 999) / 1000);
+
+	portENTER_CRITICAL ();
+	ticks_per_ms_q8 = per_ms_q8;
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method puts the value and its target in one place at once, with no ramp.
+ *  @param new_value The new value
+ */
+
+void motion_profile::reset (int16_t new_value)
+{
+	value = new_value;
+	target = new_value;
+	from = new_value;
+	to = new_value;
+	phase = 0;
+	phase_step = 0;
+	running = false;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function works out how long a ramp has to take. The S-curve's steepest slope
+ *  is 1.5 times the distance over the time, and its sharpest bend is 6 times the
+ *  distance over the time squared, so the time is the larger of 1.5 d / a and
+ *  sqrt (6 d / j).
+ *  @param distance How far the value moves
+ *  @param accel Most the value may change per ms, or 0 for no limit
+ *  @param jerk Most the change per ms may change per ms, or 0 for no limit
+ *  @return The length of the ramp in ms, or 0 if it can be a jump
+ */
+
+uint16_t motion_profile::ramp_ms (uint16_t distance, uint16_t accel, uint16_t jerk)
+{
+	uint32_t rate_ms = 0;
+	uint32_t bend_ms = 0;
+
+	if (accel != 0)
+	{
+		rate_ms = (3UL * distance + 2UL * accel - 1) / (2UL * accel);
+	}
+	if (jerk != 0)
+	{
+		// Integer square root, one bit at a time, then rounded up
+		uint32_t square = (6UL * distance + jerk - 1) / jerk;
+		uint32_t remainder = square;
+		uint32_t bit = 1UL << 30;
+		while (bit > remainder)
+		{
+			bit >>= 2;
+		}
+		while (bit != 0)
+		{
+			if (remainder >= bend_ms + bit)
+			{
+				remainder -= bend_ms + bit;
+				bend_ms = (bend_ms >> 1) + bit;
+			}
+			else
+			{
+				bend_ms >>= 1;
+			}
+			bit >>= 2;
+		}
+		if (bend_ms * bend_ms < square)
+		{
+			bend_ms++;
+		}
+	}
+
+	uint32_t longest = (rate_ms > bend_ms) ? rate_ms : bend_ms;
+	return (longest > 0xFFFF) ? 0xFFFF : (uint16_t)longest;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method starts a ramp from the present value, which is at rest, to the
+ *  target. The ramp's length in ticks is rounded up, so at a rate which isn't a whole
+ *  number of ticks per ms the ramp is a little slower than the limits allow, never
+ *  faster. Only a ramp of no length is done as a jump.
+ */
+
+void motion_profile::start (void)
+{
+	from = value;
+	to = target;
+	phase = 0;
+
+	uint16_t distance = (uint16_t)labs ((int32_t)to - from);
+	uint32_t length_ms = ramp_ms (distance, accel, jerk);
+	uint32_t ticks = (length_ms * ticks_per_ms_q8 + 255) >> 8;
+	if (ticks == 0)
+	{
+		value = to;
+		running = false;
+		return;
+	}
+
+	phase_step = (ticks >= 65536UL) ? 1 : (uint16_t)(65536UL / ticks);
+	running = true;
+}
@@ -0,0 +1,154 @@
+//**************************************************************************************
+/** \file motion_profile.h
+ *    This file contains a motion profile generator which moves a value, such as a duty
+ *    cycle or a speed setpoint, smoothly from where it is to a new target instead of
+ *    jumping there. The ramp follows the S-curve s(x) = 3x^2 - 2x^3, which starts and
+ *    ends with zero slope, so both the rate of change ("acceleration") and its rate of
+ *    change ("jerk") are limited. The curve is read from a table in program memory
+ *    which the compiler fills in, so no floating point is done at run time.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _MOTION_PROFILE_H_
+#define _MOTION_PROFILE_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>                   // The S-curve table is in program memory
+
+
+/// The S-curve table has 2^MOTION_PROFILE_BITS segments, plus one entry for the end
+#define MOTION_PROFILE_BITS     6
+#define MOTION_PROFILE_POINTS   ((1 << MOTION_PROFILE_BITS) + 1)
+
+/// The S-curve's value at the end of the ramp; the table is in Q15
+#define MOTION_PROFILE_ONE      32768U
+
+
+/** This function computes one point of the S-curve for the table, as 32768 times
+ *  3x^2 - 2x^3 where x = index / 64. It's constexpr, so the compiler does the work.
+ *  @param index Which point, from 0 to 64
+ *  @return The point in Q15
+ */
+constexpr uint16_t motion_profile_point (uint32_t index)
+{
+	return (uint16_t)((192UL * index * index - 2UL * index * index * index + 4) / 8);
+}
+
+/// The S-curve from 0 to MOTION_PROFILE_ONE; defined in motion_profile.cpp
+extern const uint16_t motion_profile_table[MOTION_PROFILE_POINTS] PROGMEM;
+
+
+//-------------------------------------------------------------------------------------
+/** This class moves a value toward a target along the S-curve. It's stepped once per
+ *  tick by an interrupt, so the ramp is exact to the tick. The ramp is made as short
+ *  as the acceleration and jerk limits allow. A ramp starts and ends at rest, so a
+ *  target which changes while one is under way is only taken up once it has ended;
+ *  starting afresh from the middle of a ramp would stop the value dead and break
+ *  both limits.
+ */
+
+class motion_profile
+{
+protected:
+	/// Most the value may change per ms, or 0 for no limit
+	uint16_t accel;
+
+	/// Most the value's change per ms may change per ms, or 0 for no limit
+	uint16_t jerk;
+
+	/// How many times step() is called per ms, in Q8 and rounded up, as set_rate()
+	/// worked it out so that planning a ramp takes no division by 1000
+	uint16_t ticks_per_ms_q8;
+
+	/// The value now, the target, and where the current ramp started and ends
+	int16_t value;
+	int16_t target;
+	int16_t from;
+	int16_t to;
+
+	/// How far along the ramp the value is, and how far it goes each tick, where
+	/// 65536 is the whole ramp
+	uint16_t phase;
+	uint16_t phase_step;
+
+	/// Whether a ramp is under way
+	bool running;
+
+	// This method works out a new ramp from the present value to the target
+	void start (void);
+
+public:
+	// This constructor makes a profile with the given limits
+	motion_profile (uint16_t a_accel, uint16_t a_jerk, uint32_t a_ticks_per_s = 1000);
+
+	// This method says how often step() will be called
+	void set_rate (uint32_t a_ticks_per_s);
+
+	// This method puts the value and the target somewhere without a ramp
+	void reset (int16_t new_value);
+
+	/** This method moves the value one tick along toward the target. If the target is
+	 *  different from last time, a new ramp is started from where the value is, or if
+	 *  a ramp is under way, from where that one ends.
+	 *  @param new_target Where the value should end up
+	 *  @return The new value
+	 */
+	int16_t step (int16_t new_target)
+	{
+		if (new_target != target)
+		{
+			target = new_target;
+			if (!running)
+			{
+				start ();
+			}
+		}
+		if (!running)
+		{
+			return value;
+		}
+
+		uint32_t next = (uint32_t)phase + phase_step;
+		if (next > 0xFFFF)
+		{
+			value = to;
+			running = false;
+			if (target != to)
+			{
+				start ();
+			}
+			return value;
+		}
+		phase = (uint16_t)next;
+
+		// Read the curve between two table points and draw a line between them
+		uint8_t index = phase >> (16 - MOTION_PROFILE_BITS);
+		uint16_t fraction = phase & ((1U << (16 - MOTION_PROFILE_BITS)) - 1);
+		uint16_t low = pgm_read_word (&motion_profile_table[index]);
+		uint16_t high = pgm_read_word (&motion_profile_table[index + 1]);
+		uint16_t curve = low + (uint16_t)(((uint32_t)(high - low) * fraction)
+										  >> (16 - MOTION_PROFILE_BITS));
+
+		value = from + (int16_t)((((int32_t)to - from) * curve) >> 15);
+		return value;
+	}
+
+	/** This method returns the value, as step() most recently set it.
+	 *  @return The value
+	 */
+	int16_t get_value (void) const { return value; }
+
+	/** This method says whether the value is still moving toward its target.
+	 *  @return True during a ramp, false once the target has been reached
+	 */
+	bool is_running (void) const { return running; }
+
+	// This method works out how long a ramp takes, in ms
+	static uint16_t ramp_ms (uint16_t distance, uint16_t accel, uint16_t jerk);
+};
+
+#endif // _MOTION_PROFILE_H_
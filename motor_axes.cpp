@@ -0,0 +1,195 @@
+//**************************************************************************************
+/** \file motor_axes.cpp
+ *    This file contains the timer overflow interrupts which step the ramps of the
+ *    motors whose duty cycles are ramped. Each one runs once per PWM period; the
+ *    motor timers overflow together, as motor_sync_init() starts them in step. It
+ *    also contains the board's axis table and the functions which change and show
+ *    the motors' PWM setup, which work on every axis in the table.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
+#include "shares.h"                         // The motors' setpoint queues
+
+#include "motor_axes.h"                     // Header for this file
+#include "speed_control.h"                  // The back motor's speed setpoint
+#include "motor_sync.h"                     // Both motors' PWM changing together
+#include "current_sense.h"                  // Motor currents, read once per PWM period
+
+
+// The board's axis table. Each row names the bridge type, which says which timer and
+// pins the motor uses and which pin enables its driver; the motor's number in the
+// trace; its setpoint queue and the share which shows what it's doing; its speed
+// controller, if it has one; and the default levels the param command can change: its
+// duty cycles when stopped and when steering, its steering speed, and the highest
+// level a setpoint may ask for. The motor task runs the axes in this order
+const motor_axis_config motor_axis_table[MOTOR_AXIS_COUNT] PROGMEM =
+{
+	// The back motor's speed controller runs at 25 encoder counts per ms when steering
+	// and at most twice that; the duty cycles (7.5% and 31.25%) are only used if it
+	// runs open loop
+	{ "BACK MOTOR", &motor_bridge<back_bridge>::ops, TRACE_BACK, &setpoints_back,
+	  &steer_back, &speed_back,
+	  { PWM_DUTY_FULL * 3 / 40, PWM_DUTY_FULL * 5 / 16, 25, 50 } },
+
+	// The front motor is off when stopped and runs at 18.75% when steering
+	{ "FRONT MOTOR", &motor_bridge<front_bridge>::ops, TRACE_FRONT, &setpoints_front,
+	  &steer_front, NULL, { 0, PWM_DUTY_FULL * 3 / 16, 0, PWM_DUTY_FULL } },
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This function copies a motor's bridge functions out of program memory.
+ *  @param motor Which motor, by its number in the event trace
+ *  @param p_ops Where to put the functions
+ *  @return True if there's an axis for the motor, false if there isn't
+ */
+
+static bool bridge_of (uint8_t motor, motor_bridge_ops* p_ops)
+{
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		if (pgm_read_byte (&motor_axis_table[index].trace_source) == motor)
+		{
+			memcpy_P (p_ops, pgm_read_ptr (&motor_axis_table[index].p_bridge),
+					  sizeof (motor_bridge_ops));
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This interrupt steps the front motor's duty cycle ramps. Since it runs once per PWM
+ *  period, it also times out holds of the coordinated update.
+ */
+
+ISR (TCD0_OVF_vect)
+{
+	front_bridge::tick ();
+	motor_sync_written (MOTOR_SYNC_FRONT);
+	motor_sync_tick ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function turns off every motor's bridge driver at once. The motors stay off
+ *  until something turns their drivers back on.
+ */
+
+void motor_axes_safe (void)
+{
+	motor_bridge_ops ops;
+
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		memcpy_P (&ops, pgm_read_ptr (&motor_axis_table[index].p_bridge),
+				  sizeof (motor_bridge_ops));
+		ops.disable ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function changes one motor's PWM frequency, resolution and dead time. The
+ *  timers are then restarted from zero together, so they count in step again; the
+ *  motors only change at the same overflow while their frequencies are the same.
+ *  @param motor Which motor, by its number in the event trace
+ *  @param frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+ *  @param use_hires True to use the timer's high resolution extension
+ *  @param dead_ns The shortest on or off pulse the motor's bridges get, in ns
+ *  @return True if the motor was set up, false if the settings can't be used
+ */
+
+bool motor_pwm_configure (uint8_t motor, uint32_t frequency_hz, bool use_hires,
+						  uint16_t dead_ns)
+{
+	motor_bridge_ops ops;
+	if (!bridge_of (motor, &ops))
+	{
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	bool done = ops.configure (frequency_hz, use_hires, dead_ns);
+	if (done)
+	{
+		if (motor == TRACE_BACK)
+		{
+			current_sense_set_rate (frequency_hz);      // Its overflow starts the ADC
+		}
+		motor_sync_init ();
+	}
+	portEXIT_CRITICAL ();
+
+	return done;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function changes every motor's PWM frequency, keeping each one's resolution
+ *  and dead time, and restarts the timers together so the motors stay in step.
+ *  @param frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+ *  @return True if every motor was set up, false if one couldn't use the frequency
+ */
+
+bool motor_pwm_set_all (uint32_t frequency_hz)
+{
+	motor_bridge_ops ops;
+	bool done = true;
+
+	portENTER_CRITICAL ();
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		memcpy_P (&ops, pgm_read_ptr (&motor_axis_table[index].p_bridge),
+				  sizeof (motor_bridge_ops));
+		if (!ops.configure (frequency_hz, ops.hires (), ops.dead_ns ()))
+		{
+			done = false;
+		}
+		else if (pgm_read_byte (&motor_axis_table[index].trace_source) == TRACE_BACK)
+		{
+			current_sense_set_rate (frequency_hz);      // Its overflow starts the ADC
+		}
+	}
+	motor_sync_init ();
+	portEXIT_CRITICAL ();
+
+	return done;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints each motor's PWM frequency, how many compare steps there are
+ *  in a period, whether the high resolution extension is on and the dead time, one
+ *  line for each axis.
+ *  @param p_ser The serial device on which to print
+ */
+
+void motor_pwm_print (emstream* p_ser)
+{
+	motor_bridge_ops ops;
+
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		memcpy_P (&ops, pgm_read_ptr (&motor_axis_table[index].p_bridge),
+				  sizeof (motor_bridge_ops));
+		*p_ser << (const char*)pgm_read_ptr (&motor_axis_table[index].name)
+			   << PMS (" Hz ") << ops.frequency () << PMS (" steps ") << ops.steps ()
+			   << PMS (" hires ") << (uint8_t)ops.hires ()
+			   << PMS (" dead ns ") << ops.dead_ns () << endl;
+	}
+	if (!back_bridge::hires_available ())
+	{
+		*p_ser << PMS ("hires needs clkPER4 at 4x the CPU clock") << endl;
+	}
+}
@@ -0,0 +1,58 @@
+//**************************************************************************************
+/** \file motor_axes.h
+ *    This file says which timer and pins run each motor of the bowling ramp robot,
+ *    and the axis table in motor_axes.cpp says what else makes up each axis. Another
+ *    motor is added with a bridge type here, a row of the table, one more in
+ *    MOTOR_AXIS_COUNT and a number in the event trace, plus an overflow interrupt in
+ *    motor_axes.cpp if its duty cycles are ramped; its bridge is set up in main().
+ *    The motor task runs it with the others. The motors' PWM configuration is changed
+ *    through here.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _MOTOR_AXES_H_
+#define _MOTOR_AXES_H_
+
+#include "half_bridge_motor.h"              // Compile-time half bridge motor driver
+#include "ramped_bridge.h"                  // Half bridges whose duty cycles ramp
+#include "motor_axis.h"                     // One motor and its state machine
+#include "task_motor.h"                     // The task which runs all the motors
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The back motor: PWM from timer C0 on pins C0 and C1, driver enabled by pin A2. Its
+/// speed controller ramps the speed setpoint, so the duty cycles aren't ramped here
+typedef half_bridge_motor<TCC0_ADDR, PORTC_ADDR, PORTA_ADDR, 2> back_bridge;
+
+/// The front motor: PWM from timer D0 on pins D0 and D1, driver enabled by pin B2. Its
+/// duty cycles ramp by at most 307 per ms (1.9% of full), changing by at most 41 per
+/// ms each ms
+typedef ramped_bridge<half_bridge_motor<TCD0_ADDR, PORTD_ADDR, PORTB_ADDR, 2>,
+					  307, 41> front_bridge;
+
+/// The default PWM frequency at which the motors start, in Hz; the pwm command
+/// changes it while they run, and the param command changes where they start
+const uint32_t motor_pwm_hz = 20000;
+
+// The board's axis table, with one row for each motor
+extern const motor_axis_config motor_axis_table[MOTOR_AXIS_COUNT];
+
+
+// This function turns off every motor's bridge driver
+void motor_axes_safe (void);
+
+// This function changes one motor's PWM frequency, resolution and dead time
+bool motor_pwm_configure (uint8_t motor, uint32_t frequency_hz, bool use_hires,
+						  uint16_t dead_ns);
+
+// This function changes every motor's PWM frequency
+bool motor_pwm_set_all (uint32_t frequency_hz);
+
+// This function prints each motor's PWM configuration
+void motor_pwm_print (emstream* p_ser);
+
+#endif // _MOTOR_AXES_H_
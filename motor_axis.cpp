@@ -0,0 +1,250 @@
+//**************************************************************************************
+/** \file motor_axis.cpp
+ *    This file contains one axis of the robot: the state machine which steers a half
+ *    bridge motor from its queue of setpoints. It was the body of the front and back
+ *    motor tasks; now the one motor task runs it for every axis.
+ *
+ *  Revisions:
+ *    \li 10-25-2019 HVH Front and back motor tasks adapted from HVH task_PWM.h
+ *
+ *  License:
+ *    This file is copyright 2019 by H Hershberger and released under the GNU
+ *    Public License, version 2. It intended for educational use only, but its use
+ *    is not limited thereto. */
+//**************************************************************************************
+
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "trace.h"                          // Time stamped event trace
+#include "current_sense.h"                  // Motors cut off when their current is high
+#include "motor_axis.h"                     // Header for this file
+
+
+// Each state's actions. MOTOR_INIT has none; it goes to MOTOR_STOPPED on the first
+// pass, since the bridges are set up in main() so that all the motor timers can be
+// started in step with each other
+const fsm_state<motor_axis> motor_axis::actions[MOTOR_STATE_COUNT] PROGMEM =
+{
+	{ NULL,                         NULL,                           NULL },
+	{ &motor_axis::entered,         &motor_axis::drive_stopped,     NULL },
+	{ &motor_axis::entered,         &motor_axis::drive_port,        NULL },
+	{ &motor_axis::entered,         &motor_axis::drive_starboard,   NULL },
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes an axis from a row of the axis table. The row and its
+ *  bridge's functions are copied out of program memory, so the state machine's
+ *  actions read them from RAM. The bridge must have been set up before the axis runs.
+ *  @param p_row The axis's row of the table, in program memory
+ *  @param p_params The axis's levels in RAM. A change to them takes effect on the
+ *                  next pass; whoever changes one must not let the motor task in
+ *                  while it's half written
+ */
+
+motor_axis::motor_axis (const motor_axis_config* p_row,
+						const motor_axis_params* p_params)
+	: p_levels (p_params), machine (actions, pgm_read_byte (&p_row->trace_source))
+{
+	memcpy_P (&config, p_row, sizeof (motor_axis_config));
+	memcpy_P (&bridge, config.p_bridge, sizeof (motor_bridge_ops));
+
+	state = MOTOR_INIT;
+	runs = 0;
+	active.start = 0;
+	active.duration = 0;
+	active.level = 0;
+	active.command = 0;
+	fresh = false;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method finds the steering command to carry out. A setpoint with a duration
+ *  ends once it has run that long, and the motor is stopped. Then the setpoint at the
+ *  front of the queue is taken if its start time has come; only one is taken per
+ *  pass, so each one gets at least one pass of the state machine. The axis's
+ *  steering share is kept showing the command it's carrying out, so the user
+ *  interface sees what the motor is doing rather than what it was last sent.
+ *  @return The steering command of the setpoint being carried out
+ */
+
+uint8_t motor_axis::next_command (void)
+{
+	portTickType now = xTaskGetTickCount ();
+	setpoint next;
+
+	if (active.duration != 0
+		&& setpoint_reached (now, active.start + active.duration))
+	{
+		active.command = 0;
+		active.duration = 0;
+		active.level = 0;
+	}
+
+	if (config.p_setpoints->peek (next) && setpoint_reached (now, next.start))
+	{
+		config.p_setpoints->take (now - next.start);
+		active = next;
+		fresh = true;
+	}
+
+	if (config.p_steer->get () != active.command)
+	{
+		config.p_steer->put (active.command);
+	}
+	return active.command;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method works out how long the axis can wait before it has something to do:
+ *  a setpoint to take, a setpoint's duration to end, or the motor task's timeout.
+ *  @return Ticks to wait, or 0 if a setpoint is due now
+ */
+
+portTickType motor_axis::ticks_to_next (void)
+{
+	portTickType now = xTaskGetTickCount ();
+	portTickType wait = motor_timeout;
+	setpoint next;
+
+	if (config.p_setpoints->peek (next))
+	{
+		if (setpoint_reached (now, next.start))
+		{
+			return 0;
+		}
+		if ((portTickType)(next.start - now) < wait)
+		{
+			wait = next.start - now;
+		}
+	}
+	if (active.duration != 0)
+	{
+		portTickType end = active.start + active.duration;
+		if (setpoint_reached (now, end))
+		{
+			return 0;
+		}
+		if ((portTickType)(end - now) < wait)
+		{
+			wait = end - now;
+		}
+	}
+	return wait;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method works out the duty cycle or speed a steering state uses. A setpoint's
+ *  level, if it has one, takes the place of the axis's own; either way it never goes
+ *  above the axis's limit.
+ *  @param own_level The axis's own duty cycle or speed for steering
+ *  @return The level to use
+ */
+
+uint16_t motor_axis::level (uint16_t own_level)
+{
+	uint16_t wanted = (active.level != 0) ? active.level : own_level;
+	return (wanted > p_levels->max_level) ? p_levels->max_level : wanted;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method is the entry action of the stopped, port and starboard states. It
+ *  sets the new state's duty cycle or speed right away and puts the compare register
+ *  write in the trace, so the time from a key press to the new PWM can be measured.
+ *  @param command The steering command which caused the transition
+ */
+
+void motor_axis::entered (uint8_t command)
+{
+	machine.run (this, state, command);
+	trace (TRACE_PWM, config.trace_source, state);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sets the stopped duty cycle, or a speed of zero. A motor which was cut
+ *  off for drawing too much current runs again once it's stopped.
+ *  @param command The steering command, which isn't needed here
+ */
+
+void motor_axis::drive_stopped (uint8_t command)
+{
+	(void)command;
+	current_sense_clear (config.trace_source);
+	if (config.p_speed != NULL)
+	{
+		config.p_speed->put (0);
+	}
+	else
+	{
+		bridge.set_duty (p_levels->stopped_duty, p_levels->stopped_duty);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method steers to port: it sets the port half bridge's duty cycle, or a
+ *  positive speed.
+ *  @param command The steering command, which isn't needed here
+ */
+
+void motor_axis::drive_port (uint8_t command)
+{
+	(void)command;
+	if (config.p_speed != NULL)
+	{
+		config.p_speed->put ((int16_t)level (p_levels->running_speed));
+	}
+	else
+	{
+		bridge.set_port_duty (level (p_levels->running_duty));
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method steers to starboard: it sets the starboard half bridge's duty cycle,
+ *  or a negative speed.
+ *  @param command The steering command, which isn't needed here
+ */
+
+void motor_axis::drive_starboard (uint8_t command)
+{
+	(void)command;
+	if (config.p_speed != NULL)
+	{
+		config.p_speed->put (-(int16_t)level (p_levels->running_speed));
+	}
+	else
+	{
+		bridge.set_starboard_duty (level (p_levels->running_duty));
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method runs one pass of the state machine: it takes the steering command and
+ *  carries it out. If the command leads to another state, the new state's entry
+ *  action sets its duty cycle or speed; otherwise the state's action sets them again,
+ *  in case a new setpoint changed the level. Nothing in it waits, so it can be timed
+ *  by itself.
+ *  @return True if the state changed
+ */
+
+bool motor_axis::step (void)
+{
+	uint8_t command = next_command ();      // Steering command from the setpoints
+	bool changed = machine.fire (this, state, command);
+
+	if (!changed)
+	{
+		machine.run (this, state, command);
+	}
+	runs++;
+
+	return changed;
+}
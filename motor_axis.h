@@ -0,0 +1,255 @@
+//**************************************************************************************
+/** \file motor_axis.h
+ *    This file contains one axis of the robot: a half bridge motor, the queue of its
+ *    setpoints and the state machine which steers it. An axis isn't a task; the motor
+ *    task runs every axis in turn, so another axis costs its own few dozen bytes of
+ *    RAM rather than a task with its own stack. What each axis is made of, from its
+ *    bridge to its speed controller, comes from a row of the board's axis table in
+ *    motor_axes.cpp, and the code is the same for all of them. Its duty cycles and
+ *    limit are parameters, which the row gives defaults for and which can be tuned
+ *    while it runs.
+ *
+ *    The bridge types keep their timer and pins as template parameters, so a bridge's
+ *    register writes are still single instructions; an axis reaches its bridge
+ *    through a table of the bridge's functions which the compiler makes for each
+ *    bridge type.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _MOTOR_AXIS_H_
+#define _MOTOR_AXIS_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>                   // Tables in program memory
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
+#include "fsm.h"                            // Table driven state machines
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/** This constant sets how many RTOS ticks the motor task waits for a new setpoint
+ *  before it runs the axes' state machines anyway. It is only a safety net; normally
+ *  the user interface task wakes the motor task as soon as a setpoint is sent.
+ */
+const portTickType motor_timeout = configMS_TO_TICKS (10);
+
+
+/// The states of a motor axis; like every state machine's, their names start with
+/// the machine's, as they're seen wherever this file is included
+enum motor_states
+{
+	MOTOR_INIT,
+	MOTOR_STOPPED,
+	MOTOR_PORT,
+	MOTOR_STARBOARD,
+	MOTOR_STATE_COUNT
+};
+
+/// The events of a motor axis are its steering commands: 0 = stop, 1 = port and
+/// 2 = starboard
+#define MOTOR_COMMAND_COUNT     3
+
+/// A motor axis's transitions. A motor steering one way can be told to steer the
+/// other way without stopping in between, since a queued burst of commands may do
+/// just that
+typedef fsm_rows<
+	fsm_row<MOTOR_INIT,         FSM_ANY,    MOTOR_STOPPED>,
+	fsm_row<MOTOR_STOPPED,      1,          MOTOR_PORT>,
+	fsm_row<MOTOR_STOPPED,      2,          MOTOR_STARBOARD>,
+	fsm_row<MOTOR_PORT,         0,          MOTOR_STOPPED>,
+	fsm_row<MOTOR_PORT,         2,          MOTOR_STARBOARD>,
+	fsm_row<MOTOR_STARBOARD,    0,          MOTOR_STOPPED>,
+	fsm_row<MOTOR_STARBOARD,    1,          MOTOR_PORT>
+	> motor_transitions;
+
+
+/// The functions of one bridge type, which an axis calls to run its motor
+struct motor_bridge_ops
+{
+	void (*set_duty) (uint16_t port_duty, uint16_t starboard_duty);
+	void (*set_port_duty) (uint16_t duty);
+	void (*set_starboard_duty) (uint16_t duty);
+	void (*enable) (void);
+	void (*disable) (void);
+	bool (*configure) (uint32_t frequency_hz, bool use_hires, uint16_t dead_ns);
+	uint32_t (*frequency) (void);
+	uint16_t (*steps) (void);
+	bool (*hires) (void);
+	uint16_t (*dead_ns) (void);
+};
+
+/** This class holds the table of a bridge type's functions, in program memory.
+ *  @param bridge A half_bridge_motor or ramped_bridge type
+ */
+template <class bridge>
+struct motor_bridge
+{
+	/// The bridge's functions
+	static const motor_bridge_ops ops;
+};
+
+// The table of each bridge type
+template <class bridge>
+const motor_bridge_ops motor_bridge<bridge>::ops PROGMEM =
+{
+	&bridge::set_duty,
+	&bridge::set_port_duty,
+	&bridge::set_starboard_duty,
+	&bridge::enable,
+	&bridge::disable,
+	&bridge::configure,
+	&bridge::frequency,
+	&bridge::steps,
+	&bridge::hires,
+	&bridge::dead_ns,
+};
+
+
+/// The levels at which an axis runs its motor; they can be tuned while it runs
+struct motor_axis_params
+{
+	uint16_t stopped_duty;                  ///< Duty cycle of both half bridges when
+											///< stopped, from 0 to PWM_DUTY_FULL
+	uint16_t running_duty;                  ///< Duty cycle of the active half bridge
+											///< when steering
+	uint16_t running_speed;                 ///< Speed setpoint when steering, in
+											///< encoder counts per ms
+	uint16_t max_level;                     ///< Highest duty cycle, or speed with a
+											///< speed controller, the motor is given
+};
+
+/// One row of the board's axis table: everything which makes one axis what it is
+struct motor_axis_config
+{
+	const char* name;                       ///< Name, as printed in reports
+	const motor_bridge_ops* p_bridge;       ///< The bridge's functions, in program memory
+	uint8_t trace_source;                   ///< Which motor it is in the event trace
+	setpoint_queue* p_setpoints;            ///< The queue its setpoints come from
+	atomic_share<uint8_t>* p_steer;         ///< Share which shows the steering command
+											///< it's carrying out
+	atomic_share<int16_t>* p_speed;         ///< Setpoint share of a speed controller
+											///< which owns the compare registers, or
+											///< NULL to set the duty cycles directly
+	motor_axis_params defaults;             ///< Its levels until they're tuned
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class runs one half bridge motor. The motor sits still at one duty cycle and
+ *  steers to port or to starboard by raising the duty cycle of the port or starboard
+ *  half bridge. If the motor has a speed controller, the axis gives it speed
+ *  setpoints instead. Steering commands come from a setpoint queue, one at a time and
+ *  each at its own time, so a quick burst of commands is carried out in order rather
+ *  than only the last one.
+ */
+
+class motor_axis
+{
+protected:
+	/// What this axis is made of, copied from its row of the axis table
+	motor_axis_config config;
+
+	/// Its bridge's functions, copied from program memory
+	motor_bridge_ops bridge;
+
+	/// The levels it runs at, which are read afresh on every pass
+	const motor_axis_params* p_levels;
+
+	/// The state machine and each state's actions
+	fsm<motor_axis, motor_transitions, MOTOR_STATE_COUNT, MOTOR_COMMAND_COUNT> machine;
+	static const fsm_state<motor_axis> actions[MOTOR_STATE_COUNT];
+
+	/// The state the machine is in
+	uint8_t state;
+
+	/// How many passes the state machine has run
+	uint32_t runs;
+
+	/// The setpoint being carried out now
+	setpoint active;
+
+	/// True if a setpoint has been taken since took_setpoint() was last called
+	bool fresh;
+
+	// This method takes the next setpoint if its time has come and returns the command
+	uint8_t next_command (void);
+
+	// This method works out the level a steering state should use
+	uint16_t level (uint16_t own_level);
+
+	// These methods are the states' actions
+	void entered (uint8_t command);
+	void drive_stopped (uint8_t command);
+	void drive_port (uint8_t command);
+	void drive_starboard (uint8_t command);
+
+public:
+	// This constructor makes an axis from a row of the axis table
+	motor_axis (const motor_axis_config* p_row, const motor_axis_params* p_params);
+
+	// This method runs one pass of the state machine; the benchmarks call it too
+	bool step (void);
+
+	// This method works out how long the axis can wait before it has something to do
+	portTickType ticks_to_next (void);
+
+	/** This method returns the state the axis is in.
+	 *  @return The state, one of motor_states
+	 */
+	uint8_t get_state (void)
+	{
+		return state;
+	}
+
+	/** This method returns how many passes the state machine has run.
+	 *  @return The count of passes
+	 */
+	uint32_t get_runs (void)
+	{
+		return runs;
+	}
+
+	/** This method tells whether the axis has taken a setpoint from its queue since
+	 *  it was last asked, so that a coordinated update isn't marked as taken by a
+	 *  motor whose new setpoint hasn't been queued yet.
+	 *  @return True if a setpoint was taken
+	 */
+	bool took_setpoint (void)
+	{
+		bool was_fresh = fresh;
+		fresh = false;
+		return was_fresh;
+	}
+
+	/** This method returns which motor this is, as it appears in the event trace.
+	 *  @return TRACE_FRONT, TRACE_BACK or another motor's number
+	 */
+	uint8_t source (void)
+	{
+		return config.trace_source;
+	}
+
+	/** This method returns the axis's name.
+	 *  @return The name, a string constant
+	 */
+	const char* name (void)
+	{
+		return config.name;
+	}
+
+	/** This method prints the state machine's last transitions.
+	 *  @param p_ser The serial device on which to print
+	 */
+	void print_transitions (emstream* p_ser)
+	{
+		machine.print_history (p_ser);
+	}
+};
+
+#endif // _MOTOR_AXIS_H_
@@ -0,0 +1,170 @@
+//**************************************************************************************
+/** \file motor_sync.cpp
+ *    This file contains the coordinated update of the motors' PWM. A new command gets
+ *    to a motor's compare registers in two hops: the motor task takes it up and sets a
+ *    target, then an interrupt (the front motor's ramp tick or the back motor's speed
+ *    controller) writes the compare registers. A motor counts as ready once its
+ *    interrupt has written after its task took the command. The front motor's ramp
+ *    tick runs every PWM period, so it also lets go of a hold which runs too long.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+
+#include "motor_axes.h"                     // Which timers run the motors
+#include "motor_sync.h"                     // Header for this file
+
+
+/// Motors whose new duty cycles haven't been written yet; while any are, both timers
+/// hold their compare registers
+static volatile uint8_t waiting = 0;
+
+/// Motors whose tasks have taken up their new command since the hold began
+static volatile uint8_t taken = 0;
+
+/// PWM periods left before the hold is let go anyway
+static volatile uint8_t hold_left = 0;
+
+// Counts of coordinated updates
+static uint16_t updates = 0;                ///< Holds begun
+static uint16_t together = 0;               ///< Holds let go with every motor ready
+static uint16_t timeouts = 0;               ///< Holds let go by MOTOR_SYNC_HOLD
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets both motor timers to count event channel 7 and then connects
+ *  the channel to the undivided peripheral clock, so both timers start counting on
+ *  the same cycle and overflow together from then on. Both bridges must have been
+ *  set up first, since that starts their timers from the CPU clock.
+ */
+
+void motor_sync_init (void)
+{
+	EVSYS.CH7MUX = EVSYS_CHMUX_OFF_gc;
+	back_bridge::restart_from (TC_CLKSEL_EVCH7_gc);
+	front_bridge::restart_from (TC_CLKSEL_EVCH7_gc);
+	EVSYS.CH7MUX = EVSYS_CHMUX_PRESCALER_1_gc;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function lets go of the hold, so whatever is in both timers' buffer registers
+ *  goes to the compare registers at the next overflow. It must be called with
+ *  interrupts off.
+ */
+
+static void release (void)
+{
+	back_bridge::unlock_update ();
+	front_bridge::unlock_update ();
+	waiting = 0;
+	taken = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function starts a coordinated update. It's called just before new commands
+ *  are given to more than one motor; a command for only one motor needs no holding.
+ *  It may be called from a task or an interrupt.
+ *  @param motors The motors being given new commands, as MOTOR_SYNC_ bits
+ */
+
+void motor_sync_begin (uint8_t motors)
+{
+	if ((motors & MOTOR_SYNC_ALL) != MOTOR_SYNC_ALL)
+	{
+		return;
+	}
+
+	portENTER_CRITICAL ();
+	back_bridge::lock_update ();
+	front_bridge::lock_update ();
+	waiting = motors & MOTOR_SYNC_ALL;
+	taken = 0;
+	hold_left = MOTOR_SYNC_HOLD;
+	updates++;
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a motor task after each pass in which it has taken a
+ *  new setpoint and set its duty cycle or speed target from it. A pass in which it
+ *  took nothing doesn't count, since the motor's new setpoint may not be queued yet.
+ *  @param motor The task's motor, as a MOTOR_SYNC_ bit
+ */
+
+void motor_sync_taken (uint8_t motor)
+{
+	if (waiting & motor)
+	{
+		portENTER_CRITICAL ();
+		taken |= (waiting & motor);
+		portEXIT_CRITICAL ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by the interrupt which writes a motor's buffered compare
+ *  registers, after it has written them. Once every motor in the update has been
+ *  written since its task took the command, the hold is let go.
+ *  @param motor The motor whose registers were written, as a MOTOR_SYNC_ bit
+ */
+
+void motor_sync_written (uint8_t motor)
+{
+	if (taken & motor)
+	{
+		portENTER_CRITICAL ();
+		if (taken & motor)
+		{
+			taken &= ~motor;
+			waiting &= ~motor;
+			if (waiting == 0)
+			{
+				release ();
+				together++;
+			}
+		}
+		portEXIT_CRITICAL ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called once every PWM period. If a hold has gone on for
+ *  MOTOR_SYNC_HOLD periods, a motor didn't get its new duty cycle in time, so the
+ *  hold is let go with whatever has been written.
+ */
+
+void motor_sync_tick (void)
+{
+	if (waiting != 0)
+	{
+		portENTER_CRITICAL ();
+		if (waiting != 0 && --hold_left == 0)
+		{
+			release ();
+			timeouts++;
+		}
+		portEXIT_CRITICAL ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints how many coordinated updates there have been, how many were
+ *  let go with both motors' new duty cycles and how many ran out of time.
+ *  @param p_ser The serial device on which to print
+ */
+
+void motor_sync_print (emstream* p_ser)
+{
+	*p_ser << PMS ("sync updates ") << updates
+		   << PMS (" together ") << together
+		   << PMS (" timed out ") << timeouts << endl;
+}
@@ -0,0 +1,53 @@
+//**************************************************************************************
+/** \file motor_sync.h
+ *    This file contains the coordinated update of the front and back motors' PWM. The
+ *    two timers are clocked from one event channel so that they overflow on the same
+ *    clock cycle. When both motors are given new commands at once, the buffered
+ *    compare registers of both timers are held (the timers' LUPD bit) until the new
+ *    duty cycles of both have been written; they are then let go together, so both
+ *    motors change at the same overflow instead of up to a control period apart.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _MOTOR_SYNC_H_
+#define _MOTOR_SYNC_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "trace.h"                          // Motors are numbered as in the trace
+
+
+/// Bits which stand for the motors in a coordinated update
+#define MOTOR_SYNC_FRONT        (1 << TRACE_FRONT)
+#define MOTOR_SYNC_BACK         (1 << TRACE_BACK)
+#define MOTOR_SYNC_ALL          (MOTOR_SYNC_FRONT | MOTOR_SYNC_BACK)
+
+/// The most PWM periods the compare registers are held, in case a motor's new duty
+/// cycle never comes; 60 periods is 3 ms at 20 kHz
+#define MOTOR_SYNC_HOLD         60
+
+
+// This function starts both motor timers on the same clock cycle; it's called from main()
+void motor_sync_init (void);
+
+// This function holds both timers' compare registers until the given motors have new values
+void motor_sync_begin (uint8_t motors);
+
+// This function is called by a motor task each time it has acted on a new setpoint
+void motor_sync_taken (uint8_t motor);
+
+// This function is called by an interrupt each time it has written a motor's duty cycles
+void motor_sync_written (uint8_t motor);
+
+// This function is called once per PWM period to let go of a hold which has taken too long
+void motor_sync_tick (void);
+
+// This function prints how many coordinated updates there were and how they ended
+void motor_sync_print (emstream* p_ser);
+
+#endif // _MOTOR_SYNC_H_
@@ -0,0 +1,365 @@
+//**************************************************************************************
+/** \file params.cpp
+ *    This file contains the robot's tunable parameters and the block in the EEPROM
+ *    which keeps them. Each one is set through a function here, which checks its
+ *    range and passes it on to whatever uses it when it can't simply be read from RAM,
+ *    such as the timer behind the control loops.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <string.h>                         // Functions for C string handling
+#include <stddef.h>                         // For offsetof()
+#include <avr/eeprom.h>                     // EEPROM access from avr-libc
+#include <avr/pgmspace.h>                   // Tables and strings in program memory
+#include <util/crc16.h>                     // CRC functions from avr-libc
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "control_loop.h"                   // The control loops' rate
+#include "speed_control.h"                  // The speed controller's gains
+#include "motor_axes.h"                     // The axis table and the PWM setup
+#include "supervisor.h"                     // Deadline watch during EEPROM writes
+#include "params.h"                         // Header for this file
+
+
+/// The parameters as they're kept in the EEPROM
+struct param_block
+{
+	uint8_t version;                        ///< PARAMS_VERSION of the program which
+											///< saved it
+	uint8_t length;                         ///< Size of the values when they were saved
+	param_values values;                    ///< The parameters
+	uint16_t crc;                           ///< CRC-16/XMODEM of everything above
+};
+
+/// One of an axis's parameters, as the param command names it
+struct param_field
+{
+	char name[6];                           ///< Name of the parameter
+	uint8_t offset;                         ///< Where it is in motor_axis_params
+	uint16_t limit;                         ///< Highest value it may be given
+	uint16_t speed_limit;                   ///< Highest value for an axis with a speed
+											///< controller
+};
+
+/// The parameters of each axis; duty cycles go up to PWM_DUTY_FULL and speeds, in
+/// encoder counts per ms, up to SPEED_SETPOINT_MAX, and the highest level is a speed
+/// only for an axis with a speed controller
+static const param_field axis_fields[] PROGMEM =
+{
+	{ "stop",   offsetof (motor_axis_params, stopped_duty),
+	  PWM_DUTY_FULL,        PWM_DUTY_FULL },
+	{ "run",    offsetof (motor_axis_params, running_duty),
+	  PWM_DUTY_FULL,        PWM_DUTY_FULL },
+	{ "speed",  offsetof (motor_axis_params, running_speed),
+	  SPEED_SETPOINT_MAX,   SPEED_SETPOINT_MAX },
+	{ "max",    offsetof (motor_axis_params, max_level),
+	  PWM_DUTY_FULL,        SPEED_SETPOINT_MAX },
+};
+
+/// How many parameters each axis has
+const uint8_t axis_field_count = sizeof (axis_fields) / sizeof (axis_fields[0]);
+
+
+// The parameters in RAM
+param_values params;
+
+/// The parameters in the EEPROM
+static param_block EEMEM saved_block;
+
+/// True if the parameters in RAM were read from the EEPROM, false if they're defaults
+static bool loaded = false;
+
+/// True if the parameters in RAM have been changed since they were read or saved
+static bool changed = false;
+
+
+//-------------------------------------------------------------------------------------
+/** This function works out the CRC of a parameter block.
+ *  @param p_block The block
+ *  @return The CRC of everything in it but the CRC itself
+ */
+
+static uint16_t block_crc (const param_block* p_block)
+{
+	const uint8_t* p_byte = (const uint8_t*)p_block;
+	uint16_t crc = 0;
+
+	while (p_byte < (const uint8_t*)&p_block->crc)
+	{
+		crc = _crc_xmodem_update (crc, *p_byte++);
+	}
+	return crc;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts the default parameters in RAM: each axis's levels from its row
+ *  of the axis table, and the rest from the constants they replaced.
+ */
+
+void params_defaults (void)
+{
+	param_values values;
+
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		memcpy_P (&values.axes[index], &motor_axis_table[index].defaults,
+				  sizeof (motor_axis_params));
+	}
+	values.pwm_hz = motor_pwm_hz;
+	values.loop_hz = CONTROL_LOOP_HZ;
+	values.speed_gains = speed_control_gains;
+
+	portENTER_CRITICAL ();
+	params = values;
+	portEXIT_CRITICAL ();
+
+	loaded = false;
+	changed = true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function reads the parameters from the EEPROM into RAM. It's called once in
+ *  main(), before anything which uses them is set up. If the block in the EEPROM has
+ *  another version or size or a bad CRC, the defaults are used instead.
+ *  @return True if the parameters came from the EEPROM
+ */
+
+bool params_load (void)
+{
+	param_block block;
+
+	eeprom_read_block (&block, &saved_block, sizeof (param_block));
+	if (block.version != PARAMS_VERSION || block.length != sizeof (param_values)
+		|| block.crc != block_crc (&block))
+	{
+		params_defaults ();
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	params = block.values;
+	portEXIT_CRITICAL ();
+
+	loaded = true;
+	changed = false;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function saves the parameters in RAM to the EEPROM. Only the bytes which
+ *  have changed are written, so saving again what's already there costs no wear.
+ *  The task which calls it waits while the EEPROM is written, which takes about 8 ms
+ *  for each byte which changed; it tells the supervisor it's still alive after each
+ *  one, so that a first save of the whole block isn't taken for a stalled task.
+ */
+
+void params_save (void)
+{
+	param_block block;
+
+	block.version = PARAMS_VERSION;
+	block.length = sizeof (param_values);
+	portENTER_CRITICAL ();
+	block.values = params;
+	portEXIT_CRITICAL ();
+	block.crc = block_crc (&block);
+
+	const uint8_t* p_byte = (const uint8_t*)&block;
+	uint8_t* p_saved = (uint8_t*)&saved_block;
+	for (uint8_t index = 0; index < sizeof (param_block); index++)
+	{
+		eeprom_update_byte (p_saved + index, p_byte[index]);
+		supervisor_alive ();
+	}
+	loaded = true;
+	changed = false;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts the parameters in RAM to use after they've been loaded or reset
+ *  while the robot runs: it sets the PWM frequency, control loop rate and gains. The
+ *  axes read their levels from RAM, so they need nothing done.
+ *  @return True if all of them could be used
+ */
+
+bool params_apply (void)
+{
+	bool done = motor_pwm_set_all (params.pwm_hz);
+	done = control_loop_set_rate (params.loop_hz) && done;
+	speed_control_set_gains (params.speed_gains);
+
+	return done;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets one of an axis's parameters. The axis uses it on its next pass.
+ *  @param index Which axis, its row in the axis table
+ *  @param name The parameter's name: stop, run, speed or max
+ *  @param value The new value, a duty cycle from 0 to PWM_DUTY_FULL or a speed from 0
+ *               to SPEED_SETPOINT_MAX
+ *  @return True if it was set, false if the axis, name or value is wrong
+ */
+
+bool params_set_axis (uint8_t index, const char* name, uint16_t value)
+{
+	if (index >= MOTOR_AXIS_COUNT)
+	{
+		return false;
+	}
+	bool has_speed = (pgm_read_ptr (&motor_axis_table[index].p_speed) != NULL);
+
+	for (uint8_t field = 0; field < axis_field_count; field++)
+	{
+		if (strcmp_P (name, axis_fields[field].name) == 0)
+		{
+			if (value > pgm_read_word (has_speed ? &axis_fields[field].speed_limit
+											   : &axis_fields[field].limit))
+			{
+				return false;
+			}
+			uint16_t* p_value = (uint16_t*)((uint8_t*)&params.axes[index]
+							   + pgm_read_byte (&axis_fields[field].offset));
+			portENTER_CRITICAL ();
+			*p_value = value;
+			portEXIT_CRITICAL ();
+
+			changed = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function records a PWM frequency or control loop rate which has already been
+ *  put to use, such as by the pwm or loop command, so that it's the one printed and
+ *  saved. A PWM frequency set for one motor is the one every motor starts at.
+ *  @param name The parameter's name: pwm or loop
+ *  @param value The frequency or rate in Hz
+ *  @return True if it was recorded, false if the name or value is wrong
+ */
+
+bool params_note (const char* name, int32_t value)
+{
+	if (strcmp_P (name, PSTR ("pwm")) == 0)
+	{
+		if (value < (int32_t)PWM_MIN_HZ || value > (int32_t)PWM_MAX_HZ)
+		{
+			return false;
+		}
+		portENTER_CRITICAL ();
+		params.pwm_hz = (uint32_t)value;
+		portEXIT_CRITICAL ();
+	}
+	else if (strcmp_P (name, PSTR ("loop")) == 0)
+	{
+		if (value < CONTROL_LOOP_MIN_HZ || value > CONTROL_LOOP_MAX_HZ)
+		{
+			return false;
+		}
+		portENTER_CRITICAL ();
+		params.loop_hz = (uint16_t)value;
+		portEXIT_CRITICAL ();
+	}
+	else
+	{
+		return false;
+	}
+
+	changed = true;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets one of the parameters which aren't an axis's, and puts it to
+ *  use right away: pwm changes every motor's PWM frequency, keeping its resolution
+ *  and dead time, loop the control loop executor's rate, and kp, ki and kd the speed
+ *  controller's gains.
+ *  @param name The parameter's name: pwm, loop, kp, ki or kd
+ *  @param value The new value
+ *  @return True if it was set, false if the name or value is wrong
+ */
+
+bool params_set (const char* name, int32_t value)
+{
+	if (strcmp_P (name, PSTR ("pwm")) == 0)
+	{
+		return value >= (int32_t)PWM_MIN_HZ && value <= (int32_t)PWM_MAX_HZ
+			   && motor_pwm_set_all ((uint32_t)value) && params_note (name, value);
+	}
+	if (strcmp_P (name, PSTR ("loop")) == 0)
+	{
+		return value >= CONTROL_LOOP_MIN_HZ && value <= CONTROL_LOOP_MAX_HZ
+			   && control_loop_set_rate ((uint16_t)value) && params_note (name, value);
+	}
+
+	if (value < INT16_MIN || value > INT16_MAX)
+	{
+		return false;
+	}
+	pid_gains gains = params.speed_gains;
+	if (strcmp_P (name, PSTR ("kp")) == 0)
+	{
+		gains.kp = (int16_t)value;
+	}
+	else if (strcmp_P (name, PSTR ("ki")) == 0)
+	{
+		gains.ki = (int16_t)value;
+	}
+	else if (strcmp_P (name, PSTR ("kd")) == 0)
+	{
+		gains.kd = (int16_t)value;
+	}
+	else
+	{
+		return false;
+	}
+	speed_control_set_gains (gains);
+
+	portENTER_CRITICAL ();
+	params.speed_gains = gains;
+	portEXIT_CRITICAL ();
+
+	changed = true;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints every parameter, a line for each axis and one for the rest,
+ *  and where they came from.
+ *  @param p_ser The serial device on which to print
+ */
+
+void params_print (emstream* p_ser)
+{
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		*p_ser << (const char*)pgm_read_ptr (&motor_axis_table[index].name);
+		for (uint8_t field = 0; field < axis_field_count; field++)
+		{
+			char name[sizeof (axis_fields[0].name)];
+			strcpy_P (name, axis_fields[field].name);
+			*p_ser << ' ' << name << ' '
+				   << *(const uint16_t*)((const uint8_t*)&params.axes[index]
+										 + pgm_read_byte (&axis_fields[field].offset));
+		}
+		*p_ser << endl;
+	}
+	*p_ser << PMS ("pwm ") << params.pwm_hz << PMS (" loop ") << params.loop_hz
+		   << PMS (" kp ") << params.speed_gains.kp
+		   << PMS (" ki ") << params.speed_gains.ki
+		   << PMS (" kd ") << params.speed_gains.kd << endl;
+	*p_ser << (loaded ? PMS ("from EEPROM") : PMS ("defaults"))
+		   << (changed ? PMS (", changed since") : PMS ("")) << endl;
+}
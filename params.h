@@ -0,0 +1,78 @@
+//**************************************************************************************
+/** \file params.h
+ *    This file contains the robot's tunable parameters: each motor's duty cycles,
+ *    steering speed and limit, the PWM frequency and control loop rate it starts
+ *    with, and the speed controller's gains. They're kept in a block in the EEPROM
+ *    with a version number and a CRC, which is read into RAM once at startup; the code
+ *    which uses a parameter reads it from RAM, like any other variable. The param
+ *    command changes them while the robot runs and saves them to the EEPROM, so a lane
+ *    can be tuned without building and flashing the program each time.
+ *
+ *    A block which was saved by a program with a different layout, or whose CRC is
+ *    wrong, isn't used; the defaults are, until the parameters are saved again.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _PARAMS_H_
+#define _PARAMS_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "fixed_pid.h"                      // The speed controller's gains
+#include "motor_axis.h"                     // Each axis's levels
+#include "task_motor.h"                     // How many axes there are
+
+
+/// The layout of the parameter block; it must go up by one whenever param_values
+/// changes, so that a block saved by an older program isn't read as this one's
+#define PARAMS_VERSION          2
+
+
+/// The parameters
+struct param_values
+{
+	motor_axis_params axes[MOTOR_AXIS_COUNT];   ///< Each axis's levels, in table order
+	uint32_t pwm_hz;                        ///< PWM frequency the motors start at
+	uint16_t loop_hz;                       ///< Control loop executor's rate
+	pid_gains speed_gains;                  ///< The speed controller's gains, in Q8
+};
+
+
+// This function reads the parameters from the EEPROM, or uses the defaults
+bool params_load (void);
+
+// This function puts the default parameters in RAM
+void params_defaults (void);
+
+// This function saves the parameters in RAM to the EEPROM
+void params_save (void);
+
+// This function puts the loaded parameters to use while the robot runs
+bool params_apply (void);
+
+// This function sets one axis's parameter by name
+bool params_set_axis (uint8_t index, const char* name, uint16_t value);
+
+// This function sets one of the parameters which aren't an axis's by name
+bool params_set (const char* name, int32_t value);
+
+// This function records a rate which another command has already put to use
+bool params_note (const char* name, int32_t value);
+
+// This function prints every parameter
+void params_print (emstream* p_ser);
+
+
+/**
+ * \var params
+ * \brief The parameters in RAM. Only the user interface changes them, in a critical
+ *        section, so whoever reads them never sees one half written.
+ */
+extern param_values params;
+
+#endif // _PARAMS_H_
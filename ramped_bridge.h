@@ -0,0 +1,138 @@
+//**************************************************************************************
+/** \file ramped_bridge.h
+ *    This file contains a half bridge motor driver whose duty cycles ramp to new values
+ *    along an S-curve instead of jumping there, which keeps current spikes and wheel
+ *    slip down. It has the same static methods as half_bridge_motor, so a motor task
+ *    can use either one; the difference is that set_duty() and friends only set a
+ *    target, and the timer's overflow interrupt moves the compare registers toward it
+ *    one PWM period at a time.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _RAMPED_BRIDGE_H_
+#define _RAMPED_BRIDGE_H_
+
+#include <stdint.h>
+
+#include "half_bridge_motor.h"              // Compile-time half bridge motor driver
+#include "motion_profile.h"                 // S-curve ramps
+#include "atomic_share.h"                   // Lock-free single writer share
+
+
+//-------------------------------------------------------------------------------------
+/** This class drives a half bridge motor with ramped duty cycles. The overflow
+ *  interrupt of the bridge's timer must call tick(); since interrupt vectors can't be
+ *  template parameters, that one line is written out in motor_axes.cpp.
+ *
+ *  A motor is declared with one line, for example
+ *  \code
+ *  typedef ramped_bridge<half_bridge_motor<TCD0_ADDR, PORTD_ADDR, PORTB_ADDR, 2>,
+ *                        307, 41> front_bridge;
+ *  \endcode
+ *  @param bridge The half_bridge_motor type which runs the hardware
+ *  @param accel Most a duty cycle may change per ms, in the units of PWM_DUTY_FULL, or 0
+ *               for no limit
+ *  @param jerk Most a duty cycle's change per ms may change per ms, or 0 for no limit
+ */
+
+template <class bridge, uint16_t accel, uint16_t jerk>
+class ramped_bridge : public bridge
+{
+protected:
+	/// The duty cycles the ramps are heading for; the motor task writes them
+	static atomic_share<uint16_t> port_target;
+	static atomic_share<uint16_t> starboard_target;
+
+	/// The ramps, which only the overflow interrupt runs
+	static motion_profile port_ramp;
+	static motion_profile starboard_ramp;
+
+public:
+	/** This method sets up the bridge as half_bridge_motor does, then turns on the
+	 *  timer's overflow interrupt which runs the ramps.
+	 *  @param frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+	 */
+	static void init (uint32_t frequency_hz)
+	{
+		bridge::init (frequency_hz);
+
+		port_ramp.set_rate (frequency_hz);
+		starboard_ramp.set_rate (frequency_hz);
+		bridge::tc ().INTCTRLA = (bridge::tc ().INTCTRLA & ~TC_OVFINTLVL_gm)
+								 | TC_OVFINTLVL_LO_gc;
+	}
+
+	/** This method changes the PWM configuration as half_bridge_motor does. The ramps
+	 *  are stepped once per PWM period, so they're told the new rate.
+	 *  @param frequency_hz The PWM frequency, from PWM_MIN_HZ to PWM_MAX_HZ
+	 *  @param use_hires True to use the high resolution extension
+	 *  @param dead_ns The shortest on or off pulse the bridge gets, in ns
+	 *  @return True if the configuration was set
+	 */
+	static bool configure (uint32_t frequency_hz, bool use_hires, uint16_t dead_ns)
+	{
+		if (!bridge::configure (frequency_hz, use_hires, dead_ns))
+		{
+			return false;
+		}
+		port_ramp.set_rate (frequency_hz);
+		starboard_ramp.set_rate (frequency_hz);
+		return true;
+	}
+
+	/** This method sets the duty cycle toward which the port half bridge ramps.
+	 *  @param duty The duty cycle, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_port_duty (uint16_t duty)
+	{
+		port_target.put (duty);
+	}
+
+	/** This method sets the duty cycle toward which the starboard half bridge ramps.
+	 *  @param duty The duty cycle, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_starboard_duty (uint16_t duty)
+	{
+		starboard_target.put (duty);
+	}
+
+	/** This method sets the duty cycles toward which both half bridges ramp.
+	 *  @param port_duty The duty cycle for channel A, from 0 to PWM_DUTY_FULL
+	 *  @param starboard_duty The duty cycle for channel B, from 0 to PWM_DUTY_FULL
+	 */
+	static void set_duty (uint16_t port_duty, uint16_t starboard_duty)
+	{
+		port_target.put (port_duty);
+		starboard_target.put (starboard_duty);
+	}
+
+	/** This method moves both duty cycles one PWM period along their ramps. It's
+	 *  called by the timer's overflow interrupt, so the new values are picked up from
+	 *  the buffer registers at the very next overflow.
+	 */
+	static void tick (void)
+	{
+		bridge::set_duty (port_ramp.step (port_target.ISR_get ()),
+						  starboard_ramp.step (starboard_target.ISR_get ()));
+	}
+};
+
+
+// The static members of each ramped bridge
+template <class bridge, uint16_t accel, uint16_t jerk>
+atomic_share<uint16_t> ramped_bridge<bridge, accel, jerk>::port_target;
+
+template <class bridge, uint16_t accel, uint16_t jerk>
+atomic_share<uint16_t> ramped_bridge<bridge, accel, jerk>::starboard_target;
+
+template <class bridge, uint16_t accel, uint16_t jerk>
+motion_profile ramped_bridge<bridge, accel, jerk>::port_ramp (accel, jerk);
+
+template <class bridge, uint16_t accel, uint16_t jerk>
+motion_profile ramped_bridge<bridge, accel, jerk>::starboard_ramp (accel, jerk);
+
+#endif // _RAMPED_BRIDGE_H_
@@ -0,0 +1,205 @@
+//**************************************************************************************
+/** \file serial_rx.cpp
+ *    This file contains the interrupt driven receiver for USARTC0. The interrupt is
+ *    the only writer of the ring buffer's head and the reading task is the only
+ *    writer of its tail, so neither needs a lock.
+ *
+ *    This receiver takes the place of the receive side of the ME405 rs232 class on
+ *    USARTC0, whose receive interrupt must not be built in; rs232 is still used to
+ *    transmit. In the host build there is no receive interrupt, so the host serial
+ *    port is checked once a millisecond instead.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "hal.h"                            // Real or emulated register access
+#include "serial_rx.h"                      // Header for this file
+
+
+/// The ring buffer of received characters
+static volatile char buffer[SERIAL_RX_SIZE];
+
+/// Index at which the interrupt puts the next character
+static volatile uint8_t head = 0;
+
+/// Index from which the task takes the next character
+static volatile uint8_t tail = 0;
+
+/// How many characters have been thrown away because the buffer was full
+static volatile uint16_t overruns = 0;
+
+/// The task which is woken up when a character comes in
+static xTaskHandle reader_task = NULL;
+
+#ifdef HAL_HOST
+	/// On the host, characters come from the host serial port
+	static emstream* p_host_serial = NULL;
+#endif
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts a received character into the ring buffer, or counts it as an
+ *  overrun if the buffer is full.
+ *  @param ch The character which came in
+ *  @return True if the character was stored, false if it was lost
+ */
+
+static inline bool store (char ch)
+{
+	uint8_t next = (head + 1) & (SERIAL_RX_SIZE - 1);
+
+	if (next == tail)
+	{
+		overruns++;
+		return false;
+	}
+	buffer[head] = ch;
+	head = next;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets the receive complete interrupt of USARTC0 to low level, the
+ *  RTOS tick's, since it wakes the reading task and the AVR port doesn't let one
+ *  kernel call interrupt another. The rs232 object which sets up the USART must have
+ *  been made first.
+ *  @param p_ser The serial port; only the host build uses it, to read characters from
+ */
+
+void serial_rx_init (emstream* p_ser)
+{
+#ifdef HAL_HOST
+	p_host_serial = p_ser;
+#else
+	(void)p_ser;
+	USARTC0.CTRLA = (USARTC0.CTRLA & ~USART_RXCINTLVL_gm) | USART_RXCINTLVL_LO_gc;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function says which task is to be woken up when characters come in.
+ *  @param task The handle of the task which reads the characters
+ */
+
+void serial_rx_set_task (xTaskHandle task)
+{
+	reader_task = task;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function puts the calling task to sleep until there is a character in the
+ *  buffer, or until the timeout runs out, whichever comes first.
+ *  @param timeout The longest time to wait, in RTOS ticks
+ *  @return True if there's a character to read, false if the timeout ran out
+ */
+
+bool serial_rx_wait (portTickType timeout)
+{
+#ifdef HAL_HOST
+	for (portTickType waited = 0; !serial_rx_available (); waited++)
+	{
+		if (p_host_serial != NULL && p_host_serial->check_for_char ())
+		{
+			store (p_host_serial->getchar ());
+		}
+		else if (waited >= timeout)
+		{
+			return false;
+		}
+		else
+		{
+			vTaskDelay (1);
+		}
+	}
+	return true;
+#else
+	if (!serial_rx_available ())
+	{
+		ulTaskNotifyTake (pdTRUE, timeout);
+	}
+	return serial_rx_available ();
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function checks whether there are any characters in the buffer.
+ *  @return True if a character is waiting, false if the buffer is empty
+ */
+
+bool serial_rx_available (void)
+{
+	return (head != tail);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function takes the oldest character out of the buffer. It should only be
+ *  called when serial_rx_available() says there's a character to take.
+ *  @return The character, or zero if the buffer was empty
+ */
+
+char serial_rx_getchar (void)
+{
+	if (head == tail)
+	{
+		return '\0';
+	}
+
+	char ch = buffer[tail];
+	tail = (tail + 1) & (SERIAL_RX_SIZE - 1);
+	return ch;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns how many characters have been lost because they came in
+ *  while the buffer was full.
+ *  @return The number of lost characters
+ */
+
+uint16_t serial_rx_overruns (void)
+{
+	uint16_t count;
+
+	portENTER_CRITICAL ();
+	count = overruns;
+	portEXIT_CRITICAL ();
+
+	return count;
+}
+
+
+#ifndef HAL_HOST
+//-------------------------------------------------------------------------------------
+/** This interrupt runs when USARTC0 has received a character. It stores the character
+ *  and wakes up the reading task.
+ */
+
+ISR (USARTC0_RXC_vect)
+{
+	BaseType_t higher_priority_woken = pdFALSE;
+
+	store (USARTC0.DATA);
+
+	if (reader_task != NULL)
+	{
+		vTaskNotifyGiveFromISR (reader_task, &higher_priority_woken);
+	}
+
+	// If the port can switch tasks from an interrupt, the reader runs right away;
+	// otherwise it runs at the next tick
+	#ifdef portYIELD_FROM_ISR
+		portYIELD_FROM_ISR (higher_priority_woken);
+	#else
+		(void)higher_priority_woken;
+	#endif
+}
+#endif // HAL_HOST
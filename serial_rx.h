@@ -0,0 +1,46 @@
+//**************************************************************************************
+/** \file serial_rx.h
+ *    This file contains an interrupt driven receiver for the user interface's serial
+ *    port, USARTC0. Each received character is put into a ring buffer by the receive
+ *    complete interrupt, which also wakes up the task that reads them, so that task
+ *    can sleep until someone types something instead of checking every millisecond.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SERIAL_RX_H_
+#define _SERIAL_RX_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// Size of the receive ring buffer; it must be a power of two no bigger than 128
+#define SERIAL_RX_SIZE      64
+
+
+// This function turns on the receive interrupt; it's called from main()
+void serial_rx_init (emstream* p_ser);
+
+// This function says which task to wake up when characters come in
+void serial_rx_set_task (xTaskHandle task);
+
+// This function sleeps until a character has come in or the timeout runs out
+bool serial_rx_wait (portTickType timeout);
+
+// This function checks whether a character is waiting in the buffer
+bool serial_rx_available (void);
+
+// This function takes the oldest character out of the buffer
+char serial_rx_getchar (void);
+
+// This function returns how many characters were lost because the buffer was full
+uint16_t serial_rx_overruns (void);
+
+#endif // _SERIAL_RX_H_
@@ -0,0 +1,312 @@
+//**************************************************************************************
+/** \file serial_tx.cpp
+ *    This file contains the DMA driven transmitter for USARTC0. Writers put characters
+ *    into the ring buffer inside a short critical section. Whenever DMA is idle, the
+ *    oldest characters are copied into a small block which DMA channel 0 feeds to the
+ *    USART one byte per data register empty trigger; the channel's transaction
+ *    complete interrupt then takes the next block. Copying the block out of the ring
+ *    is what lets a full ring throw away its oldest characters without touching the
+ *    ones DMA is sending.
+ *
+ *    A binary frame, such as a telemetry frame, is sent from where it already is
+ *    instead: DMA is pointed at the frame rather than the block, so it isn't copied.
+ *    Frames and blocks of text take turns, so text still gets out while frames are
+ *    being sent as fast as the port can go. Only one frame can wait at a time; a
+ *    newer one takes its place.
+ *
+ *    The ME405 rs232 class still sets up the USART and its baud rate; after
+ *    serial_tx_init(), nothing else may write to USARTC0.DATA. In the host build there
+ *    is no DMA, so each block is written straight to the host serial port.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "hal.h"                            // Real or emulated register access
+#include "supervisor.h"                     // A task waiting to print isn't stuck
+#include "serial_tx.h"                      // Header for this file
+
+
+/// The ring buffer of characters waiting to be sent
+static uint8_t ring[SERIAL_TX_SIZE];
+
+/// Index at which writers put the next character
+static volatile uint16_t head = 0;
+
+/// Index of the oldest character which hasn't been given to DMA yet
+static volatile uint16_t tail = 0;
+
+/// The block which DMA is sending
+static uint8_t block[SERIAL_TX_BLOCK];
+
+/// Whether DMA is sending a block; if not, the next writer starts it
+static volatile bool sending = false;
+
+/// The frame waiting to be sent next and its length, or NULL if there isn't one
+static const uint8_t* volatile frame_waiting = NULL;
+static uint8_t frame_length = 0;
+
+/// The frame which DMA is sending, or NULL if it's sending text or nothing
+static const uint8_t* volatile frame_sending = NULL;
+
+// Counts of what's happened to the characters written
+static uint32_t queued = 0;                 ///< Characters put into the ring buffer
+static uint32_t dropped = 0;                ///< Characters thrown away when it was full
+static uint16_t peak = 0;                   ///< Most characters ever waiting at once
+
+#ifdef HAL_HOST
+	/// On the host, characters go straight to the host serial port
+	static emstream* p_host_serial = NULL;
+#endif
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns how many characters are waiting in the ring buffer.
+ *  @return The number of characters between the tail and the head
+ */
+
+static inline uint16_t held (void)
+{
+	return (head - tail) & (SERIAL_TX_SIZE - 1);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function has DMA send the waiting frame, or else copies the oldest characters
+ *  in the ring buffer into the block and has DMA send them. If there's nothing to
+ *  send, DMA is left idle. It must be called with interrupts off, from a critical
+ *  section or from the DMA interrupt.
+ */
+
+static void start_block (void)
+{
+	const uint8_t* p_source = block;
+	uint8_t count = 0;
+
+	// A frame goes next unless the last thing sent was a frame and text is waiting
+	if (frame_waiting != NULL && (frame_sending == NULL || tail == head))
+	{
+		p_source = frame_waiting;
+		count = frame_length;
+		frame_waiting = NULL;
+	}
+	else
+	{
+		while (tail != head && count < SERIAL_TX_BLOCK)
+		{
+			block[count++] = ring[tail];
+			tail = (tail + 1) & (SERIAL_TX_SIZE - 1);
+		}
+	}
+	frame_sending = (p_source != block) ? p_source : NULL;
+
+#ifdef HAL_HOST
+	// There's no DMA on the host, so the block is sent now and DMA never gets busy
+	for (uint8_t index = 0; p_host_serial != NULL && index < count; index++)
+	{
+		p_host_serial->putchar (p_source[index]);
+	}
+	frame_sending = NULL;
+	sending = false;
+	if (frame_waiting != NULL || tail != head)
+	{
+		start_block ();
+	}
+#else
+	sending = (count > 0);
+	if (sending)
+	{
+		DMA.CH0.SRCADDR0 = (uint8_t)(uintptr_t)p_source;
+		DMA.CH0.SRCADDR1 = (uint8_t)((uintptr_t)p_source >> 8);
+		DMA.CH0.TRFCNT = count;
+		DMA.CH0.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+	}
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets up DMA channel 0 to copy blocks and frames to USARTC0's data
+ *  register, one byte each time the data register is empty. The rs232 object which
+ *  sets up the USART must have been made first.
+ *  @param p_ser The serial port; only the host build uses it, to write characters to
+ */
+
+void serial_tx_init (emstream* p_ser)
+{
+#ifdef HAL_HOST
+	p_host_serial = p_ser;
+#else
+	(void)p_ser;
+
+	DMA.CTRL |= DMA_ENABLE_bm;
+	DMA.CH0.ADDRCTRL = DMA_CH_SRCRELOAD_TRANSACTION_gc | DMA_CH_SRCDIR_INC_gc
+					   | DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc;
+	DMA.CH0.TRIGSRC = DMA_CH_TRIGSRC_USARTC0_DRE_gc;
+	DMA.CH0.SRCADDR2 = 0;
+	DMA.CH0.DESTADDR0 = (uint8_t)(uintptr_t)&USARTC0.DATA;
+	DMA.CH0.DESTADDR1 = (uint8_t)((uintptr_t)&USARTC0.DATA >> 8);
+	DMA.CH0.DESTADDR2 = 0;
+	DMA.CH0.CTRLB = DMA_CH_TRNINTLVL_LO_gc;
+#endif
+
+	// Anything printed before now is sent
+	portENTER_CRITICAL ();
+	if (!sending)
+	{
+		start_block ();
+	}
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes a stream which prints into the ring buffer.
+ *  @param a_policy What to do when the buffer is full, one of the serial_tx_policy
+ *                  values
+ */
+
+serial_tx::serial_tx (uint8_t a_policy)
+	: emstream (), policy (a_policy)
+{
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method puts one character into the ring buffer and starts DMA if it's idle.
+ *  If the buffer is full, the stream's policy says whether the character is thrown
+ *  away, the oldest waiting character is thrown away instead, or the task sleeps
+ *  until DMA has made room.
+ *  @param chout The character to be sent
+ *  @return True if the character was put into the buffer, false if it was thrown away
+ */
+
+bool serial_tx::putchar (char chout)
+{
+	bool stored = true;
+
+	portENTER_CRITICAL ();
+	while (policy == SERIAL_TX_WAIT && held () == SERIAL_TX_SIZE - 1)
+	{
+		portEXIT_CRITICAL ();
+		supervisor_alive ();
+		vTaskDelay (1);
+		portENTER_CRITICAL ();
+	}
+
+	if (held () == SERIAL_TX_SIZE - 1)
+	{
+		if (policy == SERIAL_TX_DROP_OLDEST)
+		{
+			tail = (tail + 1) & (SERIAL_TX_SIZE - 1);
+		}
+		else
+		{
+			stored = false;
+		}
+		dropped++;
+	}
+
+	if (stored)
+	{
+		ring[head] = (uint8_t)chout;
+		head = (head + 1) & (SERIAL_TX_SIZE - 1);
+		queued++;
+		if (held () > peak)
+		{
+			peak = held ();
+		}
+		if (!sending)
+		{
+			start_block ();
+		}
+	}
+	portEXIT_CRITICAL ();
+
+	return stored;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function hands DMA a frame to send as it is, without copying it. The frame
+ *  mustn't be changed until serial_tx_frame_sending() no longer returns it, unless a
+ *  newer frame has taken its place first. It must be called with interrupts off,
+ *  from a critical section or from a high level interrupt; the other callers of
+ *  start_block(), the DMA interrupt among them, turn interrupts off around it, so a
+ *  high level interrupt can't break in while a block is being started.
+ *  @param p_frame The frame's bytes
+ *  @param length How many bytes there are in the frame
+ *  @return True if the frame took the place of one which hadn't been sent yet
+ */
+
+bool serial_tx_frame (const uint8_t* p_frame, uint8_t length)
+{
+	bool replaced = (frame_waiting != NULL);
+
+	frame_waiting = p_frame;
+	frame_length = length;
+	if (!sending)
+	{
+		start_block ();
+	}
+	return replaced;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function says which frame DMA is sending.
+ *  @return The frame being sent, or NULL if DMA is sending text or nothing
+ */
+
+const uint8_t* serial_tx_frame_sending (void)
+{
+	return frame_sending;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints how many characters have been put into the ring buffer and
+ *  thrown away, how many are waiting now and the most that have ever been waiting.
+ *  @param p_ser The serial device on which to print
+ */
+
+void serial_tx_print (emstream* p_ser)
+{
+	portENTER_CRITICAL ();
+	uint32_t queued_now = queued;
+	uint32_t dropped_now = dropped;
+	uint16_t held_now = held ();
+	uint16_t peak_now = peak;
+	portEXIT_CRITICAL ();
+
+	*p_ser << PMS ("tx queued ") << queued_now
+		   << PMS (" dropped ") << dropped_now
+		   << PMS (" waiting ") << held_now
+		   << PMS (" peak ") << peak_now
+		   << PMS (" of ") << (uint16_t)(SERIAL_TX_SIZE - 1) << endl;
+}
+
+
+#ifndef HAL_HOST
+//-------------------------------------------------------------------------------------
+/** This interrupt runs when DMA has sent a block. It clears the channel's flags and
+ *  starts the next block, if there is one. It runs at low level, so interrupts are
+ *  turned off while it starts the block, or else the telemetry interrupt could hand
+ *  over a frame halfway through and the frame would be lost or sent twice.
+ */
+
+ISR (DMA_CH0_vect)
+{
+	DMA.CH0.CTRLB |= DMA_CH_TRNIF_bm | DMA_CH_ERRIF_bm;
+
+	portENTER_CRITICAL ();
+	start_block ();
+	portEXIT_CRITICAL ();
+}
+#endif // HAL_HOST
@@ -0,0 +1,75 @@
+//**************************************************************************************
+/** \file serial_tx.h
+ *    This file contains the transmitter for the robot's serial port, USARTC0. Text
+ *    written to a serial_tx stream goes into a ring buffer and the writer carries on
+ *    right away; DMA channel 0 sends the buffer to the USART in the background, a
+ *    block at a time, so printing a status line no longer holds up the task doing it.
+ *
+ *    Every serial_tx stream shares the one ring buffer. What happens when it's full
+ *    is up to each stream, so a task which must never wait can throw text away while
+ *    the user interface waits to print a whole report.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SERIAL_TX_H_
+#define _SERIAL_TX_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// Size of the transmit ring buffer; it must be a power of two
+#define SERIAL_TX_SIZE      512
+
+/// The most bytes DMA sends in one transfer; after each one, an interrupt starts the next
+#define SERIAL_TX_BLOCK     32
+
+
+/// What a stream does with a character when the ring buffer is full
+enum serial_tx_policy
+{
+	SERIAL_TX_NONBLOCKING,                  ///< The new character is thrown away
+	SERIAL_TX_DROP_OLDEST,                  ///< The oldest waiting character is thrown away
+	SERIAL_TX_WAIT                          ///< The task sleeps a tick at a time for room
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class is a serial port to which any number of tasks can print. It only puts
+ *  characters into the ring buffer; serial_tx_init() must have been called for them
+ *  to be sent. The SERIAL_TX_WAIT policy sleeps, so only tasks may use it.
+ */
+
+class serial_tx : public emstream
+{
+protected:
+	/// What to do with a character when the ring buffer is full, from serial_tx_policy
+	uint8_t policy;
+
+public:
+	// The constructor makes a stream with the given policy for a full buffer
+	serial_tx (uint8_t a_policy);
+
+	// This method puts one character into the ring buffer
+	bool putchar (char chout);
+};
+
+
+// This function sets up the DMA channel which sends the ring buffer to USARTC0
+void serial_tx_init (emstream* p_ser);
+
+// This function has DMA send a frame of bytes from where it is, between blocks of text
+bool serial_tx_frame (const uint8_t* p_frame, uint8_t length);
+
+// This function returns the frame which DMA is sending, if it's sending one
+const uint8_t* serial_tx_frame_sending (void);
+
+// This function prints how much has been sent and thrown away, and the peak fill level
+void serial_tx_print (emstream* p_ser);
+
+#endif // _SERIAL_TX_H_
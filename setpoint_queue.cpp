@@ -0,0 +1,181 @@
+//**************************************************************************************
+/** \file setpoint_queue.cpp
+ *    This file contains the queue of setpoints between the user interface and a
+ *    motor task. The writer fills a slot and only then moves the head, so the reader
+ *    never sees a setpoint which is half written; the reader copies a slot out before
+ *    it moves the tail, so the writer never fills a slot which is still being read.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include "atomic_share.h"                   // The compiler barrier
+#include "setpoint_queue.h"                 // Header for this file
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor makes an empty queue with all its counts at zero.
+ */
+
+setpoint_queue::setpoint_queue (void)
+	: head (0), tail (0), replace_mark (0), replacements (0), replacements_seen (0),
+	  queued (0), refused (0), peak (0), late (0), worst_late (0), dropped (0)
+{
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method adds a setpoint at the end of the queue. It leaves the last slot free,
+ *  so that a replacing setpoint such as a stop always fits, however many timed ones
+ *  are waiting. Only one task or interrupt at a time may call it.
+ *  @param a_setpoint The setpoint
+ *  @return True if it was added, false if the queue was full
+ */
+
+bool setpoint_queue::put (const setpoint& a_setpoint)
+{
+	uint8_t held = (uint8_t)(head - tail);
+	if (held >= SETPOINT_QUEUE_SIZE - 1)
+	{
+		refused++;
+		return false;
+	}
+
+	entries[head & (SETPOINT_QUEUE_SIZE - 1)] = a_setpoint;
+	ATOMIC_SHARE_BARRIER ();
+	head = head + 1;
+
+	queued++;
+	if (held + 1 > peak)
+	{
+		peak = held + 1;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method adds a setpoint which is to be carried out in place of every one still
+ *  waiting, such as a steering command from a key. The reader can't be stopped from
+ *  taking one of the old ones first, so the new one is added as usual and the place
+ *  where it was put is marked; the mark is written before the head is moved, and the
+ *  count of replacements after the mark, so the reader never sees a count without
+ *  its mark. Only one task or interrupt at a time may call it.
+ *  @param a_setpoint The setpoint
+ *  @return True if it was added, false if the queue was full
+ */
+
+bool setpoint_queue::replace (const setpoint& a_setpoint)
+{
+	uint8_t mark = head;
+
+	if ((uint8_t)(mark - tail) >= SETPOINT_QUEUE_SIZE)
+	{
+		refused++;
+		return false;
+	}
+
+	entries[mark & (SETPOINT_QUEUE_SIZE - 1)] = a_setpoint;
+	replace_mark = mark;
+	ATOMIC_SHARE_BARRIER ();
+	replacements = replacements + 1;
+	ATOMIC_SHARE_BARRIER ();
+	head = mark + 1;
+
+	queued++;
+	if (peak == 0)
+	{
+		peak = 1;
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method moves the tail up to the latest replacing setpoint, if one has been
+ *  put in since the reader last looked. The mark is never behind the tail unless the
+ *  reader has already gone past it, in which case nothing is skipped.
+ */
+
+void setpoint_queue::skip_replaced (void)
+{
+	uint8_t count = replacements;
+	if (count == replacements_seen)
+	{
+		return;
+	}
+	replacements_seen = count;
+	ATOMIC_SHARE_BARRIER ();
+
+	uint8_t mark = replace_mark;
+	uint8_t skipped = (uint8_t)(mark - tail);
+	if (skipped != 0 && skipped <= (uint8_t)(head - tail))
+	{
+		dropped += skipped;
+		ATOMIC_SHARE_BARRIER ();
+		tail = mark;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method copies the setpoint at the front of the queue without taking it out.
+ *  Only the reader calls it. Setpoints which a later replacing one has put out of
+ *  date are skipped first.
+ *  @param a_setpoint Where to put the copy
+ *  @return True if there was a setpoint, false if the queue is empty
+ */
+
+bool setpoint_queue::peek (setpoint& a_setpoint)
+{
+	skip_replaced ();
+	if (head == tail)
+	{
+		return false;
+	}
+	ATOMIC_SHARE_BARRIER ();
+	a_setpoint = entries[tail & (SETPOINT_QUEUE_SIZE - 1)];
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method takes the setpoint at the front of the queue out, once the reader has
+ *  copied it with peek().
+ *  @param lateness How many ticks after its start time the setpoint was taken
+ */
+
+void setpoint_queue::take (portTickType lateness)
+{
+	ATOMIC_SHARE_BARRIER ();
+	tail = tail + 1;
+
+	if (lateness > SETPOINT_LATE_TICKS)
+	{
+		late++;
+		if (lateness > worst_late)
+		{
+			worst_late = lateness;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method prints how many setpoints were queued, refused, taken late and
+ *  skipped because a later one replaced them, the latest any was taken, and how many
+ *  are waiting now and have ever waited at once.
+ *  @param p_ser The serial device on which to print
+ */
+
+void setpoint_queue::print (emstream* p_ser)
+{
+	*p_ser << PMS ("queued ") << queued
+		   << PMS (" refused ") << refused
+		   << PMS (" late ") << late
+		   << PMS (" dropped ") << dropped
+		   << PMS (" worst_ms ") << (uint32_t)(worst_late * portTICK_RATE_MS)
+		   << PMS (" waiting ") << waiting ()
+		   << PMS (" peak ") << peak << endl;
+}
@@ -0,0 +1,138 @@
+//**************************************************************************************
+/** \file setpoint_queue.h
+ *    This file contains a queue of setpoints for one motor. A steering share only
+ *    holds the latest command, so when two keys come in during one motor task pass,
+ *    the motor never sees the first one. Each setpoint in the queue instead waits its
+ *    turn: the motor task takes them in order, each at the time it's meant to start,
+ *    and keeps count of those it took late. A setpoint can also say what duty cycle
+ *    to use and how long to last, after which the motor stops.
+ *
+ *    A command which is to be carried out right away replaces whatever is still
+ *    waiting, so a stop doesn't wait behind a setpoint which starts later.
+ *
+ *    There's one writer, the user interface or, while a shot plays, the sequencer's
+ *    interrupt, and one reader, the motor task. Each end only moves its own index,
+ *    and an index is one byte, so neither end needs a lock. A writer which replaces
+ *    the waiting setpoints only marks where the new one is; the reader moves its tail
+ *    up to the mark the next time it looks.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SETPOINT_QUEUE_H_
+#define _SETPOINT_QUEUE_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// How many setpoints a queue holds; it must be a power of two
+#define SETPOINT_QUEUE_SIZE     8
+
+/// A setpoint taken more than this many ticks after its start time counts as late
+#define SETPOINT_LATE_TICKS     1
+
+
+/// One setpoint for a motor
+struct setpoint
+{
+	portTickType start;                     ///< RTOS tick at which it takes effect
+	uint16_t duration;                      ///< Ticks after the start at which the motor
+											///< stops, or 0 to run until the next one
+	uint16_t level;                         ///< Duty cycle, from 0 to PWM_DUTY_FULL, or
+											///< for a motor with a speed controller, the
+											///< speed, up to the axis's limit; 0 means
+											///< the axis's own
+	uint8_t command;                        ///< Steering command (0 = stop, 1 = port,
+											///< 2 = starboard)
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This class is a queue of setpoints with one writer and one reader, neither of
+ *  which ever waits. A writer which finds the queue full has its setpoint refused;
+ *  the last slot is kept for a setpoint which replaces the others.
+ */
+
+class setpoint_queue
+{
+protected:
+	/// The setpoints; the writer fills them at the head and the reader takes them at
+	/// the tail
+	setpoint entries[SETPOINT_QUEUE_SIZE];
+
+	/// Count of setpoints put in; only the writer changes it
+	volatile uint8_t head;
+
+	/// Count of setpoints taken out; only the reader changes it
+	volatile uint8_t tail;
+
+	/// Where the latest setpoint which replaces the others was put; the reader skips
+	/// everything before it
+	volatile uint8_t replace_mark;
+
+	/// Count of replacing setpoints put in; only the writer changes it
+	volatile uint8_t replacements;
+
+	/// Count of replacements the reader has carried out
+	uint8_t replacements_seen;
+
+	// Counts kept by the writer
+	uint16_t queued;                        ///< Setpoints put into the queue
+	uint16_t refused;                       ///< Setpoints refused because it was full
+	uint8_t peak;                           ///< Most setpoints ever waiting at once
+
+	// Counts kept by the reader
+	uint16_t late;                          ///< Setpoints taken after their time
+	portTickType worst_late;                ///< Most ticks a setpoint was taken late
+	uint16_t dropped;                       ///< Setpoints skipped as they were replaced
+
+	// This method skips the setpoints which a replacing one has put out of date
+	void skip_replaced (void);
+
+public:
+	// This constructor makes an empty queue
+	setpoint_queue (void);
+
+	// This method adds a setpoint at the end of the queue; only the writer calls it
+	bool put (const setpoint& a_setpoint);
+
+	// This method adds a setpoint which replaces every one still waiting
+	bool replace (const setpoint& a_setpoint);
+
+	// This method copies the setpoint at the front of the queue, if there is one
+	bool peek (setpoint& a_setpoint);
+
+	// This method takes the front setpoint out, noting how late it was taken
+	void take (portTickType lateness);
+
+	/** This method returns how many setpoints are waiting.
+	 *  @return The number of setpoints in the queue
+	 */
+	uint8_t waiting (void)
+	{
+		return (uint8_t)(head - tail);
+	}
+
+	// This method prints the queue's counts
+	void print (emstream* p_ser);
+};
+
+
+/** This function says whether a tick count has been reached, allowing for the tick
+ *  count wrapping around.
+ *  @param now The tick count now
+ *  @param time The tick count to be reached
+ *  @return True if time is now or in the past
+ */
+inline bool setpoint_reached (portTickType now, portTickType time)
+{
+	return (portTickType)(now - time) <= (portTickType)(portMAX_DELAY >> 1);
+}
+
+#endif // _SETPOINT_QUEUE_H_
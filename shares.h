@@ -38,12 +38,58 @@
 
 /**
  * \var print_ser_queue
- * \brief This queue allows tasks to send characters to the user interface task for display.
+ * \brief Any task can print here without waiting; when the serial transmit buffer is
+ *        full, the oldest characters waiting in it are thrown away.
  */
-extern frt_text_queue print_ser_queue;			// This queue allows tasks to send characters to the user interface task for display.
+extern serial_tx print_ser_queue;
 
-extern shared_data<uint8_t> steer_front;
-extern shared_data<uint8_t> steer_back;
+/**
+ * \var steer_front
+ * \brief Steering command the front motor is carrying out now; only the motor task
+ *        writes it, as it takes each setpoint or one runs out.
+ */
+extern atomic_share<uint8_t> steer_front;
+
+/**
+ * \var steer_back
+ * \brief Steering command the back motor is carrying out now.
+ */
+extern atomic_share<uint8_t> steer_back;
+
+/**
+ * \var setpoints_front
+ * \brief Queue of setpoints for the front motor, which its task takes in order; the
+ *        user interface, or the shot sequencer while a shot plays, puts them in.
+ */
+extern setpoint_queue setpoints_front;
+
+/**
+ * \var setpoints_back
+ * \brief Queue of setpoints for the back motor.
+ */
+extern setpoint_queue setpoints_back;
+
+/**
+ * \var motor_task
+ * \brief Handle of the task which runs the motors, which is notified of each new
+ *        setpoint for any of them.
+ */
+extern xTaskHandle motor_task;
+
+
+/** This function says whether a steering command which is to be carried out right
+ *  away would change anything: the motor is doing something else, or there are
+ *  setpoints waiting which the command would replace.
+ *  @param share The share which shows what the motor is doing
+ *  @param queue The motor's setpoint queue
+ *  @param command The steering command
+ *  @return True if the command should be sent
+ */
+inline bool steer_changes (atomic_share<uint8_t>& share, setpoint_queue& queue,
+						   uint8_t command)
+{
+	return share.get () != command || queue.waiting () != 0;
+}
 
 
 #endif // _SHARES_H_
@@ -0,0 +1,367 @@
+//**************************************************************************************
+/** \file shot_script.cpp
+ *    This file contains the shot sequencer. Timer E1 counts at F_CPU / 64 and is set
+ *    up for one period at a time, from one step to the next; its overflow interrupt
+ *    puts the step's commands into the steering shares and wakes up the motor task,
+ *    just as the user interface does when a key is pressed. A gap which is longer
+ *    than the timer can count is split into periods of 100 ms.
+ *
+ *    The interrupt is at low level, the RTOS tick's, because it calls the kernel and
+ *    the AVR port doesn't let one kernel call interrupt another. The control loops can
+ *    hold it up by their run time; each step's timing shows by how much.
+ *
+ *    The timer only runs while a script is playing. In the host build there are no
+ *    timer interrupts, so scripts can be loaded and printed but don't play.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "hal.h"                            // Real or emulated register access
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
+#include "shares.h"                         // Steering shares and motor task handles
+#include "trace.h"                          // Time stamped event trace
+#include "motor_sync.h"                     // Both motors' PWM changing together
+#include "shot_script.h"                    // Header for this file
+
+
+/// Timer counts in one SHOT_TICK_US, with the timer running at F_CPU / 64
+#define SHOT_COUNTS_PER_TICK    (F_CPU / 64 / (1000000UL / SHOT_TICK_US))
+
+/// The longest timer period used; longer gaps are made of several of these
+#define SHOT_CHUNK_COUNTS       (1000UL * SHOT_COUNTS_PER_TICK)
+
+static_assert (SHOT_CHUNK_COUNTS <= 65536UL, "shot timer period doesn't fit in PER");
+
+
+/// Timing of one step, measured each time the script is played
+struct shot_timing
+{
+	uint32_t last_us;                       ///< When it happened in the last shot
+	uint32_t min_us;                        ///< Earliest it has happened
+	uint32_t max_us;                        ///< Latest it has happened
+};
+
+/// The script
+static shot_step steps[SHOT_SCRIPT_STEPS];
+
+/// How many steps are in the script
+static uint8_t step_count = 0;
+
+/// How the steps have kept to their times since the script was last changed
+static shot_timing timings[SHOT_SCRIPT_STEPS];
+
+/// How many times the script has been played to the end since it was last changed
+static uint16_t shots = 0;
+
+/// The step which is to happen next
+static volatile uint8_t next_step = 0;
+
+/// Whether the script is playing
+static volatile bool running = false;
+
+/// Timer counts still to go before the next step, beyond the current period
+static uint32_t counts_left = 0;
+
+/// Cycle count at which the script started playing
+static uint32_t start_cycles = 0;
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets the timer's period to the next part of the gap before the next
+ *  step: all that's left of it, or SHOT_CHUNK_COUNTS if more than that is left.
+ */
+
+static void load_period (void)
+{
+	uint16_t chunk = (counts_left > SHOT_CHUNK_COUNTS) ? SHOT_CHUNK_COUNTS
+													   : (uint16_t)counts_left;
+	counts_left -= chunk;
+	TCE1.PER = chunk - 1;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets the timer to overflow after the given number of counts.
+ *  @param counts Timer counts from now to the next step; at least 2 are used
+ */
+
+static void arm (uint32_t counts)
+{
+	counts_left = (counts < 2) ? 2 : counts;
+	load_period ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets up timer E1 for the sequencer, with its clock stopped. Its
+ *  interrupt is at low level so that it can't break into the RTOS tick.
+ */
+
+void shot_script_init (void)
+{
+	TCE1.CTRLA = TC_CLKSEL_OFF_gc;
+	TCE1.CTRLB = TC_WGMODE_NORMAL_gc;
+	TCE1.INTCTRLA = TC_OVFINTLVL_LO_gc;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function throws the timings away, since they belong to the old script.
+ */
+
+static void clear_timings (void)
+{
+	for (uint8_t index = 0; index < SHOT_SCRIPT_STEPS; index++)
+	{
+		timings[index].last_us = 0;
+		timings[index].min_us = 0xFFFFFFFFUL;
+		timings[index].max_us = 0;
+	}
+	shots = 0;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function throws away all the steps of the script.
+ *  @return True if the script was cleared, false if it's playing and can't be changed
+ */
+
+bool shot_script_clear (void)
+{
+	if (running)
+	{
+		return false;
+	}
+	step_count = 0;
+	clear_timings ();
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function adds a step to the end of the script. Steps must be added in order
+ *  of time; steps with the same time happen together.
+ *  @param offset Time of the step from the start of the shot, in SHOT_TICK_US units
+ *  @param front Front motor command (0 = stop, 1 = port, 2 = starboard)
+ *  @param back Back motor command (0 = stop, 1 = port, 2 = starboard)
+ *  @return True if the step was added, false if the script is playing or full, the
+ *          step is earlier than the one before it or a command isn't 0, 1 or 2
+ */
+
+bool shot_script_add (uint16_t offset, uint8_t front, uint8_t back)
+{
+	if (running || step_count >= SHOT_SCRIPT_STEPS || front > 2 || back > 2
+		|| (step_count > 0 && offset < steps[step_count - 1].offset))
+	{
+		return false;
+	}
+
+	steps[step_count].offset = offset;
+	steps[step_count].front = front;
+	steps[step_count].back = back;
+	step_count++;
+	clear_timings ();
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function starts playing the script. The first step happens after its offset,
+ *  counted from now.
+ *  @return True if the script started, false if it's empty or already playing
+ */
+
+bool shot_script_run (void)
+{
+	if (running || step_count == 0)
+	{
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	next_step = 0;
+	running = true;
+	TCE1.CTRLA = TC_CLKSEL_OFF_gc;
+	TCE1.CNT = 0;
+	TCE1.INTFLAGS = TC1_OVFIF_bm;
+	arm ((uint32_t)steps[0].offset * SHOT_COUNTS_PER_TICK);
+	start_cycles = cycle_counter_now ();
+	TCE1.CTRLA = TC_CLKSEL_DIV64_gc;
+	portEXIT_CRITICAL ();
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function stops a script partway through. The motors are left with whatever
+ *  commands the last step gave them; the caller should stop them.
+ */
+
+void shot_script_stop (void)
+{
+	portENTER_CRITICAL ();
+	TCE1.CTRLA = TC_CLKSEL_OFF_gc;
+	TCE1.INTFLAGS = TC1_OVFIF_bm;
+	running = false;
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function says whether a script is playing, in which case nothing else should
+ *  write the steering shares.
+ *  @return True if a script is playing
+ */
+
+bool shot_script_running (void)
+{
+	return running;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the steps of the script and, for each step, when it happened
+ *  in the last shot and the earliest and latest it has happened, in microseconds from
+ *  the start. The difference of those two is the spread from shot to shot.
+ *  @param p_ser The serial device on which to print
+ */
+
+void shot_script_print (emstream* p_ser)
+{
+	*p_ser << PMS ("shots ") << shots;
+	if (running)
+	{
+		*p_ser << PMS (" playing");
+	}
+	*p_ser << endl;
+	*p_ser << PMS ("step  at_us  front  back  last_us  min_us  max_us  spread") << endl;
+	for (uint8_t index = 0; index < step_count; index++)
+	{
+		*p_ser << index << PMS ("  ") << (uint32_t)steps[index].offset * SHOT_TICK_US
+			   << PMS ("  ") << steps[index].front << PMS ("  ") << steps[index].back;
+		if (shots > 0)
+		{
+			*p_ser << PMS ("  ") << timings[index].last_us
+				   << PMS ("  ") << timings[index].min_us
+				   << PMS ("  ") << timings[index].max_us
+				   << PMS ("  ") << timings[index].max_us - timings[index].min_us;
+		}
+		*p_ser << endl;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function queues a step's command for a motor in place of any setpoints still
+ *  waiting, and wakes the motor task, if the command changes anything, as
+ *  task_user::steer() does for a key. The setpoint starts now.
+ *  @param share The share which shows what the motor is doing
+ *  @param queue The motor's setpoint queue
+ *  @param motor Handle of the motor task to wake up, or NULL if it isn't running yet
+ *  @param source Which motor this is, as it should appear in the trace
+ *  @param command The new steering command
+ *  @param p_woken Set if waking the motor task means it should run right away
+ */
+
+static void steer_from_isr (atomic_share<uint8_t>& share, setpoint_queue& queue,
+							xTaskHandle motor, uint8_t source, uint8_t command,
+							BaseType_t* p_woken)
+{
+	setpoint next = { xTaskGetTickCountFromISR (), 0, 0, command };
+
+	if (steer_changes (share, queue, command) && queue.replace (next))
+	{
+		trace (TRACE_SHARE, source, command);
+		if (motor != NULL)
+		{
+			vTaskNotifyGiveFromISR (motor, p_woken);
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This interrupt runs at the end of each timer period. If the gap to the next step
+ *  isn't over yet, the next part of it is started; otherwise the step, and any steps
+ *  at the same time, are carried out and the timer is set for the step after them.
+ */
+
+ISR (TCE1_OVF_vect)
+{
+	BaseType_t higher_priority_woken = pdFALSE;
+
+	if (!running)
+	{
+		return;
+	}
+	if (counts_left > 0)
+	{
+		load_period ();
+		return;
+	}
+
+	uint32_t now_us = (cycle_counter_now () - start_cycles) / (CYCLES_PER_MS / 1000UL);
+	uint8_t step = next_step;
+	do
+	{
+		// If both motors change, their PWM changes at the same timer overflow
+		uint8_t motors = 0;
+		if (steer_changes (steer_front, setpoints_front, steps[step].front))
+		{
+			motors |= MOTOR_SYNC_FRONT;
+		}
+		if (steer_changes (steer_back, setpoints_back, steps[step].back))
+		{
+			motors |= MOTOR_SYNC_BACK;
+		}
+		motor_sync_begin (motors);
+
+		steer_from_isr (steer_front, setpoints_front, motor_task, TRACE_FRONT,
+						steps[step].front, &higher_priority_woken);
+		steer_from_isr (steer_back, setpoints_back, motor_task, TRACE_BACK,
+						steps[step].back, &higher_priority_woken);
+
+		shot_timing* p_timing = &timings[step];
+		p_timing->last_us = now_us;
+		if (now_us < p_timing->min_us)
+		{
+			p_timing->min_us = now_us;
+		}
+		if (now_us > p_timing->max_us)
+		{
+			p_timing->max_us = now_us;
+		}
+		step++;
+	}
+	while (step < step_count && steps[step].offset == steps[step - 1].offset);
+	next_step = step;
+
+	if (step >= step_count)
+	{
+		TCE1.CTRLA = TC_CLKSEL_OFF_gc;
+		running = false;
+		shots++;
+	}
+	else
+	{
+		arm ((uint32_t)(steps[step].offset - steps[step - 1].offset)
+			 * SHOT_COUNTS_PER_TICK);
+	}
+
+	#ifdef portYIELD_FROM_ISR
+		portYIELD_FROM_ISR (higher_priority_woken);
+	#else
+		(void)higher_priority_woken;
+	#endif
+}
@@ -0,0 +1,63 @@
+//**************************************************************************************
+/** \file shot_script.h
+ *    This file contains the shot sequencer, which plays back a list of steering
+ *    commands for both motors at set times after the start of a shot. The steps are
+ *    timed by timer E1 rather than by how fast someone types, so the same script gives
+ *    the same shot every time, and the time at which each step really happened is
+ *    recorded so that the spread from shot to shot can be measured.
+ *
+ *    While a script is running, the sequencer's interrupt is the writer of the
+ *    steering shares and the user interface leaves them alone.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SHOT_SCRIPT_H_
+#define _SHOT_SCRIPT_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The most steps a script can have
+#define SHOT_SCRIPT_STEPS       16
+
+/// The unit of a step's time offset, in microseconds; offsets go up to 6.5 seconds
+#define SHOT_TICK_US            100
+
+
+/// One step of a shot script
+struct shot_step
+{
+	uint16_t offset;                        ///< Time from the start, in SHOT_TICK_US units
+	uint8_t front;                          ///< Front motor command (0, 1 or 2)
+	uint8_t back;                           ///< Back motor command (0, 1 or 2)
+};
+
+
+// This function sets up the timer which runs the script; it's called from main()
+void shot_script_init (void);
+
+// This function throws away the script's steps
+bool shot_script_clear (void);
+
+// This function adds a step to the end of the script
+bool shot_script_add (uint16_t offset, uint8_t front, uint8_t back);
+
+// This function starts playing the script
+bool shot_script_run (void);
+
+// This function stops a script which is playing
+void shot_script_stop (void);
+
+// This function says whether a script is playing
+bool shot_script_running (void);
+
+// This function prints the script and how closely the steps kept to their times
+void shot_script_print (emstream* p_ser);
+
+#endif // _SHOT_SCRIPT_H_
@@ -0,0 +1,186 @@
+//**************************************************************************************
+/** \file speed_control.cpp
+ *    This file contains the encoder counter and the back motor's speed controller,
+ *    which the control loop executor runs 1000 times a second. Once
+ *    speed_control_init() has been called, the controller owns the back motor's
+ *    compare registers; the back motor task only puts setpoints into speed_back.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <stdlib.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "cycle_counter.h"                  // Clock rate, for the interrupt period
+#include "motor_axes.h"                     // Which timer and pins run the back motor
+#include "motion_profile.h"                 // S-curve ramps
+#include "control_loop.h"                   // Runs the controller at a fixed rate
+#include "motor_sync.h"                     // Both motors' PWM changing together
+#include "current_sense.h"                  // Whether the motor has been cut off
+#include "params.h"                         // The PWM frequency and gains at start
+#include "speed_control.h"                  // Header for this file
+
+
+/// What the controller's output is multiplied by to make a duty cycle in the bridge's
+/// units, in Q8
+#define SPEED_DUTY_SCALE        ((PWM_DUTY_FULL * 256L + SPEED_OUTPUT_MAX / 2)      \
+								 / SPEED_OUTPUT_MAX)
+
+
+/// The back motor's speed setpoint in encoder counts per ms
+atomic_share<int16_t> speed_back;
+
+/// The speed measured by the interrupt, for anyone who wants to look at it
+static atomic_share<int16_t> measured_speed;
+
+/// The duty cycle the controller put out most recently
+static atomic_share<int16_t> output_duty;
+
+/// The controller; only the interrupt runs it
+static fixed_pid speed_pid (speed_control_gains, SPEED_OUTPUT_MIN, SPEED_OUTPUT_MAX);
+
+/// The ramp which takes the controller's setpoint to each new speed, one tick per ms
+static motion_profile speed_ramp (SPEED_RAMP_ACCEL, SPEED_RAMP_JERK,
+								  SPEED_CONTROL_HZ);
+
+/// The encoder count when the interrupt last ran
+static uint16_t last_count = 0;
+
+
+// The controller, which the executor calls
+static void speed_control_step (void);
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets up the back motor's half bridges and the quadrature decoder,
+ *  and adds the controller to the control loop executor. The PWM frequency and the
+ *  controller's gains come from the parameters, which must have been loaded first.
+ *  The encoder's A and B channels go to pins E0 and E1, which event channel 0
+ *  decodes for timer D1.
+ */
+
+void speed_control_init (void)
+{
+	back_bridge::init (params.pwm_hz);
+	speed_pid.set_gains (params.speed_gains);
+
+	// Encoder pins are inputs which make level events
+	PORTE.DIRCLR = PIN0_bm | PIN1_bm;
+	PORTE.PIN0CTRL = PORT_ISC_LEVEL_gc;
+	PORTE.PIN1CTRL = PORT_ISC_LEVEL_gc;
+
+	// Event channel 0 decodes the quadrature signals, and timer D1 counts them
+	EVSYS.CH0MUX = EVSYS_CHMUX_PORTE_PIN0_gc;
+	EVSYS.CH0CTRL = EVSYS_QDEN_bm | EVSYS_DIGFILT_2SAMPLES_gc;
+	TCD1.CTRLD = TC_EVACT_QDEC_gc | TC_EVSEL_CH0_gc;
+	TCD1.PER = 0xFFFF;
+	TCD1.CNT = 0;
+	TCD1.CTRLA = TC_CLKSEL_DIV1_gc;
+
+	// The controller runs SPEED_CONTROL_HZ times a second from the executor's high
+	// level interrupt, so it runs on time whatever the tasks are doing
+	control_loop_add (speed_control_step, SPEED_CONTROL_HZ);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the back motor's speed as measured in the last control period.
+ *  @return The speed in encoder counts per ms
+ */
+
+int16_t speed_control_measured (void)
+{
+	return measured_speed.get ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the controller's latest output.
+ *  @return The signed duty cycle; positive is port and negative is starboard
+ */
+
+int16_t speed_control_output (void)
+{
+	return output_duty.get ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function changes the controller's gains while it runs. The integral is kept,
+ *  so the output doesn't jump.
+ *  @param gains The new gains in Q8
+ */
+
+void speed_control_set_gains (const pid_gains& gains)
+{
+	portENTER_CRITICAL ();
+	speed_pid.set_gains (gains);
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the setpoint, measured speed, output and gains.
+ *  @param p_ser The serial device on which to print
+ */
+
+void speed_control_print (emstream* p_ser)
+{
+	pid_gains gains;
+	portENTER_CRITICAL ();
+	gains = speed_pid.get_gains ();
+	portEXIT_CRITICAL ();
+
+	*p_ser << PMS ("setpoint ") << speed_back.get ()
+		   << PMS (" ramped ") << speed_ramp.get_value ()
+		   << PMS (" speed ") << measured_speed.get ()
+		   << PMS (" duty ") << output_duty.get ()
+		   << PMS (" kp ") << gains.kp
+		   << PMS (" ki ") << gains.ki
+		   << PMS (" kd ") << gains.kd << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function runs the speed controller; the executor calls it from its interrupt.
+ *  The setpoint ramps toward the one the motor task gave; once it has ramped down to
+ *  zero the motor coasts, and the controller is cleared so the next start doesn't
+ *  begin with an old integral.
+ */
+
+static void speed_control_step (void)
+{
+	uint16_t count = TCD1.CNT;
+	int16_t measured = (int16_t)(count - last_count);
+	last_count = count;
+
+	int16_t setpoint = speed_ramp.step (speed_back.ISR_get ());
+	int16_t output = 0;
+
+	// While the motor is cut off for drawing too much current, the integrator mustn't
+	// wind up; the controller starts from scratch when the motor runs again
+	if (setpoint == 0 || current_sense_fault (TRACE_BACK) != 0)
+	{
+		speed_pid.reset (measured);
+	}
+	else
+	{
+		output = speed_pid.update (setpoint, measured);
+	}
+
+	uint16_t duty = (uint16_t)(((uint32_t)abs (output) * SPEED_DUTY_SCALE) >> 8);
+	if (output >= 0)
+	{
+		back_bridge::set_duty (duty, 0);
+	}
+	else
+	{
+		back_bridge::set_duty (0, duty);
+	}
+	motor_sync_written (MOTOR_SYNC_BACK);
+
+	measured_speed.ISR_put (measured);
+	output_duty.ISR_put (output);
+}
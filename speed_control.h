@@ -0,0 +1,81 @@
+//**************************************************************************************
+/** \file speed_control.h
+ *    This file contains closed loop speed control for the back motor, which spins the
+ *    ball. The motor's encoder is counted by timer D1 in quadrature decoder mode, fed
+ *    through event channel 0 from pins E0 and E1. The control loop executor runs the
+ *    controller 1000 times a second; each time, it reads how many counts went by,
+ *    runs a fixed point PID controller, and writes the back motor's compare
+ *    registers. The motor task gives a speed setpoint instead of a duty cycle, so the
+ *    ball speed no longer drifts with battery voltage and load. The controller ramps
+ *    the setpoint to each new value rather than jumping.
+ *
+ *    This header includes no hardware headers, so that the host's PID simulator can
+ *    use the same gains as the robot.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SPEED_CONTROL_H_
+#define _SPEED_CONTROL_H_
+
+#include <stdint.h>
+
+#include "fixed_pid.h"                      // Integer PID controller
+#include "atomic_share.h"                   // Lock-free single writer share
+
+class emstream;
+
+
+/// How many times per second the speed controller runs; the control loop executor's
+/// rate must be a multiple of it
+#define SPEED_CONTROL_HZ        1000
+
+/// Limits of the controller's output, which is the signed duty cycle; positive drives
+/// the port half bridge and negative the starboard one. It's in 1/1600ths of full
+/// duty, the compare steps at 20 kHz where the gains were tuned, whatever the PWM
+/// frequency is now
+#define SPEED_OUTPUT_MAX        1600
+#define SPEED_OUTPUT_MIN        (-SPEED_OUTPUT_MAX)
+
+/// The controller's default gains in Q8, as tuned with host/tools/pid_sim.cpp; the
+/// param command changes them
+const pid_gains speed_control_gains = { 20480, 512, 0 };
+
+/// The fastest speed setpoint the param command accepts, in encoder counts per ms;
+/// it's well past what the motor can reach, and keeps the controller's error, the
+/// setpoint less the measured speed, inside 16 bits
+#define SPEED_SETPOINT_MAX      1000
+
+/// Most the speed setpoint may change per ms, in counts per ms per ms, and most that
+/// change may itself change per ms; the setpoint ramps to each new value on an S-curve
+#define SPEED_RAMP_ACCEL        1
+#define SPEED_RAMP_JERK         1
+
+
+// This function starts the encoder counter and adds the controller to the executor
+void speed_control_init (void);
+
+// This function returns the back motor's measured speed in encoder counts per ms
+int16_t speed_control_measured (void);
+
+// This function returns the duty cycle the controller put out most recently
+int16_t speed_control_output (void);
+
+// This function changes the controller's gains
+void speed_control_set_gains (const pid_gains& gains);
+
+// This function prints the setpoint, speed, output and gains
+void speed_control_print (emstream* p_ser);
+
+
+/**
+ * \var speed_back
+ * \brief Speed setpoint for the back motor in encoder counts per ms; only the motor
+ *        task writes it, and the speed controller reads it.
+ */
+extern atomic_share<int16_t> speed_back;
+
+#endif // _SPEED_CONTROL_H_
@@ -0,0 +1,92 @@
+//**************************************************************************************
+/** \file static_alloc.h
+ *    This file contains a way to make objects which live for the whole run, such as
+ *    tasks, in memory set aside by the linker instead of on the heap. Each type gets
+ *    a buffer in .bss which is exactly its size, so the objects show up in the link
+ *    map and in avr-size's count of static RAM, and the heap only has to hold what
+ *    the RTOS itself allocates.
+ *
+ *    An object is made with placement new:
+ *    \code
+ *    new (static_storage<task_user>::place ()) task_user ("UserInt", ...);
+ *    \endcode
+ *    Two objects of the same type need different instance numbers, as in
+ *    static_storage<task_user, 1>.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _STATIC_ALLOC_H_
+#define _STATIC_ALLOC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef HAL_HOST
+	#include <new>                          // The host's C++ library has placement new
+#else
+	/** avr-libc has no <new>, so this is placement new: it "allocates" an object in
+	 *  memory the caller already has.
+	 *  @param size The size of the object, which the buffer must already allow for
+	 *  @param p_place The memory in which the object is to be made
+	 *  @return The same memory
+	 */
+	inline void* operator new (size_t size, void* p_place)
+	{
+		(void)size;
+		return p_place;
+	}
+#endif
+
+
+//-------------------------------------------------------------------------------------
+/** This class holds a static buffer which is just big enough for one object of a
+ *  given type. The buffer is never freed, so this is only for objects which are made
+ *  once at startup and never deleted.
+ *  @param object_type The type of object the buffer holds
+ *  @param instance A number which tells apart buffers for objects of the same type
+ */
+
+template <class object_type, uint8_t instance = 0>
+class static_storage
+{
+protected:
+	/// The buffer; it's aligned for the object, which matters on the host
+	alignas (object_type) static uint8_t buffer[sizeof (object_type)];
+
+public:
+	/** This method returns the buffer in which the object is to be made. It must only
+	 *  be used for one object, so objects of the same type need different instances.
+	 *  @return Pointer to the buffer
+	 */
+	static void* place (void)
+	{
+		return buffer;
+	}
+
+	/** This method returns the object in the buffer. It must only be used once the
+	 *  object has been made there.
+	 *  @return Pointer to the object
+	 */
+	static object_type* get (void)
+	{
+		return reinterpret_cast<object_type*> (buffer);
+	}
+
+	/** This method returns the size of the buffer, for the memory report.
+	 *  @return The number of bytes the buffer takes up
+	 */
+	static size_t size (void)
+	{
+		return sizeof (buffer);
+	}
+};
+
+// The buffer of each type and instance
+template <class object_type, uint8_t instance>
+alignas (object_type) uint8_t static_storage<object_type, instance>::buffer[sizeof (object_type)];
+
+#endif // _STATIC_ALLOC_H_
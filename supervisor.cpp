@@ -0,0 +1,329 @@
+//**************************************************************************************
+/** \file supervisor.cpp
+ *    This file contains the supervisor. Times are kept in RTOS ticks; a task's check
+ *    in and the supervisor's look at it are each done with the scheduler's critical
+ *    section held, so the supervisor never sees a tick count which is half written.
+ *
+ *    Tasks aren't watched until they first check in, so the time each one takes to
+ *    get going, such as the user interface printing its boot report, isn't counted.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <avr/wdt.h>                        // Watchdog timer header
+
+#include "trace.h"                          // Time stamped event trace
+#include "task_stats.h"                     // Run time statistics for the tasks
+#include "motor_axes.h"                     // Every motor's bridge
+#include "supervisor.h"                     // Header for this file
+
+
+/// Marks the counts in .noinit as having been written by this program
+#define SUPERVISOR_MAGIC        0x5AFE
+
+/// The value traced as a motor's fault when the supervisor turns it off
+#define SUPERVISOR_FAULT        0x80
+
+
+/// What is watched for each task
+struct supervisor_entry
+{
+	const char* name;                       ///< Name of the task
+	portTickType period;                    ///< How often the task should check in
+	portTickType last_check_in;             ///< RTOS tick of the last check in
+	portTickType worst_gap;                 ///< Longest time between check ins
+	xTaskHandle handle;                     ///< Handle of the task, once it has started
+	bool in_pass;                           ///< True from check in until check out
+};
+
+/// The counts which are kept across resets
+struct supervisor_counts
+{
+	uint16_t magic;                         ///< SUPERVISOR_MAGIC if the counts are good
+	uint16_t resets;                        ///< Resets the supervisor has caused
+	uint8_t last_task;                      ///< The task which caused the last one
+	uint16_t misses[SUPERVISOR_MAX];        ///< Deadlines missed while asleep
+	uint16_t overruns[SUPERVISOR_MAX];      ///< Deadlines missed in the middle of a pass
+	uint16_t check;                         ///< All of the above added up
+};
+
+/// The tasks which are watched
+static supervisor_entry entries[SUPERVISOR_MAX];
+
+/// How many tasks have signed up
+static uint8_t entry_count = 0;
+
+/// Set once the watchdog is to be left to run out
+static volatile bool stopping = false;
+
+/// The counts of missed deadlines, which startup leaves as they were before a reset
+static supervisor_counts saved __attribute__ ((section (".noinit")));
+
+
+//-------------------------------------------------------------------------------------
+/** This function adds up the counts in .noinit, so that counts which were never
+ *  written, as after power is turned on, can be told from good ones.
+ *  @return The sum of every field except the check itself
+ */
+
+static uint16_t saved_sum (void)
+{
+	uint16_t sum = saved.magic + saved.resets + saved.last_task;
+	for (uint8_t id = 0; id < SUPERVISOR_MAX; id++)
+	{
+		sum += saved.misses[id] + saved.overruns[id];
+	}
+	return sum;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function signs a task up to be watched. It is called from the task's
+ *  constructor, before the scheduler starts.
+ *  @param name The task's name, which must stay around for ever (a string constant)
+ *  @param period The longest time the task should go between check ins, in ticks
+ *  @return A number which the task passes to the other functions in this file
+ */
+
+uint8_t supervisor_register (const char* name, portTickType period)
+{
+	uint8_t id = entry_count;
+
+	if (id < SUPERVISOR_MAX)
+	{
+		entries[id].name = name;
+		entries[id].period = period;
+		entries[id].last_check_in = 0;
+		entries[id].worst_gap = 0;
+		entries[id].handle = NULL;
+		entries[id].in_pass = false;
+		entry_count++;
+	}
+	return id;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a task when it wakes up to run a pass through its loop.
+ *  The first time, the task starts being watched.
+ *  @param id The number which supervisor_register() gave the task
+ */
+
+void supervisor_check_in (uint8_t id)
+{
+	if (id >= entry_count)
+	{
+		return;
+	}
+	supervisor_entry* p_entry = &entries[id];
+
+	portENTER_CRITICAL ();
+	portTickType now = xTaskGetTickCount ();
+	if (p_entry->handle == NULL)
+	{
+		p_entry->handle = xTaskGetCurrentTaskHandle ();
+	}
+	else if ((portTickType)(now - p_entry->last_check_in) > p_entry->worst_gap)
+	{
+		p_entry->worst_gap = now - p_entry->last_check_in;
+	}
+	p_entry->last_check_in = now;
+	p_entry->in_pass = true;
+	portEXIT_CRITICAL ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a task when it has finished a pass and is about to go
+ *  to sleep.
+ *  @param id The number which supervisor_register() gave the task
+ */
+
+void supervisor_check_out (uint8_t id)
+{
+	if (id < entry_count)
+	{
+		entries[id].in_pass = false;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a task which is waiting in the middle of a pass for
+ *  something which is sure to come, such as room in the serial transmit buffer, so
+ *  that a long report isn't taken for an overrun. The task is found by its handle;
+ *  a task which isn't watched is ignored.
+ */
+
+void supervisor_alive (void)
+{
+	xTaskHandle handle = xTaskGetCurrentTaskHandle ();
+
+	for (uint8_t id = 0; id < entry_count; id++)
+	{
+		if (entries[id].handle == handle)
+		{
+			portENTER_CRITICAL ();
+			entries[id].last_check_in = xTaskGetTickCount ();
+			portEXIT_CRITICAL ();
+			return;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function turns the motors off and stops the supervisor feeding the watchdog,
+ *  then waits for the watchdog to reset the AVR. It's for resets which are asked for,
+ *  so they aren't counted as missed deadlines.
+ */
+
+void supervisor_restart (void)
+{
+	motor_axes_safe ();
+	stopping = true;
+	wdt_enable (SUPERVISOR_WATCHDOG);
+	for (;;);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints each task's period, the longest it has gone between check
+ *  ins since the AVR was reset, and how many deadlines it has missed and overrun
+ *  over all resets.
+ *  @param p_ser The serial device on which to print
+ */
+
+void supervisor_print (emstream* p_ser)
+{
+	*p_ser << PMS ("task         period_ms  worst_ms  missed  overrun") << endl;
+	for (uint8_t id = 0; id < entry_count; id++)
+	{
+		supervisor_entry* p_entry = &entries[id];
+
+		portENTER_CRITICAL ();
+		portTickType worst = p_entry->worst_gap;
+		uint16_t misses = saved.misses[id];
+		uint16_t overruns = saved.overruns[id];
+		portEXIT_CRITICAL ();
+
+		*p_ser << p_entry->name
+			   << PMS ("  ") << (uint32_t)(p_entry->period * portTICK_RATE_MS)
+			   << PMS ("  ") << (uint32_t)(worst * portTICK_RATE_MS)
+			   << PMS ("  ") << misses << PMS ("  ") << overruns << endl;
+	}
+	*p_ser << PMS ("supervisor resets ") << saved.resets;
+	if (saved.resets != 0 && saved.last_task < entry_count)
+	{
+		*p_ser << PMS (", last by ") << entries[saved.last_task].name;
+	}
+	*p_ser << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor creates the supervisor task. The counts in .noinit are kept if
+ *  they add up and cleared if they don't.
+ *  @param a_name A character string which will be the name of this task
+ *  @param a_priority The priority at which this task will run; it should be above
+ *                    every task it watches
+ *  @param a_stack_size The size of this task's stack in bytes
+ */
+
+task_supervisor::task_supervisor (const char* a_name,
+								  unsigned portBASE_TYPE a_priority,
+								  size_t a_stack_size)
+	: frt_task (a_name, a_priority, a_stack_size, NULL)
+{
+	last_look = 0;
+	stats_id = task_stats_register (a_name, SUPERVISOR_PERIOD_MS);
+
+	if (saved.magic != SUPERVISOR_MAGIC || saved.check != saved_sum ())
+	{
+		saved.magic = SUPERVISOR_MAGIC;
+		saved.resets = 0;
+		saved.last_task = 0;
+		for (uint8_t id = 0; id < SUPERVISOR_MAX; id++)
+		{
+			saved.misses[id] = 0;
+			saved.overruns[id] = 0;
+		}
+		saved.check = saved_sum ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method looks at every task which has started. The first time one is found
+ *  past its deadline, the motors are turned off, the miss is counted in .noinit, and
+ *  from then on the tasks are never healthy again, so the watchdog resets the AVR.
+ *  @return True if every task has checked in within its deadline
+ */
+
+bool task_supervisor::all_healthy (void)
+{
+	if (stopping)
+	{
+		return false;
+	}
+
+	for (uint8_t id = 0; id < entry_count; id++)
+	{
+		supervisor_entry* p_entry = &entries[id];
+
+		portENTER_CRITICAL ();
+		bool started = (p_entry->handle != NULL);
+		portTickType gap = xTaskGetTickCount () - p_entry->last_check_in;
+		bool in_pass = p_entry->in_pass;
+		portEXIT_CRITICAL ();
+
+		if (started && gap > p_entry->period * SUPERVISOR_DEADLINE)
+		{
+			motor_axes_safe ();
+			stopping = true;
+
+			if (in_pass)
+			{
+				saved.overruns[id]++;
+			}
+			else
+			{
+				saved.misses[id]++;
+			}
+			saved.resets++;
+			saved.last_task = id;
+			saved.check = saved_sum ();
+
+			trace (TRACE_FAULT, TRACE_FRONT, SUPERVISOR_FAULT);
+			trace (TRACE_FAULT, TRACE_BACK, SUPERVISOR_FAULT);
+			return false;
+		}
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This task turns the watchdog on, then looks at the other tasks every
+ *  SUPERVISOR_PERIOD_MS and feeds the watchdog as long as they're all healthy.
+ */
+
+void task_supervisor::run (void)
+{
+	wdt_enable (SUPERVISOR_WATCHDOG);
+	last_look = xTaskGetTickCount ();
+	task_stats_start (stats_id);
+
+	for (;;)
+	{
+		if (all_healthy ())
+		{
+			wdt_reset ();
+		}
+		runs++;
+		task_stats_end_pass (stats_id);
+		vTaskDelayUntil (&last_look, configMS_TO_TICKS (SUPERVISOR_PERIOD_MS));
+	}
+}
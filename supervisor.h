@@ -0,0 +1,94 @@
+//**************************************************************************************
+/** \file supervisor.h
+ *    This file contains the supervisor, which watches that every task keeps running.
+ *    Each task signs up with how often it's supposed to run its loop and checks in at
+ *    the start of every pass. The supervisor task, at a higher priority than all of
+ *    them, looks every SUPERVISOR_PERIOD_MS to see whether any task has gone longer
+ *    than its deadline without checking in. If one has, both motors are turned off at
+ *    once, so a stalled motor task can't leave its last duty cycle on, and the
+ *    hardware watchdog stops being fed, so the AVR resets. The watchdog is only fed
+ *    while every task is healthy.
+ *
+ *    A task which has gone past its deadline while in the middle of a pass has
+ *    overrun; one which is asleep has missed its deadline because it wasn't woken or
+ *    couldn't get the CPU. The counts of each are kept in .noinit, which startup
+ *    doesn't clear, so they can be read after the reset they caused.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _SUPERVISOR_H_
+#define _SUPERVISOR_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+#include "frt_task.h"                       // Header for ME405/507 base task class
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The most tasks which can be watched
+#define SUPERVISOR_MAX          4
+
+/// How often the supervisor looks at the tasks, in ms
+#define SUPERVISOR_PERIOD_MS    5
+
+/// A task is late once it has gone this many of its periods without checking in
+#define SUPERVISOR_DEADLINE     2
+
+/// How long the watchdog waits to be fed; it must be a few supervisor periods long
+#define SUPERVISOR_WATCHDOG     WDTO_60MS
+
+
+// This function signs a task up to be watched; it's called from the task constructor
+uint8_t supervisor_register (const char* name, portTickType period);
+
+// This function is called by each task at the start of every pass through its loop
+void supervisor_check_in (uint8_t id);
+
+// This function is called by each task at the end of every pass, just before it sleeps
+void supervisor_check_out (uint8_t id);
+
+// This function tells the supervisor that the task calling it is waiting, not stuck
+void supervisor_alive (void);
+
+// This function turns the motors off and resets the AVR through the watchdog
+void supervisor_restart (void) __attribute__ ((noreturn));
+
+// This function prints each task's deadline and how often it has been missed
+void supervisor_print (emstream* p_ser);
+
+
+//-------------------------------------------------------------------------------------
+/** This class is the supervisor task. It does nothing but look at the other tasks and
+ *  feed the watchdog, so it needs only a small stack.
+ */
+
+class task_supervisor : public frt_task
+{
+protected:
+	/// The RTOS tick at which the last look was taken
+	portTickType last_look;
+
+	/// The number which the run time statistics know this task by
+	uint8_t stats_id;
+
+	// This method looks at every task and says whether all of them are healthy
+	bool all_healthy (void);
+
+public:
+	// This constructor creates the supervisor task
+	task_supervisor (const char* a_name,
+					 unsigned portBASE_TYPE a_priority,
+					 size_t a_stack_size);
+
+	/** This method is called by the RTOS once to run the task loop for ever and ever.
+	 */
+	void run (void);
+};
+
+#endif // _SUPERVISOR_H_
@@ -0,0 +1,122 @@
+//**************************************************************************************
+/** \file task_motor.cpp
+ *    This file contains the task which runs every motor axis. The axes take turns in
+ *    one loop in the order of the axis table; a pass through an axis never waits, so
+ *    none of them holds up the others.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include "static_alloc.h"                   // Placement new for the axes
+#include "task_stats.h"                     // Run time statistics for the tasks
+#include "supervisor.h"                     // Deadline watch and the watchdog
+#include "motor_sync.h"                     // All motors' PWM changing together
+#include "motor_axes.h"                     // The board's axis table
+#include "params.h"                         // Each axis's levels
+#include "task_motor.h"                     // Header for this file
+
+
+//-------------------------------------------------------------------------------------
+/** This constructor creates the motor task. Its main job is to call the parent
+ *  class's constructor which does most of the work; then it makes an axis from each
+ *  row of the axis table, with its levels from the parameters. The parameters must
+ *  have been loaded first.
+ *  @param a_name A character string which will be the name of this task
+ *  @param a_priority The priority at which this task will initially run (default: 0)
+ *  @param a_stack_size The size of this task's stack in bytes
+ *                      (default: configMINIMAL_STACK_SIZE)
+ *  @param p_ser_dev Pointer to a serial device (port, radio, SD card, etc.) which can
+ *                   be used by this task to communicate (default: NULL)
+ *  @param p_task_handle Pointer to the handle through which this task is notified
+ */
+
+task_motor::task_motor (const char* a_name,
+						unsigned portBASE_TYPE a_priority,
+						size_t a_stack_size,
+						emstream* p_ser_dev,
+						xTaskHandle* p_task_handle
+					   )
+	: frt_task (a_name, a_priority, a_stack_size, p_ser_dev),
+	  p_handle (p_task_handle)
+{
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		new (axis (index)) motor_axis (&motor_axis_table[index], &params.axes[index]);
+	}
+
+	// The loop runs at least once per timeout, which is its nominal period
+	stats_id = task_stats_register (a_name, motor_timeout * portTICK_RATE_MS);
+	supervisor_id = supervisor_register (a_name, motor_timeout);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method finds the axis of a motor by its number in the event trace.
+ *  @param source The motor's number, such as TRACE_FRONT or TRACE_BACK
+ *  @return Pointer to the axis, or NULL if no axis has that number
+ */
+
+motor_axis* task_motor::axis_of (uint8_t source)
+{
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		if (axis (index)->source () == source)
+		{
+			return axis (index);
+		}
+	}
+	return NULL;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This task runs the motors. Each pass runs every axis until its state settles, so
+ *  a command which changes the state and another one right behind it are both taken
+ *  in the same pass; then the task sleeps until the user interface sends a setpoint,
+ *  the next queued one for any axis is due, or the timeout runs out.
+ */
+
+void task_motor::run (void)
+{
+	// Let the user interface task know where to send its notifications
+	*p_handle = xTaskGetCurrentTaskHandle ();
+
+	// Wait a little while for user interface task to finish up
+	delay_ms (10);
+
+	task_stats_start (stats_id);
+
+	for (;;)
+	{
+		supervisor_check_in (supervisor_id);
+
+		portTickType wait = motor_timeout;
+		for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+		{
+			motor_axis* p_axis = axis (index);
+			while (p_axis->step ())
+			{
+			}
+			if (p_axis->took_setpoint ())
+			{
+				motor_sync_taken (1 << p_axis->source ());
+			}
+
+			portTickType axis_wait = p_axis->ticks_to_next ();
+			if (axis_wait < wait)
+			{
+				wait = axis_wait;
+			}
+		}
+		runs++;
+
+		task_stats_end_pass (stats_id);
+		supervisor_check_out (supervisor_id);
+		if (wait != 0)
+		{
+			ulTaskNotifyTake (pdTRUE, wait);
+		}
+	}
+}
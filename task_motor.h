@@ -0,0 +1,96 @@
+//**************************************************************************************
+/** \file task_motor.h
+ *    This file contains the task which runs the half bridge motors of a bowling ramp
+ *    robot. It replaces the separate front and back motor tasks, which were copies
+ *    of each other, and then the task for each motor: one task runs every axis in
+ *    the board's axis table, so a motor costs one motor_axis rather than a task with
+ *    its own stack.
+ *
+ *  Revisions:
+ *    \li 10-25-2019 HVH Front and back motor tasks adapted from HVH task_PWM.h
+ *
+ *  License:
+ *    This file is copyright 2019 by H Hershberger and released under the GNU
+ *    Public License, version 2. It intended for educational use only, but its use
+ *    is not limited thereto. */
+/*    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUEN-
+ *    TIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ *    OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *	  (TLDR):  THIS CODE MIGHT SUCK AND YOU'RE ON YOUR OWN  */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _TASK_MOTOR_H_
+#define _TASK_MOTOR_H_
+
+#include <stdlib.h>                         // Prototype declarations for I/O functions
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "frt_task.h"                       // Header for ME405/507 base task class
+#include "emstream.h"                       // Header for serial ports and devices
+#include "motor_axis.h"                     // One motor and its state machine
+
+
+/// How many axes the board has; motor_axes.cpp has a row of the axis table for each
+#define MOTOR_AXIS_COUNT        2
+
+
+//-------------------------------------------------------------------------------------
+/** This task runs every motor axis. It sleeps until the user interface says there's
+ *  a new setpoint or the next queued one for any axis is due, then runs each axis's
+ *  state machine until its state settles down and no setpoint is waiting to be taken.
+ */
+
+class task_motor : public frt_task
+{
+private:
+	// No private variables or methods for this class
+
+protected:
+	/// The axes, made here from the axis table when the task is made
+	alignas (motor_axis) uint8_t axis_space[MOTOR_AXIS_COUNT * sizeof (motor_axis)];
+
+	/// Where to put this task's handle so the user interface can notify it
+	xTaskHandle* p_handle;
+
+	/// The number under which this task's run time statistics are kept
+	uint8_t stats_id;
+
+	/// The number by which the supervisor knows this task
+	uint8_t supervisor_id;
+
+public:
+	// This constructor creates the motor task and its axes
+	task_motor (const char* a_name,
+				unsigned portBASE_TYPE a_priority,
+				size_t a_stack_size,
+				emstream* p_ser_dev,
+				xTaskHandle* p_task_handle);
+
+	/** This method returns one of the axes.
+	 *  @param index Which axis, its row in the axis table
+	 *  @return Pointer to the axis
+	 */
+	motor_axis* axis (uint8_t index)
+	{
+		return reinterpret_cast<motor_axis*> (axis_space) + index;
+	}
+
+	// This method finds the axis of a motor by its number in the event trace
+	motor_axis* axis_of (uint8_t source);
+
+	/** This method is called by the RTOS once to run the task loop for ever and ever.
+	 */
+	void run (void);
+};
+
+#endif // _TASK_MOTOR_H_
@@ -1,74 +0,0 @@
-//**************************************************************************************
-/** \file task_motor_front.h
- *    This file contains header stuff for a back motor routine task for a ME507/FreeRTOS
- *    test suite. 
- *
- *  Revisions:
- *    \li 10-25-2019 HVH Adapted from HVH task_PWM.h
- *
- *  License:
- *    This file is copyright 2012 by H Hershberger and released under the GNU 
- *    Public License, version 2. It intended for educational use only, but its use
- *    is not limited thereto. */
-/*    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
- *    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
- *    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
- *    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
- *    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUEN-
- *    TIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS 
- *    OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
- *    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
- *    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
- *    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
-//**************************************************************************************
-
-// This define prevents this .h file from being included multiple times in a .cpp file
-#ifndef _TASK_MOTOR_FRONT_H_
-#define _TASK_MOTOR_FRONT_H_
-
-#include <stdlib.h>                         // Prototype declarations for I/O functions
-
-#include "FreeRTOS.h"                       // Primary header for FreeRTOS
-#include "task.h"                           // Header for FreeRTOS task functions
-#include "queue.h"                          // FreeRTOS inter-task communication queues
-
-#include "rs232int.h"                       // ME405/507 library for serial comm.
-#include "time_stamp.h"                     // Class to implement a microsecond timer
-#include "frt_task.h"                       // Header for ME405/507 base task class
-#include "frt_queue.h"                      // Header of wrapper for FreeRTOS queues
-#include "frt_text_queue.h"                 // Header for a "<<" queue class
-#include "frt_shared_data.h"                // Header for thread-safe shared data
-
-#include "shares.h"                         // Global ('extern') queue declarations
-
-#include "math.h"
-
-
-//-------------------------------------------------------------------------------------
-/** This tasks interacts with two half bridge motor drivers to control a motor on the
- * the front of a bowling robot.
- */
-
-class task_motor_front : public frt_task
-{
-private:
-	// No private variables or methods for this class
-
-protected:
-	enum motor_front_states 
-	{
-		INIT,
-		MOTOR_STOPPED,
-		MOTOR_PORT,
-		MOTOR_STARBOARD,
-	};					//!< Task state
-public:
-	// This constructor creates a user interface task object
-	task_motor_front (const char*, unsigned portBASE_TYPE, size_t, emstream*);
-
-	/** This method is called by the RTOS once to run the task loop for ever and ever.
-	 */
-	void run (void);
-};
-
-#endif // _TASK_MOTOR_FRONT_H_
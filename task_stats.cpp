@@ -0,0 +1,236 @@
+//**************************************************************************************
+/** \file task_stats.cpp
+ *    This file contains run time statistics for the tasks. Each task's CPU time is the
+ *    time from when the scheduler switches it in until it switches it out, so a task
+ *    which is preempted isn't charged for the task which preempted it. The control
+ *    loop interrupt, which runs often and for a while at a high level, counts its own
+ *    cycles, and they're taken off whichever task it interrupted. The other interrupts
+ *    are short and are still counted in the task they interrupt.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "task_stats.h"                     // Header for this file
+
+
+/// What is measured for each task
+struct task_stats_entry
+{
+	const char* name;                       ///< Name of the task
+	uint16_t nominal_period_ms;             ///< How often the task should run its loop
+	xTaskHandle handle;                     ///< Handle of the task, once it's running
+	uint32_t busy_ms;                       ///< Whole ms of CPU time since last print
+	uint32_t busy_cycles;                   ///< Cycles of CPU time on top of busy_ms
+	uint32_t passes;                        ///< Passes finished since last print
+};
+
+/// Cycles of CPU time which are moved from busy_cycles to busy_ms at once, so that
+/// busy_cycles never overflows however long it is between prints
+#define TASK_STATS_CARRY_MS     1024UL
+
+/// The statistics for each task
+static task_stats_entry stats[TASK_STATS_MAX];
+
+/// How many tasks have signed up
+static uint8_t stats_count = 0;
+
+/// Which task has the CPU, or TASK_STATS_MAX if it isn't one which is measured
+static uint8_t running = TASK_STATS_MAX;
+
+/// Cycle count when the running task was switched in
+static uint32_t switched_in_at = 0;
+
+/// Cycles the control loop interrupt has taken, in all; it wraps around
+static volatile uint32_t interrupt_cycles = 0;
+
+/// The control loop interrupt's cycles when the running task was switched in
+static uint32_t interrupt_cycles_at = 0;
+
+/// RTOS tick count when the statistics were last printed
+static portTickType window_start = 0;
+
+
+//-------------------------------------------------------------------------------------
+/** This function signs a task up for measurement. It is called from the task's
+ *  constructor, before the scheduler starts.
+ *  @param name The task's name, which must stay around for ever (a string constant)
+ *  @param nominal_period_ms How often the task is supposed to run its loop
+ *  @return A number which the task passes to the other functions in this file
+ */
+
+uint8_t task_stats_register (const char* name, uint16_t nominal_period_ms)
+{
+	uint8_t id = stats_count;
+
+	if (id < TASK_STATS_MAX)
+	{
+		stats[id].name = name;
+		stats[id].nominal_period_ms = nominal_period_ms;
+		stats[id].handle = NULL;
+		stats_count++;
+	}
+	return id;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a task when it starts running, so that its CPU time
+ *  can be measured and its stack checked from then on.
+ *  @param id The number which task_stats_register() gave the task
+ */
+
+void task_stats_start (uint8_t id)
+{
+	if (id < stats_count)
+	{
+		portENTER_CRITICAL ();
+		stats[id].handle = xTaskGetCurrentTaskHandle ();
+		portEXIT_CRITICAL ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by a task when it has finished a pass and is about to go
+ *  to sleep.
+ *  @param id The number which task_stats_register() gave the task
+ */
+
+void task_stats_end_pass (uint8_t id)
+{
+	if (id < stats_count)
+	{
+		portENTER_CRITICAL ();
+		stats[id].passes++;
+		portEXIT_CRITICAL ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by the control loop interrupt with the cycles it took, so
+ *  that they aren't charged to the task it interrupted.
+ *  @param cycles How many cycles the interrupt took
+ */
+
+void task_stats_interrupted (uint16_t cycles)
+{
+	interrupt_cycles = interrupt_cycles + cycles;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by the scheduler, with interrupts off, just after it has
+ *  picked the task to run. It notes which task that is and when it started.
+ */
+
+extern "C" void task_stats_switched_in (void)
+{
+	xTaskHandle handle = xTaskGetCurrentTaskHandle ();
+
+	running = TASK_STATS_MAX;
+	for (uint8_t id = 0; id < stats_count; id++)
+	{
+		if (stats[id].handle == handle)
+		{
+			running = id;
+			break;
+		}
+	}
+	switched_in_at = cycle_counter_now ();
+	interrupt_cycles_at = interrupt_cycles;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function is called by the scheduler, with interrupts off, just before it
+ *  switches the running task out. The time since it was switched in, less what the
+ *  control loop interrupt took meanwhile, is added to the task's CPU time.
+ */
+
+extern "C" void task_stats_switched_out (void)
+{
+	if (running >= stats_count)
+	{
+		return;
+	}
+
+	uint32_t slice = cycle_counter_now () - switched_in_at;
+	uint32_t interrupted = interrupt_cycles - interrupt_cycles_at;
+	task_stats_entry* p_entry = &stats[running];
+
+	p_entry->busy_cycles += (slice > interrupted) ? slice - interrupted : 0;
+	while (p_entry->busy_cycles >= TASK_STATS_CARRY_MS * CYCLES_PER_MS)
+	{
+		p_entry->busy_cycles -= TASK_STATS_CARRY_MS * CYCLES_PER_MS;
+		p_entry->busy_ms += TASK_STATS_CARRY_MS;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints a table of each task's CPU use in tenths of a percent, how
+ *  many passes per second it ran and how many it should have run, and the smallest
+ *  amount of free stack it has had, in bytes. The counts then start over, so the
+ *  next table covers the time from now until it's printed.
+ *  @param p_ser The serial device on which to print
+ */
+
+void task_stats_print (emstream* p_ser)
+{
+	portTickType now = xTaskGetTickCount ();
+	uint32_t window_ms = (uint32_t)(now - window_start) * portTICK_RATE_MS;
+	uint16_t total_permille = 0;
+
+	if (window_ms == 0)
+	{
+		window_ms = 1;
+	}
+
+	*p_ser << PMS ("task         cpu/1000  runs/s  nominal  stack_free") << endl;
+	for (uint8_t id = 0; id < stats_count; id++)
+	{
+		task_stats_entry* p_entry = &stats[id];
+
+		// Copy and clear the counts as one, so a task switch now isn't half counted
+		portENTER_CRITICAL ();
+		uint32_t busy_ms = p_entry->busy_ms + p_entry->busy_cycles / CYCLES_PER_MS;
+		uint32_t passes = p_entry->passes;
+		p_entry->busy_ms = 0;
+		p_entry->busy_cycles = 0;
+		p_entry->passes = 0;
+		portEXIT_CRITICAL ();
+
+		// Past a minute, work in whole seconds so that the products can't overflow
+		uint32_t scale = (window_ms < 60000UL) ? 1000UL : 1UL;
+		uint32_t per = (window_ms < 60000UL) ? window_ms : window_ms / 1000UL;
+		uint16_t permille = (uint16_t)(busy_ms * scale / per);
+		uint32_t runs_per_s = passes * scale / per;
+		total_permille += permille;
+
+		*p_ser << p_entry->name << PMS ("  ") << permille
+			   << PMS ("  ") << runs_per_s
+			   << PMS ("  ") << (uint16_t)(1000 / p_entry->nominal_period_ms)
+			   << PMS ("  ");
+		if (p_entry->handle != NULL)
+		{
+			*p_ser << (uint16_t)uxTaskGetStackHighWaterMark (p_entry->handle);
+		}
+		else
+		{
+			*p_ser << PMS ("-");
+		}
+		*p_ser << endl;
+	}
+	if (total_permille > 1000)
+	{
+		total_permille = 1000;
+	}
+	*p_ser << PMS ("everything else ") << (uint16_t)(1000 - total_permille)
+		   << PMS (" over ") << window_ms << PMS (" ms") << endl;
+
+	window_start = now;
+}
@@ -0,0 +1,57 @@
+//**************************************************************************************
+/** \file task_stats.h
+ *    This file contains run time statistics for the tasks: how much of the CPU each
+ *    one uses, how many times a second it runs its loop compared with how often it's
+ *    supposed to, and how much of its stack it has never touched. The scheduler calls
+ *    task_stats_switched_in() and task_stats_switched_out() at every task switch,
+ *    and the time each task has the CPU is measured with the cycle counter, less
+ *    the time the control loop interrupt takes from it. For that, FreeRTOSConfig.h
+ *    must have
+ *    \code
+ *    #define traceTASK_SWITCHED_IN()     task_stats_switched_in ()
+ *    #define traceTASK_SWITCHED_OUT()    task_stats_switched_out ()
+ *    \endcode
+ *    with the two functions declared, as they're called from the scheduler's C code.
+ *    Each task also marks the end of every pass through its loop, so its passes per
+ *    second can be compared with how often it's supposed to run.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _TASK_STATS_H_
+#define _TASK_STATS_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+#include "emstream.h"                       // Header for serial ports and devices
+
+
+/// The most tasks which can be measured
+#define TASK_STATS_MAX      6
+
+
+// This function signs a task up for measurement; it's called from the task constructor
+uint8_t task_stats_register (const char* name, uint16_t nominal_period_ms);
+
+// This function is called by each task when its loop starts running
+void task_stats_start (uint8_t id);
+
+// This function is called by each task at the end of every pass, just before it sleeps
+void task_stats_end_pass (uint8_t id);
+
+// This function is called by the control loop interrupt with the cycles it took
+void task_stats_interrupted (uint16_t cycles);
+
+// These functions are called by the scheduler when a task gets and gives up the CPU
+extern "C" void task_stats_switched_in (void);
+extern "C" void task_stats_switched_out (void);
+
+// This function prints the statistics since the last time they were printed
+void task_stats_print (emstream* p_ser);
+
+#endif // _TASK_STATS_H_
@@ -27,17 +27,35 @@
 //**************************************************************************************
 
 #include <avr/io.h>                         // Port I/O for SFR's
-#include <avr/wdt.h>                        // Watchdog timer header
+#include <avr/pgmspace.h>                  // Tables and strings in program memory
 
 #include "shared_data_sender.h"
 #include "shared_data_receiver.h"
 #include "task_user.h"                      // Header for this file
+#include "benchmark.h"                      // Cycle counts of the hot paths
+#include "static_alloc.h"                   // Where main() made the motor task
+#include "trace.h"                          // Time stamped event trace
+#include "task_stats.h"                     // Run time statistics for the tasks
+#include "serial_rx.h"                      // Interrupt driven serial receiver
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "speed_control.h"                  // Closed loop speed of the back motor
+#include "memory_map.h"                     // Report of where the RAM went
+#include "boot_profile.h"                   // How long each step of booting takes
+#include "xmega_util.h"                     // System clock control
+#include "shot_script.h"                    // Timed shot sequences
+#include "motor_sync.h"                     // Both motors' PWM changing together
+#include "control_loop.h"                   // Control loops run by a timer interrupt
+#include "motor_axes.h"                     // The motors and their PWM setup
+#include "current_sense.h"                  // Motor currents and stall cut-off
+#include "telemetry.h"                      // Binary snapshots for the PC
+#include "supervisor.h"                     // Deadline watch and the watchdog
+#include "params.h"                         // Tunable parameters kept in the EEPROM
 
 
-/** This constant sets how many RTOS ticks the task delays if the user's not talking.
- *  The duration is calculated to be about 5 ms.
+/** This constant sets how many RTOS ticks the task sleeps if the user's not talking.
+ *  Characters wake it up right away, so this only sets how often an idle pass runs.
  */
-const portTickType ticks_to_delay = ((configTICK_RATE_HZ / 1000) * 5);
+const portTickType user_timeout = configMS_TO_TICKS (100);
 
 
 //-------------------------------------------------------------------------------------
@@ -56,219 +74,1111 @@ task_user::task_user (const char* a_name,
 					  size_t a_stack_size,
 					  emstream* p_ser_dev
 					 )
-	: frt_task (a_name, a_priority, a_stack_size, p_ser_dev)
+	: frt_task (a_name, a_priority, a_stack_size, p_ser_dev), link (p_ser_dev),
+	  machine (actions, TRACE_USER)
 {
-	// Nothing is done in the body of this constructor. All the work is done in the
-	// call to the frt_task constructor on the line just above this one
+	// Most of the work is done in the call to the frt_task constructor on the line
+	// just above this one; when nobody types, this task runs once per timeout
+	stats_id = task_stats_register (a_name, user_timeout * portTICK_RATE_MS);
+	supervisor_id = supervisor_register (a_name, user_timeout);
+	line_length = 0;
 }
 
 
+// Create front_steer share
+atomic_share<uint8_t> steer_front;
+// Create back_steer share
+atomic_share<uint8_t> steer_back;
+
+// The motors' setpoint queues
+setpoint_queue setpoints_front;
+setpoint_queue setpoints_back;
+
+// Handle of the motor task, which it fills in when it starts running
+xTaskHandle motor_task = NULL;
+
+
 //-------------------------------------------------------------------------------------
-/** This task interacts with the user for force him/her to do what he/she is told. It
- *  is just following the modern government model of "This is the land of the free...
- *  free to do exactly what you're told." 
+/** This method puts a setpoint in a motor's queue and wakes up the motor task, which
+ *  takes it when its start time comes. A setpoint which is to be carried out at once
+ *  replaces any still waiting, so it doesn't wait behind one which starts later.
+ *  @param queue The motor's setpoint queue
+ *  @param motor Handle of the motor task to wake up, or NULL if it isn't running yet
+ *  @param source Which motor this is, as it should appear in the trace
+ *  @param next The setpoint
+ *  @param at_once True if the setpoint starts now and replaces the waiting ones
+ *  @return True if the setpoint was queued, false if the queue was full
  */
 
+bool task_user::send_setpoint (setpoint_queue& queue, xTaskHandle motor, uint8_t source,
+							   const setpoint& next, bool at_once)
+{
+	if (!(at_once ? queue.replace (next) : queue.put (next)))
+	{
+		*p_serial << PMS ("Setpoint queue full") << endl;
+		return false;
+	}
 
-// Create front_steer share
-shared_data<uint8_t> steer_front;
-// Create back_steer share
-shared_data<uint8_t> steer_back;
+	trace (TRACE_SHARE, source, next.command);
+	if (motor != NULL)
+	{
+		xTaskNotifyGive (motor);
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sends a steering command to one of the motors, to be carried out
+ *  right away in place of any setpoints still waiting. A command is only sent when it
+ *  changes something, so holding a key down doesn't fill the queue; the motor's
+ *  share shows what it's doing, so a stop is sent even while a later setpoint waits.
+ *  While a shot script is playing, the sequencer owns the queues and nothing is sent
+ *  here.
+ *  @param share The share which shows what the motor is doing
+ *  @param queue The motor's setpoint queue
+ *  @param motor Handle of the motor task to wake up, or NULL if it isn't running yet
+ *  @param source Which motor this is, as it should appear in the trace
+ *  @param command The new steering command (0 = stop, 1 = port, 2 = starboard)
+ *  @return True if the motor will carry out the command, false if a shot script is
+ *          playing or the queue was full
+ */
+
+bool task_user::steer (atomic_share<uint8_t>& share, setpoint_queue& queue,
+					   xTaskHandle motor, uint8_t source, uint8_t command)
+{
+	if (shot_script_running ())
+	{
+		return false;
+	}
+	if (steer_changes (share, queue, command))
+	{
+		setpoint next = { xTaskGetTickCount (), 0, 0, command };
+		return send_setpoint (queue, motor, source, next, true);
+	}
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method sends steering commands to both motors. If both commands change, the
+ *  motors' PWM is held until both new duty cycles are ready, so that the two motors
+ *  change at the same timer overflow.
+ *  @param front The front motor's new steering command
+ *  @param back The back motor's new steering command
+ *  @return True if both motors will carry out their commands
+ */
+
+bool task_user::steer_both (uint8_t front, uint8_t back)
+{
+	if (!shot_script_running ())
+	{
+		uint8_t motors = 0;
+		if (steer_changes (steer_front, setpoints_front, front))
+		{
+			motors |= MOTOR_SYNC_FRONT;
+		}
+		if (steer_changes (steer_back, setpoints_back, back))
+		{
+			motors |= MOTOR_SYNC_BACK;
+		}
+		motor_sync_begin (motors);
+	}
+
+	bool done = steer (steer_front, setpoints_front, motor_task, TRACE_FRONT, front);
+	return steer (steer_back, setpoints_back, motor_task, TRACE_BACK, back) && done;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function splits the next word off the front of a command line. The word is
+ *  ended with a '\0' in place, and the line pointer is moved past it.
+ *  @param p_args Pointer to the pointer to the rest of the command line
+ *  @return The word, or NULL if there are no more words
+ */
+
+static char* next_word (char** p_args)
+{
+	char* p_char = *p_args;
+
+	while (*p_char == ' ')
+	{
+		p_char++;
+	}
+	if (*p_char == '\0')
+	{
+		*p_args = p_char;
+		return NULL;
+	}
+
+	char* p_word = p_char;
+	while (*p_char != ' ' && *p_char != '\0')
+	{
+		p_char++;
+	}
+	if (*p_char == ' ')
+	{
+		*p_char++ = '\0';
+	}
+	*p_args = p_char;
+	return p_word;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function splits the next word off a command line and reads it as a number.
+ *  @param p_args Pointer to the pointer to the rest of the command line
+ *  @param p_value Place to put the number
+ *  @return True if there was a number, false if the word was missing or not a number
+ */
+
+static bool next_number (char** p_args, int32_t* p_value)
+{
+	char* p_word = next_word (p_args);
+	if (p_word == NULL)
+	{
+		return false;
+	}
+
+	char* p_end;
+	*p_value = strtol (p_word, &p_end, 0);
+	return (*p_end == '\0');
+}
+
+
+//-------------------------------------------------------------------------------------
+// The commands which can be typed at the command line in USER_LINE. Each one is run
+// when the user presses Enter, with the rest of the line as its arguments
+
+const user_command task_user::commands[] PROGMEM =
+{
+	{ "e",      &task_user::cmd_motor,  "go to motor control" },
+	{ "motor",  &task_user::cmd_motor,  "go to motor control" },
+	{ "steer",  &task_user::cmd_steer,  "front|back 0|1|2: steer a motor" },
+	{ "bench",  &task_user::cmd_bench,  "time the hot paths, as CSV" },
+	{ "trace",  &task_user::cmd_trace,  "show trace and key to PWM latency" },
+	{ "stats",  &task_user::cmd_stats,  "show task CPU use and stacks" },
+	{ "link",   &task_user::cmd_link,   "show binary host link counters" },
+	{ "tx",     &task_user::cmd_tx,     "show serial transmit buffer counters" },
+	{ "loop",   &task_user::cmd_loop,   "[Hz]: show or set control loop timing" },
+	{ "sync",   &task_user::cmd_sync,   "show coordinated motor updates" },
+	{ "shot",   &task_user::cmd_shot,   "clear|add us f b|run|stop: shot script" },
+	{ "speed",  &task_user::cmd_speed,  "show back motor speed control" },
+	{ "pwm",    &task_user::cmd_pwm,    "[front|back Hz [hires [dead_ns]]]: PWM" },
+	{ "current",&task_user::cmd_current,"show motor currents and cut-offs" },
+	{ "telem",  &task_user::cmd_telem,  "[Hz]: binary telemetry frames, 0=off" },
+	{ "setpt",  &task_user::cmd_setpt,  "[front|back 0|1|2 [in [for [lvl]]]]" },
+	{ "fsm",    &task_user::cmd_fsm,    "show the tasks' last state changes" },
+	{ "super",  &task_user::cmd_super,  "show missed task deadlines" },
+	{ "param",  &task_user::cmd_param,  "[front|back f v|name v|save|load|reset]" },
+	{ "mem",    &task_user::cmd_mem,    "show RAM sections and free heap" },
+	{ "boot",   &task_user::cmd_boot,   "show boot time and system clock" },
+	{ "reset",  &task_user::cmd_reset,  "reset the AVR (or press Ctrl-C)" },
+	{ "help",   &task_user::cmd_help,   "show this list" },
+};
+
+/// How many commands are in the table
+const uint8_t task_user::command_count = sizeof (commands) / sizeof (commands[0]);
+
+
+// The keys which do something in each of the motor control states; each table ends
+// with an entry for key 0, which handles every key not listed before it
+
+/// Keys in USER_SELECT, where the user picks a motor to steer
+const user_key task_user::select_keys[] PROGMEM =
+{
+	{ 's',      &task_user::key_select_back },
+	{ 'w',      &task_user::key_select_front },
+	{ 27,       &task_user::key_exit },
+	{ 'q',      &task_user::key_exit },
+	{ 0,        &task_user::key_unknown },
+};
+
+/// Keys in USER_BACK, where the back motor is steered
+const user_key task_user::back_keys[] PROGMEM =
+{
+	{ 'q',      &task_user::key_selector },
+	{ 'w',      &task_user::key_select_front },
+	{ 'a',      &task_user::key_port },
+	{ 'd',      &task_user::key_starboard },
+	{ 0,        &task_user::key_stop },
+};
+
+/// Keys in USER_FRONT, where the front motor is steered
+const user_key task_user::front_keys[] PROGMEM =
+{
+	{ 'q',      &task_user::key_selector },
+	{ 's',      &task_user::key_select_back },
+	{ 'a',      &task_user::key_port },
+	{ 'd',      &task_user::key_starboard },
+	{ 0,        &task_user::key_stop },
+};
+
+
+// Each state's actions. Each state but the command line runs keys from its key table
+const fsm_state<task_user> task_user::actions[USER_STATE_COUNT] PROGMEM =
+{
+	{ &task_user::enter_line,       &task_user::line_char,          NULL },
+	{ &task_user::enter_select,     &task_user::select_key,         NULL },
+	{ NULL,                         &task_user::back_key,           NULL },
+	{ NULL,                         &task_user::front_key,          NULL },
+};
+
+
+//-------------------------------------------------------------------------------------
+/** This method handles one character typed in USER_LINE. Characters are collected into
+ *  a line, with backspace for corrections, and the line is run as a command when the
+ *  user presses Enter. Control-C resets the AVR right away.
+ *  @param ch The character which was typed
+ */
+
+void task_user::handle_line_char (char ch)
+{
+	switch (ch)
+	{
+		// Control-C means reset the AVR computer
+		case (3):
+			cmd_reset (line);
+			break;
+
+		// Enter runs the command line
+		case ('\r'):
+		case ('\n'):
+			*p_serial << endl;
+			if (line_length > 0)
+			{
+				line[line_length] = '\0';
+				line_length = 0;
+				run_command (line);
+			}
+			if (state == USER_LINE)
+			{
+				*p_serial << PMS ("> ");
+			}
+			break;
+
+		// Backspace and delete take back the last character
+		case (8):
+		case (127):
+			if (line_length > 0)
+			{
+				line_length--;
+				*p_serial << PMS ("\b \b");
+			}
+			break;
+
+		// Printable characters go into the line, if there's room for them
+		default:
+			if (ch >= ' ' && line_length < USER_LINE_SIZE - 1)
+			{
+				line[line_length++] = ch;
+				p_serial->putchar (ch);
+			}
+			break;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method looks up the first word of a command line in the command table and
+ *  runs the command's handler with the rest of the line.
+ *  @param p_line The command line, which may be changed by splitting it into words
+ */
+
+void task_user::run_command (char* p_line)
+{
+	char* p_name = next_word (&p_line);
+	if (p_name == NULL)
+	{
+		return;
+	}
+
+	for (uint8_t index = 0; index < command_count; index++)
+	{
+		if (strcmp_P (p_name, commands[index].name) == 0)
+		{
+			command_handler handler;
+			memcpy_P (&handler, &commands[index].handler, sizeof (handler));
+			(this->*handler) (p_line);
+			return;
+		}
+	}
+
+	*p_serial << p_name << PMS (":WTF? Type help for a list of commands") << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method finds a key in one of the key tables and runs its handler.
+ *  @param p_table The table for the current state, which is in program memory
+ *  @param key The key which was pressed
+ */
+
+void task_user::handle_key (const user_key* p_table, char key)
+{
+	for (;; p_table++)
+	{
+		char table_key = (char)pgm_read_byte (&p_table->key);
+		if (table_key == key || table_key == 0)
+		{
+			key_handler handler;
+			memcpy_P (&handler, &p_table->handler, sizeof (handler));
+			(this->*handler) (key);
+			return;
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+// The states' actions
+
+/** Going back to the command line, prompt for a command.
+ */
+void task_user::enter_line (uint8_t event)
+{
+	(void)event;
+	*p_serial << PMS ("> ");
+}
+
+/** Going into the motor selector, stop both motors, since neither is steered there.
+ */
+void task_user::enter_select (uint8_t event)
+{
+	(void)event;
+	steer_both (0, 0);
+}
+
+/** At the command line, a character goes into the line.
+ */
+void task_user::line_char (uint8_t ch)
+{
+	handle_line_char ((char)ch);
+}
+
+/** In the motor selector, a key picks a motor or goes back to the command line.
+ */
+void task_user::select_key (uint8_t ch)
+{
+	handle_key (select_keys, (char)ch);
+}
+
+/** While steering the back motor, a key steers it or goes somewhere else.
+ */
+void task_user::back_key (uint8_t ch)
+{
+	handle_key (back_keys, (char)ch);
+}
+
+/** While steering the front motor, a key steers it or goes somewhere else.
+ */
+void task_user::front_key (uint8_t ch)
+{
+	handle_key (front_keys, (char)ch);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method carries out a binary frame from the PC. Nothing is printed except an
+ *  ack, and only if the frame asks for one. A frame which the PC sent again because it
+ *  missed the ack isn't carried out twice; it's acked with the status it got the
+ *  first time.
+ */
+
+void task_user::handle_frame (void)
+{
+	const host_frame& frame = link.get_frame ();
+	uint8_t status = HOST_ACK_OK;
+
+	trace (TRACE_INPUT, TRACE_USER, frame.type);
+
+	if (link.is_repeat ())
+	{
+		status = link.get_last_status ();
+	}
+	else
+	{
+		switch (frame.type)
+		{
+			// One frame sets both motors: payload is front command, then back command
+			case (HOST_SETPOINTS):
+				if (frame.length != 2 || frame.payload[0] > 2 || frame.payload[1] > 2)
+				{
+					status = HOST_ACK_BAD_PAYLOAD;
+				}
+				else if (!steer_both (frame.payload[0], frame.payload[1]))
+				{
+					status = HOST_ACK_REFUSED;
+				}
+				break;
+
+			case (HOST_PING):
+				break;
+
+			// A shot script is loaded a step at a time: payload is the step's time in
+			// SHOT_TICK_US units (low byte first), then front and back commands
+			case (HOST_SHOT_CLEAR):
+				if (!shot_script_clear ())
+				{
+					status = HOST_ACK_REFUSED;
+				}
+				break;
+
+			case (HOST_SHOT_STEP):
+				if (frame.length != 4)
+				{
+					status = HOST_ACK_BAD_PAYLOAD;
+				}
+				else if (!shot_script_add (frame.payload[0] | (frame.payload[1] << 8),
+										   frame.payload[2], frame.payload[3]))
+				{
+					status = HOST_ACK_REFUSED;
+				}
+				break;
+
+			case (HOST_SHOT_RUN):
+				if (!shot_script_run ())
+				{
+					status = HOST_ACK_REFUSED;
+				}
+				break;
+
+			default:
+				status = HOST_ACK_BAD_TYPE;
+				break;
+		}
+		link.set_last_status (status);
+	}
+
+	if (frame.flags & HOST_LINK_ACK_REQUEST)
+	{
+		link.send_ack (status);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method steers the motor which is picked in the current state: the back motor
+ *  in USER_BACK or the front motor in USER_FRONT.
+ *  @param command The steering command (0 = stop, 1 = port, 2 = starboard)
+ */
+
+void task_user::steer_selected (uint8_t command)
+{
+	if (state == USER_BACK)
+	{
+		steer (steer_back, setpoints_back, motor_task, TRACE_BACK, command);
+	}
+	else if (state == USER_FRONT)
+	{
+		steer (steer_front, setpoints_front, motor_task, TRACE_FRONT, command);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+// Command line commands. Each one gets the rest of the command line after its name
+
+/** This command prints the list of commands.
+ */
+void task_user::cmd_help (char* args)
+{
+	(void)args;
+	char text[USER_HELP_SIZE];
+
+	*p_serial << PROGRAM_VERSION << endl;
+	for (uint8_t index = 0; index < command_count; index++)
+	{
+		strcpy_P (text, commands[index].name);
+		*p_serial << text << PMS (": ");
+		strcpy_P (text, commands[index].help);
+		*p_serial << text << endl;
+	}
+}
+
+/** This command puts the user interface into motor control mode.
+ */
+void task_user::cmd_motor (char* args)
+{
+	(void)args;
+	*p_serial << PMS ("MOTOR CONTROL") << endl;
+	machine.fire (this, state, USER_GO_SELECT);
+}
+
+/** This command steers one motor: "steer front 1" or "steer back 0", for example.
+ */
+void task_user::cmd_steer (char* args)
+{
+	char* p_motor = next_word (&args);
+	int32_t command;
+
+	if (p_motor == NULL || !next_number (&args, &command) || command < 0 || command > 2)
+	{
+		*p_serial << PMS ("Usage: steer front|back 0|1|2") << endl;
+	}
+	else if (strcmp_P (p_motor, PSTR ("front")) == 0)
+	{
+		steer (steer_front, setpoints_front, motor_task, TRACE_FRONT,
+			   (uint8_t)command);
+	}
+	else if (strcmp_P (p_motor, PSTR ("back")) == 0)
+	{
+		steer (steer_back, setpoints_back, motor_task, TRACE_BACK,
+			   (uint8_t)command);
+	}
+	else
+	{
+		*p_serial << p_motor << PMS (":WTF? Which motor?") << endl;
+	}
+}
+
+/** This command times the hot paths and prints the cycles per call as CSV.
+ */
+void task_user::cmd_bench (char* args)
+{
+	(void)args;
+	benchmark_attach (this, static_storage<task_motor>::get ()->axis_of (TRACE_BACK));
+	benchmark_run (p_serial);
+}
+
+/** This command shows the event trace and the key to PWM latency.
+ */
+void task_user::cmd_trace (char* args)
+{
+	(void)args;
+	trace_dump (p_serial);
+	trace_latency (p_serial);
+}
+
+/** This command shows each task's CPU use, loop rate and stack.
+ */
+void task_user::cmd_stats (char* args)
+{
+	(void)args;
+	task_stats_print (p_serial);
+}
+
+/** This command shows how many binary frames came in and what went wrong with them.
+ */
+void task_user::cmd_link (char* args)
+{
+	(void)args;
+	link.print_status (p_serial);
+}
+
+/** This command shows how much serial output was sent or thrown away, and how full
+ *  the transmit buffer has been.
+ */
+void task_user::cmd_tx (char* args)
+{
+	(void)args;
+	serial_tx_print (p_serial);
+}
+
+/** This command loads, plays and shows a shot script: "shot add 15000 1 2" adds a step
+ *  15 ms after the start, "shot run" plays the script and "shot" alone shows it and
+ *  how closely its steps have kept to time.
+ */
+void task_user::cmd_shot (char* args)
+{
+	char* p_action = next_word (&args);
+	int32_t offset, front, back;
+
+	if (p_action == NULL)
+	{
+		shot_script_print (p_serial);
+	}
+	else if (strcmp_P (p_action, PSTR ("clear")) == 0)
+	{
+		if (!shot_script_clear ())
+		{
+			*p_serial << PMS ("Can't change the script while it plays") << endl;
+		}
+	}
+	else if (strcmp_P (p_action, PSTR ("add")) == 0)
+	{
+		if (!next_number (&args, &offset) || !next_number (&args, &front)
+			|| !next_number (&args, &back) || offset < 0
+			|| offset / SHOT_TICK_US > 0xFFFF || front < 0 || back < 0
+			|| !shot_script_add ((uint16_t)(offset / SHOT_TICK_US), (uint8_t)front,
+								 (uint8_t)back))
+		{
+			*p_serial << PMS ("Usage: shot add us 0|1|2 0|1|2, in time order, at most ")
+					  << (uint8_t)SHOT_SCRIPT_STEPS << PMS (" steps") << endl;
+		}
+	}
+	else if (strcmp_P (p_action, PSTR ("run")) == 0)
+	{
+		if (!shot_script_run ())
+		{
+			*p_serial << PMS ("No script, or it's already playing") << endl;
+		}
+	}
+	else if (strcmp_P (p_action, PSTR ("stop")) == 0)
+	{
+		shot_script_stop ();
+		steer_both (0, 0);
+	}
+	else
+	{
+		*p_serial << p_action << PMS (":WTF? Usage: shot [clear|add|run|stop]") << endl;
+	}
+}
+
+/** This command shows the control loop executor's period jitter and run time since it
+ *  was last shown, or with a number, changes the executor's rate: "loop 20000". The
+ *  new rate is the loop parameter, which "param save" keeps.
+ */
+void task_user::cmd_loop (char* args)
+{
+	int32_t rate_hz;
+
+	if (next_number (&args, &rate_hz))
+	{
+		if (!params_set ("loop", rate_hz))
+		{
+			*p_serial << PMS ("Rate must be ") << (uint16_t)CONTROL_LOOP_MIN_HZ
+					  << PMS (" to ") << (uint16_t)CONTROL_LOOP_MAX_HZ
+					  << PMS (" Hz and a multiple of each loop's rate") << endl;
+		}
+	}
+	control_loop_print (p_serial);
+}
+
+/** This command shows how many times both motors were changed together.
+ */
+void task_user::cmd_sync (char* args)
+{
+	(void)args;
+	motor_sync_print (p_serial);
+}
+
+/** This command shows the motors' PWM setup, or changes one motor's: "pwm back 16000"
+ *  for 16 kHz, or "pwm front 20000 1 250" for 20 kHz with the high resolution
+ *  extension and 250 ns of dead time. Duty cycles are fractions of the period, so the
+ *  motors keep running as they were. The new frequency is the pwm parameter, which
+ *  "param save" keeps, so every motor starts at it after a reset.
+ */
+void task_user::cmd_pwm (char* args)
+{
+	char* p_motor = next_word (&args);
+	int32_t frequency_hz, hires = 0, dead_ns = 0;
+
+	if (p_motor != NULL)
+	{
+		uint8_t motor = 0xFF;
+		if (strcmp_P (p_motor, PSTR ("front")) == 0)
+		{
+			motor = TRACE_FRONT;
+		}
+		else if (strcmp_P (p_motor, PSTR ("back")) == 0)
+		{
+			motor = TRACE_BACK;
+		}
+
+		if (motor == 0xFF || !next_number (&args, &frequency_hz))
+		{
+			*p_serial << PMS ("Usage: pwm front|back Hz [hires [dead_ns]]") << endl;
+			return;
+		}
+		next_number (&args, &hires);
+		next_number (&args, &dead_ns);
+		if (frequency_hz < 0 || dead_ns < 0 || dead_ns > 0xFFFF
+			|| !motor_pwm_configure (motor, (uint32_t)frequency_hz, hires != 0,
+									 (uint16_t)dead_ns)
+			|| !params_note ("pwm", frequency_hz))
+		{
+			*p_serial << PMS ("PWM must be ") << (uint32_t)PWM_MIN_HZ
+					  << PMS (" to ") << (uint32_t)PWM_MAX_HZ
+					  << PMS (" Hz, and the dead time under half a period") << endl
+					  << PMS ("Above that, its per-period interrupts take too much CPU")
+					  << endl;
+		}
+	}
+	motor_pwm_print (p_serial);
+}
+
+/** This command shows the motors' currents and whether they've been cut off. A motor
+ *  which was cut off runs again once it has been stopped.
+ */
+void task_user::cmd_current (char* args)
+{
+	(void)args;
+	current_sense_print (p_serial);
+}
+
+/** This command shows the telemetry rate and how many frames went out, or with a
+ *  number, sets the rate: "telem 100" sends 100 frames a second, "telem 0" stops them.
+ *  The frames are binary, so host/telemetry.py should be reading the port meanwhile.
+ */
+void task_user::cmd_telem (char* args)
+{
+	int32_t rate_hz;
+
+	if (next_number (&args, &rate_hz))
+	{
+		if (rate_hz < 0 || rate_hz > TELEMETRY_MAX_HZ
+			|| !telemetry_set_rate ((uint16_t)rate_hz))
+		{
+			*p_serial << PMS ("Rate must be 0 or divide ") << (uint16_t)TELEMETRY_MAX_HZ
+					  << PMS (" Hz") << endl;
+		}
+	}
+	telemetry_print (p_serial);
+}
+
+/** This command shows the setpoint queues, or queues a setpoint for one motor:
+ *  "setpt front 1 500 200" steers the front motor to port 500 ms from now for 200 ms,
+ *  and "setpt back 2 0 0 40" steers the back motor to starboard now at a speed of 40.
+ *  The times are in ms; a duration of 0 lasts until the next setpoint, and a level of
+ *  0 uses the motor's own duty cycle or speed. A setpoint for now replaces any which
+ *  are still waiting, as a key does.
+ */
+void task_user::cmd_setpt (char* args)
+{
+	char* p_motor = next_word (&args);
+	int32_t command, delay_ms = 0, duration_ms = 0, level = 0;
+
+	if (p_motor != NULL)
+	{
+		bool front = (strcmp_P (p_motor, PSTR ("front")) == 0);
+		if ((!front && strcmp_P (p_motor, PSTR ("back")) != 0)
+			|| !next_number (&args, &command) || command < 0 || command > 2)
+		{
+			*p_serial << PMS ("Usage: setpt front|back 0|1|2 [in_ms [for_ms [level]]]")
+					  << endl;
+			return;
+		}
+		next_number (&args, &delay_ms);
+		next_number (&args, &duration_ms);
+		next_number (&args, &level);
+		if (delay_ms < 0 || delay_ms > 0x7FFF || duration_ms < 0 || duration_ms > 0xFFFF
+			|| level < 0 || level > PWM_DUTY_FULL)
+		{
+			*p_serial << PMS ("Times must be 0 to 32767 ms and level 0 to ")
+					  << (uint16_t)PWM_DUTY_FULL << endl;
+			return;
+		}
+		if (shot_script_running ())
+		{
+			*p_serial << PMS ("A shot is playing") << endl;
+			return;
+		}
+
+		setpoint next;
+		next.start = xTaskGetTickCount () + configMS_TO_TICKS (delay_ms);
+		next.duration = configMS_TO_TICKS (duration_ms);
+		next.level = (uint16_t)level;
+		next.command = (uint8_t)command;
+		if (front)
+		{
+			send_setpoint (setpoints_front, motor_task, TRACE_FRONT, next,
+						   delay_ms == 0);
+		}
+		else
+		{
+			send_setpoint (setpoints_back, motor_task, TRACE_BACK, next,
+						   delay_ms == 0);
+		}
+	}
+	*p_serial << PMS ("front ");
+	setpoints_front.print (p_serial);
+	*p_serial << PMS ("back ");
+	setpoints_back.print (p_serial);
+}
+
+/** This command shows the last transitions of each task's state machine: the CPU
+ *  cycles since the oldest one shown, the state left, the event and the state entered.
+ */
+void task_user::cmd_fsm (char* args)
+{
+	(void)args;
+	*p_serial << PMS ("user") << endl;
+	machine.print_history (p_serial);
+	task_motor* p_motors = static_storage<task_motor>::get ();
+	for (uint8_t index = 0; index < MOTOR_AXIS_COUNT; index++)
+	{
+		*p_serial << p_motors->axis (index)->name () << endl;
+		p_motors->axis (index)->print_transitions (p_serial);
+	}
+}
+
+/** This command shows each task's period, the longest it has gone between passes,
+ *  and how many deadlines it has missed, counted over resets.
+ */
+void task_user::cmd_super (char* args)
+{
+	(void)args;
+	supervisor_print (p_serial);
+}
+
+/** This command shows the tunable parameters, or changes one: "param front run 2500"
+ *  sets an axis's level, and "param kp 18000" one of the others. "param save" keeps
+ *  them in the EEPROM; "param load" and "param reset" go back to the saved ones or the
+ *  defaults. A change is used right away, but is lost at reset unless it's saved.
+ */
+void task_user::cmd_param (char* args)
+{
+	char* p_name = next_word (&args);
+	int32_t value;
+
+	if (p_name == NULL)
+	{
+		params_print (p_serial);
+		return;
+	}
+	if (strcmp_P (p_name, PSTR ("save")) == 0)
+	{
+		params_save ();
+		*p_serial << PMS ("Parameters saved") << endl;
+		return;
+	}
+	if (strcmp_P (p_name, PSTR ("load")) == 0 || strcmp_P (p_name, PSTR ("reset")) == 0)
+	{
+		if (p_name[0] == 'r' || !params_load ())
+		{
+			params_defaults ();
+			*p_serial << PMS ("Using defaults") << endl;
+		}
+		if (!params_apply ())
+		{
+			*p_serial << PMS ("Can't use the PWM frequency or loop rate") << endl;
+		}
+		params_print (p_serial);
+		return;
+	}
+
+	// An axis's parameter is named after the motor; the others stand alone
+	uint8_t source = 0xFF;
+	if (strcmp_P (p_name, PSTR ("front")) == 0)
+	{
+		source = TRACE_FRONT;
+	}
+	else if (strcmp_P (p_name, PSTR ("back")) == 0)
+	{
+		source = TRACE_BACK;
+	}
+
+	bool done;
+	if (source != 0xFF)
+	{
+		uint8_t index = 0;
+		while (index < MOTOR_AXIS_COUNT
+			   && pgm_read_byte (&motor_axis_table[index].trace_source) != source)
+		{
+			index++;
+		}
+		p_name = next_word (&args);
+		done = p_name != NULL && next_number (&args, &value) && value >= 0
+			   && value <= 0xFFFF && params_set_axis (index, p_name, (uint16_t)value);
+	}
+	else
+	{
+		done = next_number (&args, &value) && params_set (p_name, value);
+	}
+
+	if (!done)
+	{
+		*p_serial << PMS ("Usage: param [front|back stop|run|speed|max v]") << endl
+				  << PMS ("       param [pwm|loop|kp|ki|kd v|save|load|reset]") << endl;
+	}
+}
+
+/** This command shows the back motor's speed setpoint, measured speed and duty cycle.
+ */
+void task_user::cmd_speed (char* args)
+{
+	(void)args;
+	speed_control_print (p_serial);
+}
+
+/** This command shows how the RAM is laid out and how much heap is left.
+ */
+void task_user::cmd_mem (char* args)
+{
+	(void)args;
+	memory_map_print (p_serial);
+}
+
+/** This command shows how long each step of booting took and the clock rate now.
+ */
+void task_user::cmd_boot (char* args)
+{
+	(void)args;
+	boot_profile_print (p_serial);
+	*p_serial << PMS ("clock Hz ") << sysclock_hz () << endl;
+}
+
+/** This command resets the AVR by letting the watchdog run out.
+ */
+void task_user::cmd_reset (char* args)
+{
+	(void)args;
+	*p_serial << PMS ("Resetting AVR") << endl;
+	supervisor_restart ();
+}
+
+
+//-------------------------------------------------------------------------------------
+// Keys in the motor control states. Each one gets the key which was pressed
+
+/** In USER_SELECT or USER_FRONT, this key moves to steering the back motor.
+ */
+void task_user::key_select_back (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Moving back motor") << endl;
+	machine.fire (this, state, USER_GO_BACK);
+}
+
+/** In USER_SELECT or USER_BACK, this key moves to steering the front motor.
+ */
+void task_user::key_select_front (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Moving front motor") << endl;
+	machine.fire (this, state, USER_GO_FRONT);
+}
+
+/** In USER_BACK or USER_FRONT, this key goes back to the motor selector.
+ */
+void task_user::key_selector (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Back to motor selector") << endl;
+	machine.fire (this, state, USER_GO_SELECT);
+}
+
+/** In USER_SELECT, this key goes back to the command line.
+ */
+void task_user::key_exit (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Exit command mode") << endl;
+	machine.fire (this, state, USER_GO_LINE);
+}
+
+/** This key tells the selected motor task to steer to port.
+ */
+void task_user::key_port (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Steering to port") << endl;
+	steer_selected (1);
+}
+
+/** This key tells the selected motor task to steer to starboard.
+ */
+void task_user::key_starboard (char key)
+{
+	(void)key;
+	*p_serial << PMS ("Steering to starboard") << endl;
+	steer_selected (2);
+}
+
+/** Any other key stops the selected motor.
+ */
+void task_user::key_stop (char key)
+{
+	(void)key;
+	steer_selected (0);
+}
+
+/** If the character isn't recognized, ask: What's That Function?
+ */
+void task_user::key_unknown (char key)
+{
+	p_serial->putchar (key);
+	*p_serial << PMS (":WTF?") << endl;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This method handles one character from the serial port. Bytes which belong to a
+ *  binary frame from the PC go to the host link; anything else is a keystroke, which
+ *  is given to the current state's action. The variable 'state' is kept by the parent
+ *  class and changed only by the state machine. In USER_LINE keys make up a command
+ *  line; in the other states each key does something right away, as listed in that
+ *  state's key table.
+ *  @param char_in The character which came in
+ */
+
+void task_user::handle_char (char char_in)
+{
+	uint8_t link_result = link.receive (char_in);
+	if (link_result == HOST_LINK_FRAME)
+	{
+		handle_frame ();
+		return;
+	}
+	else if (link_result == HOST_LINK_BUSY)
+	{
+		return;
+	}
+
+	trace (TRACE_INPUT, TRACE_USER, char_in);
+
+	// We should never be in a state which doesn't exist. If we are, complain and restart
+	if (!machine.run (this, state, (uint8_t)char_in))
+	{
+		*p_serial << PMS ("Illegal state! Resetting AVR") << endl;
+		supervisor_restart ();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This task interacts with the user for force him/her to do what he/she is told. It
+ *  is just following the modern government model of "This is the land of the free...
+ *  free to do exactly what you're told." It sleeps until the serial receive interrupt
+ *  says a character has come in, then handles every character which is waiting.
+ */
 
 void task_user::run (void)
 {
-	char char_in;                           // Character read from serial device
-	time_stamp a_time;                      // Holds the time so it can be displayed
+	// Have the serial receive interrupt wake this task up when characters come in
+	serial_rx_set_task (xTaskGetCurrentTaskHandle ());
 
-	// Tell the user how to get into motor control (state 2), where the user interface
+	// Show how long booting took and where the RAM went; this is done here rather than
+	// in main() so the printing isn't counted in the boot time
+	boot_profile_print (p_serial);
+	memory_map_print (p_serial);
+
+	// Tell the user how to get into motor control (USER_SELECT), where the user interface
 	// drives front and back motors
-	*p_serial << PMS ("Press E for command mode") << endl;
+	*p_serial << PMS ("Type e and Enter for motor control, help for commands") << endl
+			  << PMS ("> ");
+
+	task_stats_start (stats_id);
 
 	// This is an infinite loop; it runs until the power is turned off. There is one 
 	// such loop inside the code for each task
 	for (;;)
 	{
-		//*p_serial << steer_front.get() << endl;
-		//*p_serial << steer_back.get() << endl;
-		// Run the finite state machine. The variable 'state' is kept by the parent class
-		switch (state)
+		// Sleep until the user types something; if nothing came in, a frame which was
+		// being received has been cut off
+		if (!serial_rx_wait (user_timeout))
 		{
-			// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-			// In state 0, we transparently relay characters from the radio to the USB 
-			// serial port and vice versa but watch for certain control characters
-			case (0):
-				if (p_serial->check_for_char ())        // If the user typed a
-				{                                       // character, read
-					char_in = p_serial->getchar ();     // the character
-
-					// In this switch statement, we respond to different characters
-					switch (char_in)
-					{
-						// Control-C means reset the AVR computer
-						case (3):
-							*p_serial << PMS ("Resetting AVR") << endl;
-							wdt_enable (WDTO_120MS);
-							for (;;);
-							break;
-
-						// Control-A puts this task in command mode
-						case ('e'):
-							*p_serial << PMS ("MOTOR CONTROL") << endl;
-							transition_to (1);
-							break;
-
-						// Any other character will be ignored
-						default:
-							break;
-					};
-				}
+			link.timeout ();
+		}
+		supervisor_check_in (supervisor_id);
 
-				break; // End of state 0
-
-			// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-			// In state 1, we're in motor control mode, so when the user types characters, the
-			// characters are interpreted as commands to do something
-			case (1):
-				steer_front.put(0);
-				steer_back.put(0);
-				if (p_serial->check_for_char ())				// If the user typed a
-				{											// character, read
-					char_in = p_serial->getchar ();			// the character
-
-					// In this switch statement, we respond to different characters as
-					// commands typed in by the user
-					switch (char_in)
-					{
-						// The 's' command moves us to back motor
-						case ('s'):
-							*p_serial << "Moving back motor" << endl;
-							transition_to(2);
-							break;
-
-						// The 'w' command moves us to front motor
-						case ('w'):
-							*p_serial << "Moving front motor" << endl;
-							transition_to(3);
-							break;
-
-						// The 'q' key goes back to main
-						case (27):
-						case ('q'):
-							*p_serial << PMS ("Exit command mode") << endl;
-							transition_to (0);
-							break;
-
-						// If the character isn't recognized, ask: What's That Function?
-						default:
-							p_serial->putchar (char_in);
-							*p_serial << PMS (":WTF?") << endl;
-							break;
-					}; // End switch for characters
-				} // End if a character was received
-
-				
-				
-				break; // End of state 1
-			// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-			// In state 2, we're controlling back motor
-			case (2):
-				if (p_serial->check_for_char ())				// If the user typed a
-					{											// character, read
-						char_in = p_serial->getchar ();			// the character
-
-						// In this switch statement, we respond to different characters as
-						// commands typed in by the user
-						switch (char_in)
-						{
-							// The 'q' command moves us back to motor control
-							case ('q'):
-								*p_serial << "Back to motor selector" << endl;
-								transition_to(1);
-								break;
-
-							// The 'w' command moves us to front motor
-							case ('w'):
-								*p_serial << "Moving front motor" << endl;
-								transition_to(3);
-								break;
-
-							// The 'a' key tells motor task to steer to port
-							case ('a'):
-								*p_serial << PMS ("Steering to port") << endl;
-								steer_back.put(1);
-								break;
-								
-							// The 'd' key tells motor task to steer to port
-							case ('d'):
-								*p_serial << PMS ("Steering to starboard") << endl;
-								steer_back.put(2);
-								break;
-							
-							default:
-								steer_back.put(0);
-								break;
-						}; // End switch for characters
-					} // End if a character was received
-			break; // End of state 2
-			
-			// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-			// In state 3, we're controlling front motor
-			case (3):
-				if (p_serial->check_for_char ())				// If the user typed a
-					{											// character, read
-						char_in = p_serial->getchar ();			// the character
-
-						// In this switch statement, we respond to different characters as
-						// commands typed in by the user
-						switch (char_in)
-						{
-							// The 'q' command moves us back to motor control
-							case ('q'):
-								*p_serial << "Back to motor selector" << endl;
-								transition_to(1);
-								break;
-
-							// The 's' command moves us to back motor
-							case ('s'):
-								*p_serial << "Moving back motor" << endl;
-								transition_to(2);
-								break;
-
-							// The 'a' key tells motor task to steer to port
-							case ('a'):
-								*p_serial << PMS ("Steering to port") << endl;
-								steer_front.put(1);
-								break;
-		
-							// The 'd' key tells motor task to steer to port
-							case ('d'):
-								*p_serial << PMS ("Steering to starboard") << endl;
-								steer_front.put(2);
-								break;
-							
-							default:
-								steer_front.put(0);
-								break;
-		
-						}; // End switch for characters
-					} // End if a character was received
-			
-			break; // End of state 3	
-			
-			// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-			// We should never get to the default state. If we do, complain and restart
-			default:
-				*p_serial << PMS ("Illegal state! Resetting AVR") << endl;
-				wdt_enable (WDTO_120MS);
-				for (;;);
-				break;
+		while (serial_rx_available ())
+		{
+			handle_char (serial_rx_getchar ());
+		}
 
-		} // End switch state
+		// In the motor selector, neither motor is being steered
+		if (state == USER_SELECT)
+		{
+			steer_both (0, 0);
+		}
 
-		runs++;                             // Increment counter for debugging
+		// If the crystal is starting in the background, switch to it once it's ready
+		sysclock_poll ();
 
-		// No matter the state, wait for approximately a millisecond before we 
-		// run the loop again. This gives lower priority tasks a chance to run
-		vTaskDelay (configMS_TO_TICKS (1));
+		runs++;                             // Increment counter for debugging
+		task_stats_end_pass (stats_id);
+		supervisor_check_out (supervisor_id);
 	}
 }
@@ -45,13 +45,85 @@
 #include "frt_queue.h"                      // Header of wrapper for FreeRTOS queues
 #include "frt_text_queue.h"                 // Header for a "<<" queue class
 #include "frt_shared_data.h"                // Header for thread-safe shared data
+#include "atomic_share.h"                   // Lock-free single writer share
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "host_link.h"                      // Binary protocol for control from a PC
+#include "fsm.h"                            // Table driven state machines
 
+#include "setpoint_queue.h"                 // Time stamped setpoints for the motors
 #include "shares.h"                         // Global ('extern') queue declarations
 
 
 /// This macro defines a string that identifies the name and version of this program. 
 #define PROGRAM_VERSION		PMS ("ME507 FreeRTOS xmega port ")
 
+/// The longest command line which can be typed, including the '\0' at the end
+#define USER_LINE_SIZE		32
+
+/// The longest command name, including the '\0' at the end
+#define USER_NAME_SIZE		8
+
+/// The longest line of help for a command, including the '\0' at the end
+#define USER_HELP_SIZE		40
+
+
+/// The states of the user interface; their names start with USER_, as they're seen
+/// wherever this file is included
+enum user_states
+{
+	USER_LINE,                              ///< Typing at the command line
+	USER_SELECT,                            ///< Picking a motor to steer
+	USER_BACK,                              ///< Steering the back motor with keys
+	USER_FRONT,                             ///< Steering the front motor with keys
+	USER_STATE_COUNT
+};
+
+/// The events which move the user interface from one state to another
+enum user_events
+{
+	USER_GO_SELECT,                         ///< The motor command, or q while steering
+	USER_GO_BACK,                           ///< s: steer the back motor
+	USER_GO_FRONT,                          ///< w: steer the front motor
+	USER_GO_LINE,                           ///< q or Esc in the selector
+	USER_EVENT_COUNT
+};
+
+/// The user interface's transitions
+typedef fsm_rows<
+	fsm_row<USER_LINE,      USER_GO_SELECT, USER_SELECT>,
+	fsm_row<USER_SELECT,    USER_GO_BACK,   USER_BACK>,
+	fsm_row<USER_SELECT,    USER_GO_FRONT,  USER_FRONT>,
+	fsm_row<USER_SELECT,    USER_GO_LINE,   USER_LINE>,
+	fsm_row<USER_BACK,      USER_GO_SELECT, USER_SELECT>,
+	fsm_row<USER_BACK,      USER_GO_FRONT,  USER_FRONT>,
+	fsm_row<USER_FRONT,     USER_GO_SELECT, USER_SELECT>,
+	fsm_row<USER_FRONT,     USER_GO_BACK,   USER_BACK>
+	> user_transitions;
+
+
+class task_user;
+
+/// A method which runs a command line command; it gets the rest of the line
+typedef void (task_user::*command_handler) (char* args);
+
+/// A method which runs a key in one of the motor control states; it gets the key
+typedef void (task_user::*key_handler) (char key);
+
+/// One entry in the table of command line commands, which is kept in program memory
+struct user_command
+{
+	char name[USER_NAME_SIZE];              ///< What the user types to run it
+	command_handler handler;                ///< The method which runs it
+	char help[USER_HELP_SIZE];              ///< A line about it for the help list
+};
+
+/// One entry in a table of keys for a motor control state
+struct user_key
+{
+	char key;                               ///< The key, or 0 for all other keys
+	key_handler handler;                    ///< The method which runs it
+};
+
 
 //-------------------------------------------------------------------------------------
 /** This task interacts with the user for force him/her to do what he/she is told. What
@@ -65,14 +137,93 @@ private:
 	// No private variables or methods for this class
 
 protected:
-
-
-	// This method displays a simple help message telling the user what to do. It's
-	// protected so that only methods of this class or possibly descendants can use it
-	void print_help_message (void);
-
-	// This method displays information about the status of the system
-	void show_status (void);
+	/// The number under which this task's run time statistics are kept
+	uint8_t stats_id;
+
+	/// The number by which the supervisor knows this task
+	uint8_t supervisor_id;
+
+	/// Characters typed so far on the command line
+	char line[USER_LINE_SIZE];
+
+	/// How many characters are on the command line
+	uint8_t line_length;
+
+	/// The binary protocol, which shares the serial port with the keystrokes
+	host_link link;
+
+	/// The state machine and each state's actions
+	fsm<task_user, user_transitions, USER_STATE_COUNT, USER_EVENT_COUNT> machine;
+	static const fsm_state<task_user> actions[USER_STATE_COUNT];
+
+	// The tables of commands and keys
+	static const user_command commands[];
+	static const uint8_t command_count;
+	static const user_key select_keys[];
+	static const user_key back_keys[];
+	static const user_key front_keys[];
+
+	// These methods read the command line and keys and run what's in the tables
+	void handle_line_char (char ch);
+	void run_command (char* p_line);
+	void handle_key (const user_key* p_table, char key);
+	void handle_frame (void);
+
+	// These methods are the states' actions
+	void enter_line (uint8_t event);
+	void enter_select (uint8_t event);
+	void line_char (uint8_t ch);
+	void select_key (uint8_t ch);
+	void back_key (uint8_t ch);
+	void front_key (uint8_t ch);
+
+	// These methods run the command line commands
+	void cmd_help (char* args);
+	void cmd_motor (char* args);
+	void cmd_steer (char* args);
+	void cmd_bench (char* args);
+	void cmd_trace (char* args);
+	void cmd_stats (char* args);
+	void cmd_link (char* args);
+	void cmd_tx (char* args);
+	void cmd_shot (char* args);
+	void cmd_sync (char* args);
+	void cmd_loop (char* args);
+	void cmd_speed (char* args);
+	void cmd_pwm (char* args);
+	void cmd_current (char* args);
+	void cmd_telem (char* args);
+	void cmd_setpt (char* args);
+	void cmd_fsm (char* args);
+	void cmd_super (char* args);
+	void cmd_param (char* args);
+	void cmd_mem (char* args);
+	void cmd_boot (char* args);
+	void cmd_reset (char* args);
+
+	// These methods run the keys in the motor control states
+	void key_select_back (char key);
+	void key_select_front (char key);
+	void key_selector (char key);
+	void key_exit (char key);
+	void key_port (char key);
+	void key_starboard (char key);
+	void key_stop (char key);
+	void key_unknown (char key);
+
+	// This method steers whichever motor the current state controls
+	void steer_selected (uint8_t command);
+
+	// This method queues a setpoint for a motor and wakes up the motor task
+	bool send_setpoint (setpoint_queue& queue, xTaskHandle motor, uint8_t source,
+						const setpoint& next, bool at_once);
+
+	// This method sends a steering command to a motor if it has changed
+	bool steer (atomic_share<uint8_t>& share, setpoint_queue& queue, xTaskHandle motor,
+				uint8_t source, uint8_t command);
+
+	// This method steers both motors, so that they change together
+	bool steer_both (uint8_t front, uint8_t back);
 	
 	
 
@@ -80,6 +231,9 @@ public:
 	// This constructor creates a user interface task object
 	task_user (const char*, unsigned portBASE_TYPE, size_t, emstream*);
 
+	// This method handles one character from the serial port; the benchmarks call it too
+	void handle_char (char char_in);
+
 	/** This method is called by the RTOS once to run the task loop for ever and ever.
 	 */
 	void run (void);
@@ -0,0 +1,181 @@
+//**************************************************************************************
+/** \file telemetry.cpp
+ *    This file contains the telemetry stream. The snapshot runs in the control loop
+ *    executor's interrupt at TELEMETRY_MAX_HZ and takes every Nth pass. There are two
+ *    frames: DMA sends one while the other is filled, so a frame is never changed
+ *    while it's on the wire and never copied. If the port is too slow for the rate,
+ *    a frame which is still waiting when the next one is taken is replaced by it, so
+ *    what gets out is always the newest data; at 115200 baud, a little over 200
+ *    frames a second get out.
+ *
+ *    The tasks' run counts are read without stopping the tasks, so one which is being
+ *    counted up just then can be off by a carry; they're for seeing which tasks ran,
+ *    not for exact counts.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include <util/crc16.h>                     // CRC functions from avr-libc
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "cycle_counter.h"                  // Free-running CPU cycle counter
+#include "control_loop.h"                   // Runs the snapshot at a fixed rate
+#include "serial_tx.h"                      // DMA driven serial transmitter
+#include "static_alloc.h"                   // Where main() made the tasks
+#include "task_user.h"                      // The user interface task
+#include "motor_axes.h"                     // The motors and their task
+#include "speed_control.h"                  // The back motor's speed controller
+#include "shot_script.h"                    // Timed shot sequences
+#include "current_sense.h"                  // Motor currents and faults
+#include "telemetry.h"                      // Header for this file
+
+
+/// The two frames; DMA sends one while the snapshot fills the other
+static telemetry_frame frames[2];
+
+/// How many executor passes there are between snapshots, or 0 if they're off
+static volatile uint16_t divider = 0;
+
+/// Executor passes since the last snapshot
+static uint16_t count = 0;
+
+// Counts of what's happened to the snapshots
+static uint8_t sequence = 0;                ///< Sequence number of the next frame
+static uint32_t taken = 0;                  ///< Snapshots which have been taken
+static uint32_t replaced = 0;               ///< Frames replaced before they were sent
+
+
+//-------------------------------------------------------------------------------------
+/** This function takes a snapshot into whichever frame DMA isn't sending, puts the
+ *  CRC on it and hands it to the transmitter. The executor's interrupt runs it at
+ *  TELEMETRY_MAX_HZ; it only takes a snapshot on every divider'th pass. It runs at a
+ *  higher interrupt level than the transmitter's DMA interrupt, so the frame it fills
+ *  can't start going out until it's done.
+ */
+
+static void telemetry_snapshot (void)
+{
+	if (divider == 0 || ++count < divider)
+	{
+		return;
+	}
+	count = 0;
+
+	telemetry_frame* p_frame
+		= &frames[(serial_tx_frame_sending () == (const uint8_t*)&frames[0]) ? 1 : 0];
+	telemetry_data* p_data = &p_frame->data;
+	task_user* p_user = static_storage<task_user>::get ();
+	task_motor* p_motors = static_storage<task_motor>::get ();
+	motor_axis* p_front = p_motors->axis_of (TRACE_FRONT);
+	motor_axis* p_back = p_motors->axis_of (TRACE_BACK);
+
+	p_data->cycles = cycle_counter_now ();
+	p_data->ticks = xTaskGetTickCountFromISR ();
+	p_data->user_state = p_user->get_state ();
+	p_data->front_state = p_front->get_state ();
+	p_data->back_state = p_back->get_state ();
+	p_data->steer_front = steer_front.get ();
+	p_data->steer_back = steer_back.get ();
+	p_data->shot_running = shot_script_running ();
+	p_data->front_port_compare = front_bridge::port_compare ();
+	p_data->front_starboard_compare = front_bridge::starboard_compare ();
+	p_data->back_port_compare = back_bridge::port_compare ();
+	p_data->back_starboard_compare = back_bridge::starboard_compare ();
+	p_data->speed_setpoint = speed_back.get ();
+	p_data->speed_measured = speed_control_measured ();
+	p_data->speed_output = speed_control_output ();
+	p_data->front_ma = current_sense_ma (TRACE_FRONT);
+	p_data->back_ma = current_sense_ma (TRACE_BACK);
+	p_data->front_fault = current_sense_fault (TRACE_FRONT);
+	p_data->back_fault = current_sense_fault (TRACE_BACK);
+	p_data->user_runs = p_user->get_total_runs ();
+	p_data->front_runs = p_front->get_runs ();
+	p_data->back_runs = p_back->get_runs ();
+
+	// The CRC covers everything from the length to the end of the data
+	p_frame->sequence = sequence++;
+	const uint8_t* p_byte = &p_frame->length;
+	uint16_t crc = 0;
+	while (p_byte < &p_frame->crc_low)
+	{
+		crc = _crc_xmodem_update (crc, *p_byte++);
+	}
+	p_frame->crc_low = crc & 0xFF;
+	p_frame->crc_high = crc >> 8;
+
+	taken++;
+	if (serial_tx_frame ((const uint8_t*)p_frame, sizeof (telemetry_frame)))
+	{
+		replaced++;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function fills in the parts of the frames which never change and adds the
+ *  snapshot to the control loop executor. Snapshots are off until
+ *  telemetry_set_rate() turns them on.
+ */
+
+void telemetry_init (void)
+{
+	for (uint8_t index = 0; index < 2; index++)
+	{
+		frames[index].sof = HOST_LINK_SOF;
+		frames[index].length = sizeof (telemetry_data);
+		frames[index].flags = 0;
+		frames[index].type = HOST_TELEMETRY;
+	}
+	control_loop_add (telemetry_snapshot, TELEMETRY_MAX_HZ);
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function sets how many snapshots are taken per second. The counts of frames
+ *  taken and replaced start over.
+ *  @param rate_hz The rate, which must divide TELEMETRY_MAX_HZ, or 0 to stop
+ *  @return True if the rate was set, false if it doesn't divide TELEMETRY_MAX_HZ
+ */
+
+bool telemetry_set_rate (uint16_t rate_hz)
+{
+	if (rate_hz > TELEMETRY_MAX_HZ || (rate_hz != 0 && TELEMETRY_MAX_HZ % rate_hz != 0))
+	{
+		return false;
+	}
+
+	portENTER_CRITICAL ();
+	divider = (rate_hz == 0) ? 0 : TELEMETRY_MAX_HZ / rate_hz;
+	count = 0;
+	taken = 0;
+	replaced = 0;
+	portEXIT_CRITICAL ();
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the rate and how many frames have been taken and replaced
+ *  since it was set.
+ *  @param p_ser The serial device on which to print
+ */
+
+void telemetry_print (emstream* p_ser)
+{
+	portENTER_CRITICAL ();
+	uint16_t divider_now = divider;
+	uint32_t taken_now = taken;
+	uint32_t replaced_now = replaced;
+	portEXIT_CRITICAL ();
+
+	*p_ser << PMS ("telemetry ")
+		   << (uint16_t)((divider_now == 0) ? 0 : TELEMETRY_MAX_HZ / divider_now)
+		   << PMS (" Hz frames ") << taken_now
+		   << PMS (" replaced ") << replaced_now
+		   << PMS (" bytes ") << (uint8_t)sizeof (telemetry_frame) << endl;
+}
@@ -0,0 +1,88 @@
+//**************************************************************************************
+/** \file telemetry.h
+ *    This file contains the telemetry stream, which lets a PC record what the robot
+ *    did during a shot. At a set rate of up to 1 kHz, the control loop executor takes
+ *    a snapshot of the tasks' states and run counts, the steering and speed shares,
+ *    the motors' compare values and currents, and the time, and puts it in a binary
+ *    frame. There's no formatting on the robot; DMA sends each frame as it is, and
+ *    host/telemetry.py turns the frames into CSV.
+ *
+ *    Frames use the same framing as the host link, with type HOST_TELEMETRY and the
+ *    fields of telemetry_data, little endian, as the payload. Each frame's sequence
+ *    number is one more than the last one taken, so frames which were taken but
+ *    never sent show up as gaps.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "host_link.h"                      // The framing which telemetry frames use
+
+
+/// The rate at which the snapshots are taken by the executor, in Hz; the telemetry
+/// rate must divide it
+#define TELEMETRY_MAX_HZ        1000
+
+/// The frame type of a telemetry frame, which goes from the robot to the PC
+#define HOST_TELEMETRY          0x81
+
+
+/// One snapshot; the PC's decoder must be changed along with this
+struct telemetry_data
+{
+	uint32_t cycles;                        ///< CPU cycle count when it was taken
+	uint32_t ticks;                         ///< RTOS tick count when it was taken
+	uint8_t user_state;                     ///< State of the user interface task
+	uint8_t front_state;                    ///< State of the front motor task
+	uint8_t back_state;                     ///< State of the back motor task
+	uint8_t steer_front;                    ///< Front motor steering command share
+	uint8_t steer_back;                     ///< Back motor steering command share
+	uint8_t shot_running;                   ///< Whether a shot script is playing
+	uint16_t front_port_compare;            ///< Front motor timer's compare A
+	uint16_t front_starboard_compare;       ///< Front motor timer's compare B
+	uint16_t back_port_compare;             ///< Back motor timer's compare A
+	uint16_t back_starboard_compare;        ///< Back motor timer's compare B
+	int16_t speed_setpoint;                 ///< Back motor speed setpoint share
+	int16_t speed_measured;                 ///< Back motor speed, counts per ms
+	int16_t speed_output;                   ///< Speed controller's output
+	uint16_t front_ma;                      ///< Front motor current, in mA
+	uint16_t back_ma;                       ///< Back motor current, in mA
+	uint8_t front_fault;                    ///< Why the front motor was cut off, or 0
+	uint8_t back_fault;                     ///< Why the back motor was cut off, or 0
+	uint32_t user_runs;                     ///< Passes of the user interface task
+	uint32_t front_runs;                    ///< Passes of the front motor task
+	uint32_t back_runs;                     ///< Passes of the back motor task
+} __attribute__ ((packed));
+
+/// A whole frame as DMA sends it, from SOF to the CRC
+struct telemetry_frame
+{
+	uint8_t sof;                            ///< HOST_LINK_SOF
+	uint8_t length;                         ///< sizeof (telemetry_data)
+	uint8_t sequence;                       ///< Counts snapshots modulo 256
+	uint8_t flags;                          ///< Always 0
+	uint8_t type;                           ///< HOST_TELEMETRY
+	telemetry_data data;                    ///< The snapshot
+	uint8_t crc_low;                        ///< CRC-16/XMODEM from length to data
+	uint8_t crc_high;
+} __attribute__ ((packed));
+
+
+// This function adds the snapshot to the control loop executor; it's called from main()
+void telemetry_init (void);
+
+// This function sets how many frames are taken per second, or stops them with 0
+bool telemetry_set_rate (uint16_t rate_hz);
+
+// This function prints the rate and how many frames were taken and replaced
+void telemetry_print (emstream* p_ser);
+
+#endif // _TELEMETRY_H_
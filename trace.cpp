@@ -0,0 +1,185 @@
+//**************************************************************************************
+/** \file trace.cpp
+ *    This file contains the event trace. Any task or interrupt may add events. A
+ *    writer claims a slot by bumping a one-byte index with interrupts off for a few
+ *    instructions, then fills the slot in; there's no mutex, so adding an event never
+ *    blocks and never causes a task switch.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+#include "FreeRTOS.h"                       // Primary header for FreeRTOS
+#include "task.h"                           // Header for FreeRTOS task functions
+
+#include "trace.h"                          // Header for this file
+
+
+/// The ring buffer of events
+static trace_event events[TRACE_SIZE];
+
+/// How many events have been added, modulo 256; the next one goes in this slot
+static volatile uint8_t event_count = 0;
+
+/// Latencies found by trace_latency(), kept here rather than on the task's stack
+static uint32_t latencies[TRACE_SIZE];
+
+
+//-------------------------------------------------------------------------------------
+/** This function adds an event to the trace. When the buffer is full, the oldest
+ *  event is overwritten.
+ *  @param type What happened, one of the trace_type values
+ *  @param source Where it happened, one of the trace_source values
+ *  @param value Information about the event; its meaning depends on the type
+ */
+
+void trace (uint8_t type, uint8_t source, uint16_t value)
+{
+	uint8_t slot;
+
+	portENTER_CRITICAL ();
+	slot = event_count++;
+	portEXIT_CRITICAL ();
+
+	trace_event* p_event = &events[slot & (TRACE_SIZE - 1)];
+	p_event->when.set_to_now ();
+	p_event->type = type;
+	p_event->source = source;
+	p_event->value = value;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the number of events in the buffer and the count at which
+ *  the oldest of them was added.
+ *  @param p_first Place to put the event count of the oldest event
+ *  @return The number of events in the buffer
+ */
+
+static uint8_t events_held (uint8_t* p_first)
+{
+	uint8_t count = event_count;
+	uint8_t held = (count < TRACE_SIZE) ? count : TRACE_SIZE;
+
+	*p_first = count - held;
+	return held;
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function returns the time from one time stamp to a later one in microseconds.
+ *  @param later The later time
+ *  @param earlier The earlier time
+ *  @return The difference in microseconds
+ */
+
+static uint32_t microseconds_between (time_stamp& later, time_stamp& earlier)
+{
+	time_stamp difference = later - earlier;
+	return difference.get_seconds () * 1000000UL + difference.get_microsec ();
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function prints the events in the trace, oldest first. Times are in
+ *  microseconds from the oldest event.
+ *  @param p_ser The serial device on which to print
+ */
+
+void trace_dump (emstream* p_ser)
+{
+	uint8_t first;
+	uint8_t held = events_held (&first);
+
+	*p_ser << PMS ("time_us type source value") << endl;
+	for (uint8_t index = 0; index < held; index++)
+	{
+		trace_event* p_event = &events[(uint8_t)(first + index) & (TRACE_SIZE - 1)];
+		*p_ser << microseconds_between (p_event->when, events[first & (TRACE_SIZE - 1)].when)
+			   << ' ' << p_event->type << ' ' << p_event->source << ' ' << p_event->value
+			   << endl;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+/** This function finds each key press which changed a steering share and measures
+ *  the time until that motor's compare registers were written, then prints the
+ *  minimum, mean, maximum and 99th percentile of those times in microseconds.
+ *  @param p_ser The serial device on which to print
+ */
+
+void trace_latency (emstream* p_ser)
+{
+	uint8_t first;
+	uint8_t held = events_held (&first);
+	uint8_t found = 0;
+
+	// The last key press, and for each motor the key press which changed its share
+	trace_event* p_input = NULL;
+	trace_event* p_pending[TRACE_BACK + 1] = { NULL, NULL, NULL };
+
+	for (uint8_t index = 0; index < held; index++)
+	{
+		trace_event* p_event = &events[(uint8_t)(first + index) & (TRACE_SIZE - 1)];
+		if (p_event->source > TRACE_BACK)
+		{
+			continue;
+		}
+
+		switch (p_event->type)
+		{
+			case TRACE_INPUT:
+				p_input = p_event;
+				break;
+
+			case TRACE_SHARE:
+				p_pending[p_event->source] = p_input;
+				break;
+
+			case TRACE_PWM:
+				if (p_pending[p_event->source] != NULL)
+				{
+					latencies[found++] = microseconds_between (p_event->when,
+												p_pending[p_event->source]->when);
+					p_pending[p_event->source] = NULL;
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	if (found == 0)
+	{
+		*p_ser << PMS ("No key press to PWM pairs in the trace") << endl;
+		return;
+	}
+
+	// Sort the latencies so the percentile can be picked out; there are few of them
+	uint32_t sum = 0;
+	for (uint8_t index = 1; index < found; index++)
+	{
+		uint32_t latency = latencies[index];
+		uint8_t place = index;
+		while (place > 0 && latencies[place - 1] > latency)
+		{
+			latencies[place] = latencies[place - 1];
+			place--;
+		}
+		latencies[place] = latency;
+	}
+	for (uint8_t index = 0; index < found; index++)
+	{
+		sum += latencies[index];
+	}
+
+	*p_ser << PMS ("key to PWM, us: n ") << found
+		   << PMS (" min ") << latencies[0]
+		   << PMS (" mean ") << sum / found
+		   << PMS (" max ") << latencies[found - 1]
+		   << PMS (" p99 ") << latencies[((uint16_t)found * 99 + 99) / 100 - 1]
+		   << endl;
+}
@@ -0,0 +1,65 @@
+//**************************************************************************************
+/** \file trace.h
+ *    This file contains a small event trace for measuring how long it takes a key
+ *    press to reach the motors. Events are time stamped and kept in a ring buffer
+ *    which holds the most recent TRACE_SIZE of them; nothing is printed until the
+ *    user asks for it, so tracing costs only a few microseconds per event.
+ *
+ *  License:
+ *    This file is released under the GNU Public License, version 2. It is intended
+ *    for educational use only, but its use is not limited thereto. */
+//**************************************************************************************
+
+// This define prevents this .h file from being included multiple times in a .cpp file
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+#include "emstream.h"                       // Header for serial ports and devices
+#include "time_stamp.h"                     // Class to implement a microsecond timer
+
+
+/// How many events the ring buffer holds; it must be a power of two no bigger than 128
+#define TRACE_SIZE          32
+
+
+/// The kinds of event which are traced
+enum trace_type
+{
+	TRACE_INPUT,                            ///< A character came in; value is the char
+	TRACE_SHARE,                            ///< A steering share changed; value is command
+	TRACE_STATE,                            ///< A task changed state; value is new state
+	TRACE_PWM,                              ///< A motor's compare registers were written
+	TRACE_FAULT                             ///< A motor was cut off; value says why
+};
+
+/// Where an event came from
+enum trace_source
+{
+	TRACE_USER,                             ///< The user interface task
+	TRACE_FRONT,                            ///< The front motor or its share
+	TRACE_BACK                              ///< The back motor or its share
+};
+
+
+/// One event in the trace
+struct trace_event
+{
+	time_stamp when;                        ///< Time at which the event happened
+	uint8_t type;                           ///< What happened, from trace_type
+	uint8_t source;                         ///< Where it happened, from trace_source
+	uint16_t value;                         ///< Information which depends on the type
+};
+
+
+// This function adds an event to the trace; it may be called from tasks or interrupts
+void trace (uint8_t type, uint8_t source, uint16_t value);
+
+// This function prints the events in the trace, oldest first
+void trace_dump (emstream* p_ser);
+
+// This function prints statistics of the time from key press to compare register write
+void trace_latency (emstream* p_ser);
+
+#endif // _TRACE_H_
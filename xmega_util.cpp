@@ -14,9 +14,13 @@
  *  \param address A pointer to the address to write to.
  *  \param value   The value to put in to the register.
  */
-void CCPWrite( volatile uint8_t * address, uint8_t value )
+void CCPWrite( register8_t * address, uint8_t value )
 {
-	#if defined __GNUC__
+	#if defined HAL_HOST
+	// The emulated registers have no timed sequence, but the write still gets logged
+	CCP = CCP_IOREG_gc;
+	*address = value;
+	#elif defined __GNUC__
 	uint8_t volatile saved_sreg = SREG;
 	cli();
 	volatile uint8_t * tmpAddr = address;
@@ -38,26 +42,147 @@ void CCPWrite( volatile uint8_t * address, uint8_t value )
 }
 
 
-// Configure the system clock
+// The crystal's frequency range setting and the PLL factor which makes F_CPU from it
+#if SYSCLOCK_XOSC_HZ <= 2000000UL
+#define SYSCLOCK_XOSC_RANGE OSC_FRQRANGE_04TO2_gc
+#elif SYSCLOCK_XOSC_HZ <= 9000000UL
+#define SYSCLOCK_XOSC_RANGE OSC_FRQRANGE_2TO9_gc
+#elif SYSCLOCK_XOSC_HZ <= 12000000UL
+#define SYSCLOCK_XOSC_RANGE OSC_FRQRANGE_9TO12_gc
+#else
+#define SYSCLOCK_XOSC_RANGE OSC_FRQRANGE_12TO16_gc
+#endif
+
+#define SYSCLOCK_PLL_FACTOR (F_CPU / SYSCLOCK_XOSC_HZ)
+
+#if (SYSCLOCK_SOURCE == SYSCLOCK_XOSC_PLL || defined SYSCLOCK_XOSC_BACKGROUND) \
+	&& (SYSCLOCK_PLL_FACTOR < 1 || SYSCLOCK_PLL_FACTOR > 31 \
+		|| SYSCLOCK_PLL_FACTOR * SYSCLOCK_XOSC_HZ != F_CPU)
+#error "F_CPU must be 1 to 31 times SYSCLOCK_XOSC_HZ"
+#endif
+
+
+/*! \brief Wait until all the given oscillators say they're ready.
+ *
+ *  \param ready_bits The OSC.STATUS ready bits to wait for.
+ */
+static void wait_for_oscillator( uint8_t ready_bits )
+{
+	do {} while((OSC.STATUS & ready_bits) != ready_bits);
+}
+
+
+/*! \brief Start the crystal; it takes 16K of its cycles to be ready.
+ */
+static void start_xosc()
+{
+	OSC.XOSCCTRL = SYSCLOCK_XOSC_RANGE | OSC_XOSCSEL_XTAL_16KCLK_gc;
+	OSC.CTRL |= OSC_XOSCEN_bm;
+}
+
+
+/*! \brief Start the PLL from the crystal, which must be ready.
+ */
+static void start_pll()
+{
+	OSC.PLLCTRL = OSC_PLLSRC_XOSC_gc | (SYSCLOCK_PLL_FACTOR & OSC_PLLFAC_gm);
+	OSC.CTRL |= OSC_PLLEN_bm;
+}
+
+
+/*! \brief Switch the system clock and turn off the 2 MHz oscillator used at reset.
+ *
+ *  \param source The CLK_SCLKSEL group configuration of the new clock source.
+ */
+static void switch_clock( uint8_t source )
+{
+	CCPWrite(&(CLK.CTRL), (CLK.CTRL & ~CLK_SCLKSEL_gm) | source);
+	OSC.CTRL &= ~(OSC_RC2MEN_bm);
+}
+
+
+/*! \brief Configure the system clock from the source picked by SYSCLOCK_SOURCE.
+ *
+ *  Only the oscillators that source needs are started, so coming out of reset takes
+ *  as little time as the source allows.
+ */
 void config_SYSCLOCK()
 {
 	uint8_t volatile saved_sreg = SREG;
 	cli();
-	OSC.XOSCCTRL = OSC_FRQRANGE_2TO9_gc | OSC_XOSCSEL_XTAL_16KCLK_gc;				// Configure the external clock frequency and configure startup time
-	OSC.CTRL |= OSC_XOSCEN_bm;														// Enable the external clock
-	do {} while((OSC.STATUS & (OSC_XOSCRDY_bm)) != (OSC_XOSCRDY_bm));				// Wait for a stable clock
-	OSC.PLLCTRL = OSC_PLLSRC_XOSC_gc | OSC_PLLFAC1_bm;								// Configure the PLL factor and divider and select external clock as source
-	OSC.CTRL |= OSC_PLLEN_bm;														// Enable the PLL
-	do {} while((OSC.STATUS & (OSC_PLLRDY_bm)) != (OSC_PLLRDY_bm));				// Wait for a stable PLL clock
-
-	OSC.CTRL |= OSC_RC32MEN_bm;														// Enable the external clock
-	do {} while((OSC.STATUS & (OSC_RC32MRDY_bm)) != (OSC_RC32MRDY_bm));				// Wait for a stable clock
-	
-	
-	uint8_t CLK_CTRL_TEMP = (CLK.CTRL & ~CLK_SCLKSEL_gm) | (CLK_SCLKSEL_RC32M_gc);
-	//CCP = 0xD8;
-	//CLK.CTRL = CLK_CTRL_TEMP;
-	CCPWrite(&(CLK.CTRL),CLK_CTRL_TEMP);
-	OSC.CTRL &= ~(OSC_RC2MEN_bm);
+
+	#if SYSCLOCK_SOURCE == SYSCLOCK_XOSC_PLL
+	start_xosc();
+	wait_for_oscillator(OSC_XOSCRDY_bm);
+	start_pll();
+	wait_for_oscillator(OSC_PLLRDY_bm);
+	switch_clock(CLK_SCLKSEL_PLL_gc);
+	#else
+	OSC.CTRL |= OSC_RC32MEN_bm;
+	#ifdef SYSCLOCK_XOSC_BACKGROUND
+	start_xosc();
+	#endif
+	wait_for_oscillator(OSC_RC32MRDY_bm);
+	switch_clock(CLK_SCLKSEL_RC32M_gc);
+	#endif
+
+	SREG = saved_sreg;
+}
+
+
+/*! \brief Find the frequency of the clock the CPU is running from now.
+ *
+ *  \return The system clock frequency in Hz.
+ */
+uint32_t sysclock_hz()
+{
+	switch (CLK.CTRL & CLK_SCLKSEL_gm)
+	{
+		case CLK_SCLKSEL_RC32M_gc:  return 32000000UL;
+		case CLK_SCLKSEL_RC32K_gc:  return 32768UL;
+		case CLK_SCLKSEL_XOSC_gc:   return SYSCLOCK_XOSC_HZ;
+		case CLK_SCLKSEL_PLL_gc:    return F_CPU;
+		default:                    return 2000000UL;
+	}
+}
+
+
+/*! \brief Move the system clock to the crystal and PLL once they're ready.
+ *
+ *  This only does anything if SYSCLOCK_XOSC_BACKGROUND is defined. It never waits;
+ *  call it every so often and it takes one step each time something is ready: first
+ *  it starts the PLL when the crystal is ready, then it switches to the PLL when that
+ *  is ready and turns the RC oscillator off.
+ *
+ *  \return True once the system clock is running from the PLL.
+ */
+bool sysclock_poll()
+{
+	#ifdef SYSCLOCK_XOSC_BACKGROUND
+	if ((CLK.CTRL & CLK_SCLKSEL_gm) == CLK_SCLKSEL_PLL_gc)
+	{
+		return true;
+	}
+	if (!(OSC.CTRL & OSC_PLLEN_bm))
+	{
+		if (OSC.STATUS & OSC_XOSCRDY_bm)
+		{
+			start_pll();
+		}
+		return false;
+	}
+	if (!(OSC.STATUS & OSC_PLLRDY_bm))
+	{
+		return false;
+	}
+
+	uint8_t volatile saved_sreg = SREG;
+	cli();
+	CCPWrite(&(CLK.CTRL), (CLK.CTRL & ~CLK_SCLKSEL_gm) | CLK_SCLKSEL_PLL_gc);
+	OSC.CTRL &= ~(OSC_RC32MEN_bm);
 	SREG = saved_sreg;
+	return true;
+	#else
+	return (SYSCLOCK_SOURCE == SYSCLOCK_XOSC_PLL);
+	#endif
 }
@@ -12,8 +12,38 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
-void CCPWrite( volatile uint8_t * address, uint8_t value );
+#ifndef F_CPU
+#define F_CPU 32000000UL
+#endif
+
+/*! \brief Clock sources which config_SYSCLOCK() can start, picked by SYSCLOCK_SOURCE.
+ *
+ *  SYSCLOCK_RC32M starts only the internal 32 MHz RC oscillator, which is ready in
+ *  well under a millisecond. SYSCLOCK_XOSC_PLL waits for the crystal and then the PLL,
+ *  which multiplies the crystal up to F_CPU, before switching to it. Oscillators
+ *  which the chosen source doesn't use are never started.
+ */
+#define SYSCLOCK_RC32M      0
+#define SYSCLOCK_XOSC_PLL   1
+
+#ifndef SYSCLOCK_SOURCE
+#define SYSCLOCK_SOURCE     SYSCLOCK_RC32M
+#endif
+
+/*! \brief Frequency of the crystal, if one is used; the PLL makes F_CPU from it. */
+#ifndef SYSCLOCK_XOSC_HZ
+#define SYSCLOCK_XOSC_HZ    16000000UL
+#endif
+
+/*  Define SYSCLOCK_XOSC_BACKGROUND along with SYSCLOCK_RC32M to start the crystal at
+ *  boot without waiting for it. The system runs from the RC oscillator, and
+ *  sysclock_poll() moves it to the crystal and PLL once they're ready; both run at
+ *  F_CPU, so no timer or baud rate changes. */
+
+void CCPWrite( register8_t * address, uint8_t value );
 void config_SYSCLOCK();
+uint32_t sysclock_hz();
+bool sysclock_poll();
 
 
 